@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include "VoxelGridFilter.h"
+
+namespace AE {
+
+	namespace {
+
+		// Points are bucketed into shards by voxel hash so every shard can be reduced by one thread without locks.
+		// The shard is taken from the top bits of the hash, VoxelMap picks slots with the low bits.
+		constexpr uint32_t SHARD_BITS = 6;
+		constexpr uint32_t SHARD_NUM = 1u << SHARD_BITS;
+		constexpr int CHUNK_SIZE = 1 << 16;
+		constexpr uint64_t EMPTY_KEY = ~0ull;
+
+		// 21 bits per axis, biased so that negative voxel coordinates stay positive
+		uint64_t packVoxelKey(const glm::vec4& position, float inverseVoxelSize) {
+			const int64_t bias = 1 << 20;
+			const uint64_t mask = (1ull << 21) - 1;
+			uint64_t x = static_cast<uint64_t>(static_cast<int64_t>(std::floor(position.x * inverseVoxelSize)) + bias) & mask;
+			uint64_t y = static_cast<uint64_t>(static_cast<int64_t>(std::floor(position.y * inverseVoxelSize)) + bias) & mask;
+			uint64_t z = static_cast<uint64_t>(static_cast<int64_t>(std::floor(position.z * inverseVoxelSize)) + bias) & mask;
+			return (x << 42) | (y << 21) | z;
+		}
+
+		uint64_t hashVoxelKey(uint64_t key) {
+			// splitmix64 finalizer
+			key ^= key >> 30;
+			key *= 0xbf58476d1ce4e5b9ull;
+			key ^= key >> 27;
+			key *= 0x94d049bb133111ebull;
+			key ^= key >> 31;
+			return key;
+		}
+
+		uint32_t shardOf(uint64_t hash) {
+			return static_cast<uint32_t>(hash >> (64 - SHARD_BITS));
+		}
+
+		struct ShardPoint {
+			uint64_t key;
+			glm::vec3 position;
+			glm::vec3 color;
+		};
+
+		struct VoxelAccumulator {
+			glm::vec3 positionSum{ 0.f };
+			glm::vec3 colorSum{ 0.f };
+			uint32_t count = 0;
+		};
+
+		// Open addressing (linear probing) map from voxel key to an index into the accumulators.
+		// Accumulators are kept in insertion order, which makes the output order deterministic.
+		class VoxelMap {
+		public:
+			void reserve(size_t voxelNum) {
+				size_t capacity = 16;
+				while (capacity < voxelNum * 2) {
+					capacity <<= 1;
+				}
+				m_keys.assign(capacity, EMPTY_KEY);
+				m_indices.assign(capacity, 0);
+				m_accumulators.clear();
+				m_accumulators.reserve(voxelNum);
+			}
+
+			VoxelAccumulator& find(uint64_t key, uint64_t hash) {
+				if ((m_accumulators.size() + 1) * 2 > m_keys.size()) {
+					grow();
+				}
+				size_t mask = m_keys.size() - 1;
+				size_t slot = hash & mask;
+				uint32_t probeLength = 1;
+				while (m_keys[slot] != EMPTY_KEY && m_keys[slot] != key) {
+					slot = (slot + 1) & mask;
+					probeLength++;
+				}
+				m_probeNum += probeLength;
+				m_maxProbeLength = std::max(m_maxProbeLength, probeLength);
+				if (m_keys[slot] == key) {
+					return m_accumulators[m_indices[slot]];
+				}
+				m_keys[slot] = key;
+				m_indices[slot] = static_cast<uint32_t>(m_accumulators.size());
+				m_accumulators.emplace_back();
+				return m_accumulators.back();
+			}
+
+			const std::vector<VoxelAccumulator>& getAccumulators() const { return m_accumulators; }
+			// Slots looked at by find(), 1 per lookup when every key is in its home slot
+			uint64_t getProbeNum() const { return m_probeNum; }
+			uint32_t getMaxProbeLength() const { return m_maxProbeLength; }
+
+		private:
+			void grow() {
+				std::vector<uint64_t> oldKeys = std::move(m_keys);
+				std::vector<uint32_t> oldIndices = std::move(m_indices);
+				m_keys.assign(oldKeys.size() * 2, EMPTY_KEY);
+				m_indices.assign(oldKeys.size() * 2, 0);
+				size_t mask = m_keys.size() - 1;
+				for (size_t i = 0; i < oldKeys.size(); i++) {
+					if (oldKeys[i] == EMPTY_KEY) {
+						continue;
+					}
+					size_t slot = hashVoxelKey(oldKeys[i]) & mask;
+					while (m_keys[slot] != EMPTY_KEY) {
+						slot = (slot + 1) & mask;
+					}
+					m_keys[slot] = oldKeys[i];
+					m_indices[slot] = oldIndices[i];
+				}
+			}
+
+			std::vector<uint64_t> m_keys;
+			std::vector<uint32_t> m_indices;
+			std::vector<VoxelAccumulator> m_accumulators;
+			uint64_t m_probeNum = 0;
+			uint32_t m_maxProbeLength = 0;
+		};
+
+	} // namespace
+
+	size_t VoxelGridFilter::filter(
+		const std::vector<std::vector<glm::vec4>>& positions,
+		const std::vector<std::vector<glm::vec4>>& colors,
+		std::vector<glm::vec4>& outPositions,
+		std::vector<glm::vec4>& outColors)
+	{
+		if (m_settings.voxelSize <= 0.f) {
+			throw std::runtime_error("voxel size of the voxel grid filter must be positive!");
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		// Flatten the clouds into (cloud, index) pairs
+		std::vector<const glm::vec4*> cloudPositions, cloudColors;
+		std::vector<size_t> cloudOffsets{ 0 };
+		for (size_t i = 0; i < positions.size(); i++) {
+			cloudPositions.push_back(positions[i].data());
+			cloudColors.push_back(colors[i].data());
+			cloudOffsets.push_back(cloudOffsets.back() + positions[i].size());
+		}
+		const size_t pointNum = cloudOffsets.back();
+		if (pointNum > UINT32_MAX) {
+			throw std::runtime_error("too many points for the voxel grid filter!");
+		}
+		auto cloudOf = [&cloudOffsets](size_t pointIndex) {
+			return static_cast<size_t>(std::upper_bound(cloudOffsets.begin(), cloudOffsets.end(), pointIndex) - cloudOffsets.begin() - 1);
+		};
+
+		// 1. voxel key of every point, and per chunk histogram of shards
+		const float inverseVoxelSize = 1.f / m_settings.voxelSize;
+		const int chunkNum = static_cast<int>((pointNum + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		std::vector<uint64_t> keys(pointNum);
+		std::vector<uint32_t> shardCounts(static_cast<size_t>(chunkNum) * SHARD_NUM, 0);
+		m_threadPool.parallelFor(0, chunkNum, 1, [&](int chunkBegin, int chunkEnd) {
+			for (int chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				size_t begin = static_cast<size_t>(chunk) * CHUNK_SIZE;
+				size_t end = std::min(pointNum, begin + CHUNK_SIZE);
+				size_t cloud = cloudOf(begin);
+				uint32_t* counts = &shardCounts[static_cast<size_t>(chunk) * SHARD_NUM];
+				for (size_t p = begin; p < end; p++) {
+					while (p >= cloudOffsets[cloud + 1]) {
+						cloud++;
+					}
+					keys[p] = packVoxelKey(cloudPositions[cloud][p - cloudOffsets[cloud]], inverseVoxelSize);
+					counts[shardOf(hashVoxelKey(keys[p]))]++;
+				}
+			}
+		});
+
+		// 2. stable scatter of the points into shard order, so that every shard reads contiguous memory
+		std::vector<size_t> shardOffsets(SHARD_NUM + 1, 0);
+		std::vector<size_t> chunkOffsets(shardCounts.size());
+		{
+			size_t offset = 0;
+			for (uint32_t shard = 0; shard < SHARD_NUM; shard++) {
+				shardOffsets[shard] = offset;
+				for (int chunk = 0; chunk < chunkNum; chunk++) {
+					chunkOffsets[static_cast<size_t>(chunk) * SHARD_NUM + shard] = offset;
+					offset += shardCounts[static_cast<size_t>(chunk) * SHARD_NUM + shard];
+				}
+			}
+			shardOffsets[SHARD_NUM] = offset;
+		}
+		std::vector<ShardPoint> shardPoints(pointNum);
+		m_threadPool.parallelFor(0, chunkNum, 1, [&](int chunkBegin, int chunkEnd) {
+			for (int chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+				size_t begin = static_cast<size_t>(chunk) * CHUNK_SIZE;
+				size_t end = std::min(pointNum, begin + CHUNK_SIZE);
+				size_t cloud = cloudOf(begin);
+				size_t* offsets = &chunkOffsets[static_cast<size_t>(chunk) * SHARD_NUM];
+				for (size_t p = begin; p < end; p++) {
+					while (p >= cloudOffsets[cloud + 1]) {
+						cloud++;
+					}
+					size_t local = p - cloudOffsets[cloud];
+					ShardPoint& shardPoint = shardPoints[offsets[shardOf(hashVoxelKey(keys[p]))]++];
+					shardPoint.key = keys[p];
+					shardPoint.position = glm::vec3(cloudPositions[cloud][local]);
+					shardPoint.color = glm::vec3(cloudColors[cloud][local]);
+				}
+			}
+		});
+		keys = std::vector<uint64_t>();
+
+		// 3. reduce every shard in its own hash map
+		std::vector<VoxelMap> shardMaps(SHARD_NUM);
+		m_threadPool.parallelFor(0, SHARD_NUM, 1, [&](int shardBegin, int shardEnd) {
+			for (int shard = shardBegin; shard < shardEnd; shard++) {
+				VoxelMap& voxelMap = shardMaps[shard];
+				size_t begin = shardOffsets[shard];
+				size_t end = shardOffsets[shard + 1];
+				// Overlapping views typically put several points into one voxel
+				voxelMap.reserve((end - begin) / 4 + 1);
+				for (size_t s = begin; s < end; s++) {
+					const ShardPoint& shardPoint = shardPoints[s];
+					VoxelAccumulator& accumulator = voxelMap.find(shardPoint.key, hashVoxelKey(shardPoint.key));
+					accumulator.positionSum += shardPoint.position;
+					accumulator.colorSum += shardPoint.color;
+					accumulator.count++;
+				}
+			}
+		});
+
+		// 4. write the voxel averages
+		std::vector<size_t> outputOffsets(SHARD_NUM + 1, 0);
+		uint64_t probeNum = 0;
+		uint32_t maxProbeLength = 0;
+		for (uint32_t shard = 0; shard < SHARD_NUM; shard++) {
+			probeNum += shardMaps[shard].getProbeNum();
+			maxProbeLength = std::max(maxProbeLength, shardMaps[shard].getMaxProbeLength());
+			size_t count = 0;
+			for (const VoxelAccumulator& accumulator : shardMaps[shard].getAccumulators()) {
+				count += accumulator.count >= m_settings.minPointsPerVoxel;
+			}
+			outputOffsets[shard + 1] = outputOffsets[shard] + count;
+		}
+		const size_t outputNum = outputOffsets[SHARD_NUM];
+		outPositions.resize(outputNum);
+		outColors.resize(outputNum);
+		m_threadPool.parallelFor(0, SHARD_NUM, 1, [&](int shardBegin, int shardEnd) {
+			for (int shard = shardBegin; shard < shardEnd; shard++) {
+				size_t out = outputOffsets[shard];
+				for (const VoxelAccumulator& accumulator : shardMaps[shard].getAccumulators()) {
+					if (accumulator.count < m_settings.minPointsPerVoxel) {
+						continue;
+					}
+					float inverseCount = 1.f / accumulator.count;
+					outPositions[out] = glm::vec4(accumulator.positionSum * inverseCount, 1.f);
+					outColors[out] = glm::vec4(accumulator.colorSum * inverseCount, 1.f);
+					out++;
+				}
+			}
+		});
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_lastStats.pointsIn = pointNum;
+		m_lastStats.pointsOut = outputNum;
+		m_lastStats.filterMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		m_lastStats.averageProbeLength = pointNum > 0 ? static_cast<double>(probeNum) / pointNum : 0.0;
+		m_lastStats.maxProbeLength = maxProbeLength;
+		return outputNum;
+	}
+
+} // namespace AE
\ No newline at end of file
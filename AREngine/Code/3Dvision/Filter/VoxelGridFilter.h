@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "../../Utils/ThreadPool.h"
+
+namespace AE {
+
+	// Merges the points that fall into the same cubic voxel into one point with the averaged position and color.
+	// Only occupied voxels are stored (hashed sparse grid), so memory follows the number of output points.
+	class VoxelGridFilter {
+	public:
+		struct Settings {
+			float voxelSize = 0.01f;        // edge length in world units (meters for the RGBD set)
+			uint32_t minPointsPerVoxel = 1; // voxels with fewer points are dropped as outliers
+		};
+
+		struct Stats {
+			size_t pointsIn = 0;
+			size_t pointsOut = 0;
+			double filterMs = 0.0;
+			// Hash map slots looked at per point while reducing, 1 is ideal
+			double averageProbeLength = 0.0;
+			uint32_t maxProbeLength = 0;
+		};
+
+		VoxelGridFilter(ThreadPool& threadPool) : m_threadPool{ threadPool } {}
+
+		// Not copyable or movable
+		VoxelGridFilter(const VoxelGridFilter&) = delete;
+		VoxelGridFilter& operator=(const VoxelGridFilter&) = delete;
+		VoxelGridFilter(VoxelGridFilter&&) = delete;
+		VoxelGridFilter& operator=(VoxelGridFilter&&) = delete;
+
+		void setSettings(const Settings& settings) { m_settings = settings; }
+		const Settings& getSettings() const { return m_settings; }
+
+		// Fuses every cloud of positions/colors into one downsampled cloud. Returns the number of output points.
+		// The output order only depends on the input, not on the number of threads.
+		size_t filter(
+			const std::vector<std::vector<glm::vec4>>& positions,
+			const std::vector<std::vector<glm::vec4>>& colors,
+			std::vector<glm::vec4>& outPositions,
+			std::vector<glm::vec4>& outColors
+		);
+
+		const Stats& getLastStats() const { return m_lastStats; }
+
+	private:
+		ThreadPool& m_threadPool;
+		Settings m_settings{};
+		Stats m_lastStats{};
+	};
+
+} // namespace AE
\ No newline at end of file
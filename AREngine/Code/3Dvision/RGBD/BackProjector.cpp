@@ -0,0 +1,361 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define AE_BACKPROJECT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX2 intrinsics without /arch:AVX2, the kernel is only called after the cpuid check.
+#define AE_TARGET_AVX2
+#else
+#define AE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#include "BackProjector.h"
+
+namespace AE {
+
+#ifdef AE_BACKPROJECT_X86
+	// index of the lowest set bit of a non-zero lane mask
+	static inline int lowestLane(int mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, static_cast<unsigned long>(mask));
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+	}
+#endif
+
+	BackProjector::BackProjector(ThreadPool& threadPool)
+		: m_threadPool{ threadPool }
+		, m_kernel{ detectKernel() }
+	{
+		for (int i = 0; i < 256; i++) {
+			m_colorTable[i] = i / 255.f;
+		}
+	}
+
+	BackProjector::Kernel BackProjector::detectKernel() {
+#ifdef AE_BACKPROJECT_X86
+#ifdef _MSC_VER
+		int cpuInfo[4];
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] >= 7) {
+			__cpuid(cpuInfo, 1);
+			// the OS must save the AVX registers on context switch (OSXSAVE + XCR0 bits 1 and 2)
+			const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+			if (osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+				__cpuidex(cpuInfo, 7, 0);
+				if (cpuInfo[1] & (1 << 5)) {
+					return Kernel::AVX2;
+				}
+			}
+		}
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return Kernel::AVX2;
+		}
+#endif
+		return Kernel::SSE2;
+#else
+		return Kernel::Scalar;
+#endif
+	}
+
+	const char* BackProjector::getKernelName(Kernel kernel) {
+		switch (kernel) {
+		case Kernel::AVX2:
+			return "AVX2";
+		case Kernel::SSE2:
+			return "SSE2";
+		default:
+			return "Scalar";
+		}
+	}
+
+	void BackProjector::setIntrinsics(const CameraIntrinsics& intrinsics) {
+		m_intrinsics = intrinsics;
+		// force the tables to be rebuilt on the next frame
+		m_tableWidth = 0;
+		m_tableHeight = 0;
+	}
+
+	// The tables hold the centered pixel coordinates (u - cx) and (v - cy).
+	// The division by fx/fy stays in the kernels: multiplying by a precomputed (u - cx) / fx rounds differently
+	// and would break bit-exactness with the original loop.
+	void BackProjector::updateTables(int width, int height) {
+		if (width == m_tableWidth && height == m_tableHeight) {
+			return;
+		}
+		m_columnTable.resize(width);
+		for (int u = 0; u < width; u++) {
+			m_columnTable[u] = u - m_intrinsics.cx;
+		}
+		m_rowTable.resize(height);
+		for (int v = 0; v < height; v++) {
+			m_rowTable[v] = v - m_intrinsics.cy;
+		}
+		m_tableWidth = width;
+		m_tableHeight = height;
+	}
+
+	size_t BackProjector::backProjectReference(
+		const CameraIntrinsics& intrinsics,
+		const cv::Mat& color,
+		const cv::Mat& depth,
+		const glm::mat4& inverseView,
+		std::vector<glm::vec4>& positions,
+		std::vector<glm::vec4>& colors)
+	{
+		positions.clear();
+		colors.clear();
+		positions.reserve(color.rows * color.cols);
+		colors.reserve(color.rows * color.cols);
+
+		for (int v = 0; v < color.rows; v++) {
+			for (int u = 0; u < color.cols; u++) {
+				unsigned int d = depth.ptr<unsigned short>(v)[u];
+				if (d == 0) {
+					continue;
+				}
+
+				glm::vec4 point{ 1.f };
+				point[2] = float(d) / intrinsics.depthScale;
+				point[0] = (u - intrinsics.cx) * point[2] / intrinsics.fx;
+				point[1] = (v - intrinsics.cy) * point[2] / intrinsics.fy;
+				glm::vec4 pointWorld = inverseView * point;
+
+				glm::vec4 pointColor{ 1.f };
+				pointColor[0] = color.data[v * color.step + u * color.channels() + 2] / 255.f; // red
+				pointColor[1] = color.data[v * color.step + u * color.channels() + 1] / 255.f; // green
+				pointColor[2] = color.data[v * color.step + u * color.channels()] / 255.f;     // blue
+
+				positions.emplace_back(pointWorld);
+				colors.emplace_back(pointColor);
+			}
+		}
+		return positions.size();
+	}
+
+	size_t BackProjector::backProject(
+		const cv::Mat& color,
+		const cv::Mat& depth,
+		const glm::mat4& inverseView,
+		std::vector<glm::vec4>& positions,
+		std::vector<glm::vec4>& colors)
+	{
+		assert(color.rows == depth.rows && color.cols == depth.cols && "Color and depth images must have the same size");
+		const int width = color.cols;
+		const int height = color.rows;
+		updateTables(width, height);
+
+		// First pass: count the valid pixels of every row so that each row knows where its output starts.
+		// Rows are then written independently and the result keeps the row-major order of the scalar loop.
+		m_rowOffsets.resize(height + 1);
+		m_threadPool.parallelFor(0, height, 16, [&](int vBegin, int vEnd) {
+			for (int v = vBegin; v < vEnd; v++) {
+				const uint16_t* depthRow = depth.ptr<uint16_t>(v);
+				size_t count = 0;
+				for (int u = 0; u < width; u++) {
+					count += depthRow[u] != 0;
+				}
+				m_rowOffsets[v + 1] = count;
+			}
+		});
+		m_rowOffsets[0] = 0;
+		for (int v = 0; v < height; v++) {
+			m_rowOffsets[v + 1] += m_rowOffsets[v];
+		}
+
+		const size_t pointCount = m_rowOffsets[height];
+		positions.resize(pointCount);
+		colors.resize(pointCount);
+
+		// Second pass: back-project
+		m_threadPool.parallelFor(0, height, 16, [&](int vBegin, int vEnd) {
+			for (int v = vBegin; v < vEnd; v++) {
+				RowArgs args{};
+				args.depthRow = depth.ptr<uint16_t>(v);
+				args.colorRow = color.data + v * color.step;
+				args.channels = color.channels();
+				args.width = width;
+				args.rowValue = m_rowTable[v];
+				args.outPositions = positions.data() + m_rowOffsets[v];
+				args.outColors = colors.data() + m_rowOffsets[v];
+
+				switch (m_kernel) {
+				case Kernel::AVX2:
+					projectRowAVX2(args, inverseView);
+					break;
+				case Kernel::SSE2:
+					projectRowSSE2(args, inverseView);
+					break;
+				default:
+					projectRowScalar(args, 0, inverseView);
+					break;
+				}
+			}
+		});
+		return pointCount;
+	}
+
+	int BackProjector::projectRowScalar(const RowArgs& args, int uBegin, const glm::mat4& m) const {
+		int written = 0;
+		for (int u = uBegin; u < args.width; u++) {
+			const unsigned int d = args.depthRow[u];
+			if (d == 0) {
+				continue;
+			}
+
+			glm::vec4 point{ 1.f };
+			point[2] = float(d) / m_intrinsics.depthScale;
+			point[0] = m_columnTable[u] * point[2] / m_intrinsics.fx;
+			point[1] = args.rowValue * point[2] / m_intrinsics.fy;
+			args.outPositions[written] = m * point;
+
+			const uint8_t* bgr = args.colorRow + u * args.channels;
+			args.outColors[written] = glm::vec4{ m_colorTable[bgr[2]], m_colorTable[bgr[1]], m_colorTable[bgr[0]], 1.f };
+			written++;
+		}
+		return written;
+	}
+
+#ifdef AE_BACKPROJECT_X86
+	// glm evaluates mat4 * vec4 as (m[0] * x + m[1] * y) + (m[2] * z + m[3] * w).
+	// The kernels below keep that order (and never use FMA) to produce the same floats.
+	int BackProjector::projectRowSSE2(const RowArgs& args, const glm::mat4& m) const {
+		const __m128 depthScale = _mm_set1_ps(m_intrinsics.depthScale);
+		const __m128 fx = _mm_set1_ps(m_intrinsics.fx);
+		const __m128 fy = _mm_set1_ps(m_intrinsics.fy);
+		const __m128 rowValue = _mm_set1_ps(args.rowValue);
+		const __m128i zero = _mm_setzero_si128();
+
+		alignas(16) float out[4][4];
+		int written = 0;
+		int u = 0;
+		for (; u + 4 <= args.width; u += 4) {
+			const __m128i d16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(args.depthRow + u));
+			const __m128i d32 = _mm_unpacklo_epi16(d16, zero);
+			int valid = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d32, zero))) & 0xF;
+			if (valid == 0) {
+				continue;
+			}
+
+			const __m128 z = _mm_div_ps(_mm_cvtepi32_ps(d32), depthScale);
+			const __m128 x = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&m_columnTable[u]), z), fx);
+			const __m128 y = _mm_div_ps(_mm_mul_ps(rowValue, z), fy);
+			for (int c = 0; c < 4; c++) {
+				const __m128 add0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][c]), x), _mm_mul_ps(_mm_set1_ps(m[1][c]), y));
+				const __m128 add1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][c]), z), _mm_set1_ps(m[3][c]));
+				_mm_store_ps(out[c], _mm_add_ps(add0, add1));
+			}
+
+			while (valid) {
+				const int lane = lowestLane(valid);
+				valid &= valid - 1;
+				const uint8_t* bgr = args.colorRow + (u + lane) * args.channels;
+				args.outPositions[written] = glm::vec4{ out[0][lane], out[1][lane], out[2][lane], out[3][lane] };
+				args.outColors[written] = glm::vec4{ m_colorTable[bgr[2]], m_colorTable[bgr[1]], m_colorTable[bgr[0]], 1.f };
+				written++;
+			}
+		}
+
+		RowArgs tail = args;
+		tail.outPositions += written;
+		tail.outColors += written;
+		return written + projectRowScalar(tail, u, m);
+	}
+
+	AE_TARGET_AVX2
+	int BackProjector::projectRowAVX2(const RowArgs& args, const glm::mat4& m) const {
+		const __m256 depthScale = _mm256_set1_ps(m_intrinsics.depthScale);
+		const __m256 fx = _mm256_set1_ps(m_intrinsics.fx);
+		const __m256 fy = _mm256_set1_ps(m_intrinsics.fy);
+		const __m256 rowValue = _mm256_set1_ps(args.rowValue);
+		const __m256i zero = _mm256_setzero_si256();
+
+		alignas(32) float out[4][8];
+		int written = 0;
+		int u = 0;
+		for (; u + 8 <= args.width; u += 8) {
+			const __m256i d32 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(args.depthRow + u)));
+			int valid = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(d32, zero))) & 0xFF;
+			if (valid == 0) {
+				continue;
+			}
+
+			const __m256 z = _mm256_div_ps(_mm256_cvtepi32_ps(d32), depthScale);
+			const __m256 x = _mm256_div_ps(_mm256_mul_ps(_mm256_loadu_ps(&m_columnTable[u]), z), fx);
+			const __m256 y = _mm256_div_ps(_mm256_mul_ps(rowValue, z), fy);
+			for (int c = 0; c < 4; c++) {
+				const __m256 add0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][c]), x), _mm256_mul_ps(_mm256_set1_ps(m[1][c]), y));
+				const __m256 add1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2][c]), z), _mm256_set1_ps(m[3][c]));
+				_mm256_store_ps(out[c], _mm256_add_ps(add0, add1));
+			}
+
+			while (valid) {
+				const int lane = lowestLane(valid);
+				valid &= valid - 1;
+				const uint8_t* bgr = args.colorRow + (u + lane) * args.channels;
+				args.outPositions[written] = glm::vec4{ out[0][lane], out[1][lane], out[2][lane], out[3][lane] };
+				args.outColors[written] = glm::vec4{ m_colorTable[bgr[2]], m_colorTable[bgr[1]], m_colorTable[bgr[0]], 1.f };
+				written++;
+			}
+		}
+
+		RowArgs tail = args;
+		tail.outPositions += written;
+		tail.outColors += written;
+		return written + projectRowScalar(tail, u, m);
+	}
+#else
+	int BackProjector::projectRowSSE2(const RowArgs& args, const glm::mat4& m) const {
+		return projectRowScalar(args, 0, m);
+	}
+
+	int BackProjector::projectRowAVX2(const RowArgs& args, const glm::mat4& m) const {
+		return projectRowScalar(args, 0, m);
+	}
+#endif
+
+	void BackProjector::benchmark(const cv::Mat& color, const cv::Mat& depth, const glm::mat4& inverseView, int iterations) {
+		std::vector<glm::vec4> referencePositions, referenceColors, positions, colors;
+
+		std::chrono::high_resolution_clock::time_point beginTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			backProjectReference(m_intrinsics, color, depth, inverseView, referencePositions, referenceColors);
+		}
+		std::chrono::high_resolution_clock::time_point referenceTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			backProject(color, depth, inverseView, positions, colors);
+		}
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		const double referenceSeconds = std::chrono::duration<double, std::chrono::seconds::period>(referenceTime - beginTime).count();
+		const double kernelSeconds = std::chrono::duration<double, std::chrono::seconds::period>(endTime - referenceTime).count();
+		const double points = static_cast<double>(referencePositions.size()) * iterations;
+
+		const bool identical = positions.size() == referencePositions.size()
+			&& memcmp(positions.data(), referencePositions.data(), positions.size() * sizeof(glm::vec4)) == 0
+			&& memcmp(colors.data(), referenceColors.data(), colors.size() * sizeof(glm::vec4)) == 0;
+
+		printf("Back-projection benchmark: %d x %d, %zu points, %d iterations\n", color.cols, color.rows, referencePositions.size(), iterations);
+		printf("  reference (scalar, 1 thread): %.2f Mpoints/s\n", points / referenceSeconds * 1e-6);
+		printf("  %s (%u threads): %.2f Mpoints/s (x%.2f)\n",
+			getKernelName(m_kernel),
+			m_threadPool.getThreadCount() + 1,
+			points / kernelSeconds * 1e-6,
+			referenceSeconds / kernelSeconds
+		);
+		printf("  output %s\n", identical ? "identical to the reference" : "DIFFERS from the reference");
+	}
+
+} // namespace AE
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "../../Utils/ThreadPool.h"
+#include "CameraIntrinsics.h"
+
+namespace AE {
+
+	// Converts a color + 16bit depth frame into world space points.
+	// Rows are split across the thread pool and every row is processed 8 (AVX2) or 4 (SSE2) pixels at a time.
+	// The arithmetic is done in the same order as the original scalar loop, so the output is bit-identical to backProjectReference().
+	class BackProjector {
+	public:
+		enum class Kernel {
+			Scalar,
+			SSE2,
+			AVX2
+		};
+
+		BackProjector(ThreadPool& threadPool);
+
+		// Not copyable or movable
+		BackProjector(const BackProjector&) = delete;
+		BackProjector& operator=(const BackProjector&) = delete;
+		BackProjector(BackProjector&&) = delete;
+		BackProjector& operator=(BackProjector&&) = delete;
+
+		void setIntrinsics(const CameraIntrinsics& intrinsics);
+		// Fills positions/colors with the valid (depth != 0) pixels of the frame in row-major order
+		size_t backProject(
+			const cv::Mat& color,
+			const cv::Mat& depth,
+			const glm::mat4& inverseView,
+			std::vector<glm::vec4>& positions,
+			std::vector<glm::vec4>& colors
+		);
+		// Single threaded scalar loop kept as the reference for the vectorized kernels
+		static size_t backProjectReference(
+			const CameraIntrinsics& intrinsics,
+			const cv::Mat& color,
+			const cv::Mat& depth,
+			const glm::mat4& inverseView,
+			std::vector<glm::vec4>& positions,
+			std::vector<glm::vec4>& colors
+		);
+		// Prints points/second of the reference loop and of backProject() and checks that both outputs match
+		void benchmark(const cv::Mat& color, const cv::Mat& depth, const glm::mat4& inverseView, int iterations);
+
+		Kernel getKernel() const { return m_kernel; }
+		void setKernel(Kernel kernel) { m_kernel = kernel; }
+		static const char* getKernelName(Kernel kernel);
+
+	private:
+		struct RowArgs {
+			const uint16_t* depthRow;
+			const uint8_t* colorRow;
+			int channels;
+			int width;
+			float rowValue; // v - cy
+			glm::vec4* outPositions;
+			glm::vec4* outColors;
+		};
+
+		static Kernel detectKernel();
+		void updateTables(int width, int height);
+		int projectRowScalar(const RowArgs& args, int uBegin, const glm::mat4& m) const;
+		int projectRowSSE2(const RowArgs& args, const glm::mat4& m) const;
+		int projectRowAVX2(const RowArgs& args, const glm::mat4& m) const;
+
+		ThreadPool& m_threadPool;
+		Kernel m_kernel;
+		CameraIntrinsics m_intrinsics{};
+		int m_tableWidth = 0;
+		int m_tableHeight = 0;
+		std::vector<float> m_columnTable; // u - cx
+		std::vector<float> m_rowTable;    // v - cy
+		std::vector<size_t> m_rowOffsets;
+		float m_colorTable[256];          // byte / 255
+	};
+
+} // namespace AE
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace AE {
+
+	// Pinhole parameters of the RGBD sensor
+	struct CameraIntrinsics {
+		float cx = 325.5f;
+		float cy = 253.5f;
+		float fx = 518.0f;
+		float fy = 519.0f;
+		float depthScale = 1000.0f;
+	};
+
+} // namespace AE
\ No newline at end of file
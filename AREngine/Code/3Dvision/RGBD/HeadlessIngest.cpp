@@ -0,0 +1,159 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "../../Utils/AREngineDefines.h"
+#include "HeadlessIngest.h"
+
+namespace AE {
+
+	void HeadlessIngest::run(const std::string& outputPath) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		m_3Dvision.setCameraExternalParameters();
+		m_3Dvision.generatePointCloud();
+#if defined(VOXEL_GRID_FILTER_SIZE) && !defined(RGBD_TSDF_FUSION)
+		size_t fusedPointNum = m_3Dvision.getTotalParticleNum();
+		m_3Dvision.downsamplePointCloud(VOXEL_GRID_FILTER_SIZE);
+#endif
+
+#ifdef RGBD_MESH_RENDERING
+		m_3Dvision.generateMesh();
+#endif
+
+		auto writeStartTime = std::chrono::high_resolution_clock::now();
+		size_t bytesWritten = writeBinaryPLY(outputPath);
+#ifdef RGBD_MESH_RENDERING
+		std::string meshPath = outputPath;
+		size_t extension = meshPath.rfind(".ply");
+		meshPath.insert(extension == std::string::npos ? meshPath.size() : extension, "_mesh");
+		bytesWritten += writeMeshPLY(meshPath);
+#endif
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		const RGBDvision::StageTimings& timings = m_3Dvision.getStageTimings();
+		double writeMs = std::chrono::duration<double, std::milli>(endTime - writeStartTime).count();
+		double totalMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		size_t pointNum = m_3Dvision.getTotalParticleNum();
+
+		printf("Headless RGBD ingest: %d frames, %zu points -> %s\n", m_3Dvision.getFrameCount(), pointNum, outputPath.c_str());
+		printf("  pose.txt             : %9.2f ms\n", timings.poseMs);
+		printf("  stream + project     : %9.2f ms (%.2f Mpoints/s)\n",
+			timings.generateMs, pointNum / (timings.generateMs * 1000.0));
+#ifdef RGBD_TSDF_FUSION
+		printf("    TSDF integration   : %9.2f ms\n", timings.fusionMs);
+		printf("    TSDF extraction    : %9.2f ms\n", timings.extractMs);
+#else
+		printf("    back-projection    : %9.2f ms (%.2f Mpoints/s)\n",
+			timings.backProjectMs, pointNum / (timings.backProjectMs * 1000.0));
+#endif
+		printf("    waiting on decode  : %9.2f ms\n", timings.decodeWaitMs);
+#if defined(VOXEL_GRID_FILTER_SIZE) && !defined(RGBD_TSDF_FUSION)
+		printf("  voxel grid filter    : %9.2f ms (%zu -> %zu points)\n", timings.downsampleMs, fusedPointNum, pointNum);
+#endif
+#ifdef RGBD_MESH_RENDERING
+		const MarchingCubes::Stats& meshStats = m_3Dvision.getMeshStats();
+		printf("  marching cubes       : %9.2f ms (%zu triangles, %zu vertices) -> %s\n",
+			timings.meshMs, meshStats.triangleNum, meshStats.vertexNum, meshPath.c_str());
+#endif
+		printf("  write PLY            : %9.2f ms (%.2f MB)\n", writeMs, bytesWritten / (1024.0 * 1024.0));
+		printf("  total                : %9.2f ms\n", totalMs);
+	}
+
+	size_t HeadlessIngest::writeBinaryPLY(const std::string& outputPath) const {
+		std::ofstream file(outputPath, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("failed to open " + outputPath + "!");
+		}
+
+		size_t pointNum = m_3Dvision.getTotalParticleNum();
+		std::string header =
+			"ply\n"
+			"format binary_little_endian 1.0\n"
+			"comment AR Engine fused RGBD point cloud\n"
+			"element vertex " + std::to_string(pointNum) + "\n"
+			"property float x\n"
+			"property float y\n"
+			"property float z\n"
+			"property uchar red\n"
+			"property uchar green\n"
+			"property uchar blue\n"
+			"end_header\n";
+		file.write(header.data(), header.size());
+
+		// Vertices are packed per frame and written in one go (the engine only targets little endian hosts)
+		const size_t vertexSize = 3 * sizeof(float) + 3 * sizeof(uint8_t);
+		std::vector<char> vertexData;
+		const std::vector<std::vector<glm::vec4>>& positions = m_3Dvision.getPointCloudPositions();
+		const std::vector<std::vector<glm::vec4>>& colors = m_3Dvision.getPointCloudColors();
+		for (size_t i = 0; i < positions.size(); i++) {
+			vertexData.resize(positions[i].size() * vertexSize);
+			char* dst = vertexData.data();
+			for (size_t j = 0; j < positions[i].size(); j++) {
+				memcpy(dst, &positions[i][j], 3 * sizeof(float));
+				dst += 3 * sizeof(float);
+				for (int c = 0; c < 3; c++) {
+					*dst++ = static_cast<char>(static_cast<uint8_t>(colors[i][j][c] * 255.f + 0.5f));
+				}
+			}
+			file.write(vertexData.data(), vertexData.size());
+		}
+		if (!file) {
+			throw std::runtime_error("failed to write " + outputPath + "!");
+		}
+		return header.size() + pointNum * vertexSize;
+	}
+
+	size_t HeadlessIngest::writeMeshPLY(const std::string& outputPath) const {
+		std::ofstream file(outputPath, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("failed to open " + outputPath + "!");
+		}
+
+		const TriangleMesh& mesh = m_3Dvision.getMesh();
+		std::string header =
+			"ply\n"
+			"format binary_little_endian 1.0\n"
+			"comment AR Engine marching cubes mesh\n"
+			"element vertex " + std::to_string(mesh.positions.size()) + "\n"
+			"property float x\n"
+			"property float y\n"
+			"property float z\n"
+			"property uchar red\n"
+			"property uchar green\n"
+			"property uchar blue\n"
+			"element face " + std::to_string(mesh.getTriangleCount()) + "\n"
+			"property list uchar uint vertex_indices\n"
+			"end_header\n";
+		file.write(header.data(), header.size());
+
+		const size_t vertexSize = 3 * sizeof(float) + 3 * sizeof(uint8_t);
+		std::vector<char> vertexData(mesh.positions.size() * vertexSize);
+		char* dst = vertexData.data();
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			memcpy(dst, &mesh.positions[i], 3 * sizeof(float));
+			dst += 3 * sizeof(float);
+			for (int c = 0; c < 3; c++) {
+				*dst++ = static_cast<char>(static_cast<uint8_t>(mesh.colors[i][c] * 255.f + 0.5f));
+			}
+		}
+		file.write(vertexData.data(), vertexData.size());
+
+		const size_t faceSize = sizeof(uint8_t) + 3 * sizeof(uint32_t);
+		std::vector<char> faceData(mesh.getTriangleCount() * faceSize);
+		dst = faceData.data();
+		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+			*dst++ = 3;
+			memcpy(dst, &mesh.indices[i], 3 * sizeof(uint32_t));
+			dst += 3 * sizeof(uint32_t);
+		}
+		file.write(faceData.data(), faceData.size());
+		if (!file) {
+			throw std::runtime_error("failed to write " + outputPath + "!");
+		}
+		return header.size() + vertexData.size() + faceData.size();
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "../../Utils/ThreadPool.h"
+#include "RGBDvision.h"
+
+namespace AE {
+
+	// Runs the RGBD reconstruction without a window or a Vulkan device,
+	// prints how long every stage took and writes the fused cloud as a binary PLY file
+	// (and the marching cubes mesh next to it as <output>_mesh.ply when RGBD_MESH_RENDERING is defined).
+	class HeadlessIngest {
+	public:
+		HeadlessIngest(ThreadPool& threadPool) : m_3Dvision{ threadPool } {}
+
+		// Not copyable or movable
+		HeadlessIngest(const HeadlessIngest&) = delete;
+		HeadlessIngest& operator=(const HeadlessIngest&) = delete;
+		HeadlessIngest(HeadlessIngest&&) = delete;
+		HeadlessIngest& operator=(HeadlessIngest&&) = delete;
+
+		void run(const std::string& outputPath);
+
+	private:
+		// x, y, z as float and red, green, blue as uchar per vertex. Returns the number of bytes written.
+		size_t writeBinaryPLY(const std::string& outputPath) const;
+		// Vertices as above plus faces as uchar count + uint indices
+		size_t writeMeshPLY(const std::string& outputPath) const;
+
+		RGBDvision m_3Dvision;
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "PointCloudCache.h"
+
+namespace AE {
+
+	static_assert(sizeof(PointCloudCache::Header) == 72, "PointCloudCache::Header must not contain padding");
+
+	namespace {
+
+		constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+		constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+		uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= FNV_PRIME;
+			}
+			return hash;
+		}
+
+		// Hashes the size too, so that a missing file and an empty file differ
+		uint64_t hashFile(uint64_t hash, const std::string& path) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file) {
+				throw std::runtime_error("failed to open " + path + "!");
+			}
+			std::vector<char> buffer(1 << 20);
+			uint64_t fileSize = 0;
+			while (file) {
+				file.read(buffer.data(), buffer.size());
+				std::streamsize readSize = file.gcount();
+				hash = hashBytes(hash, buffer.data(), static_cast<size_t>(readSize));
+				fileSize += static_cast<uint64_t>(readSize);
+			}
+			return hashBytes(hash, &fileSize, sizeof(fileSize));
+		}
+
+	} // namespace
+
+	PointCloudCache::~PointCloudCache() {
+		close();
+	}
+
+	uint64_t PointCloudCache::hashInputs(const std::string& dataPath, const CameraIntrinsics& intrinsics, const std::vector<float>& settings) {
+		uint32_t version = VERSION;
+		uint64_t hash = hashBytes(FNV_OFFSET_BASIS, &version, sizeof(version));
+		hash = hashFile(hash, dataPath + "pose.txt");
+
+		// Same frame count as RGBDFrameLoader::open(): one frame per non-empty line
+		std::ifstream poseFile(dataPath + "pose.txt");
+		std::string line;
+		int frameNum = 0;
+		while (std::getline(poseFile, line)) {
+			if (line.find_first_not_of(" \t\r") != std::string::npos) {
+				frameNum++;
+			}
+		}
+		for (int i = 0; i < frameNum; i++) {
+			std::string index = std::to_string(i + 1);
+			hash = hashFile(hash, dataPath + "color/" + index + ".png");
+			hash = hashFile(hash, dataPath + "depth/" + index + ".pgm");
+		}
+
+		const float intrinsicValues[] = { intrinsics.cx, intrinsics.cy, intrinsics.fx, intrinsics.fy, intrinsics.depthScale };
+		hash = hashBytes(hash, intrinsicValues, sizeof(intrinsicValues));
+		hash = hashBytes(hash, settings.data(), settings.size() * sizeof(float));
+		return hash;
+	}
+
+	size_t PointCloudCache::getPointDataOffset(uint32_t pointCloudNum) {
+		size_t offset = sizeof(Header) + pointCloudNum * sizeof(int32_t);
+		return (offset + 15) & ~static_cast<size_t>(15);
+	}
+
+	bool PointCloudCache::open(const std::string& cachePath, uint64_t inputHash) {
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header))) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_fileHandle = file;
+		m_mappingHandle = mapping;
+		m_data = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int file = ::open(cachePath.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat fileStat {};
+		if (fstat(file, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(Header))) {
+			::close(file);
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps the file alive
+		::close(file);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		m_data = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+		const Header& header = getHeader();
+		bool valid = memcmp(header.magic, "AEPC", 4) == 0 && header.version == VERSION && header.inputHash == inputHash;
+		if (valid && header.pointFormat >= POINT_FORMAT_COUNT) {
+			close();
+			throw std::runtime_error("failed to load point cloud cache: unknown point format!");
+		}
+		if (valid) {
+			m_pointDataOffset = getPointDataOffset(header.pointCloudNum);
+			valid = m_pointDataOffset + header.pointNum * header.pointSize == m_size;
+		}
+		if (valid) {
+			const int32_t* particleNum = reinterpret_cast<const int32_t*>(m_data + sizeof(Header));
+			m_particleNum.assign(particleNum, particleNum + header.pointCloudNum);
+			uint64_t pointNum = 0;
+			for (int num : m_particleNum) {
+				pointNum += static_cast<uint64_t>(num);
+			}
+			valid = pointNum == header.pointNum;
+		}
+		if (!valid) {
+			close();
+		}
+		return valid;
+	}
+
+	void PointCloudCache::close() {
+		if (m_data != nullptr) {
+#ifdef _WIN32
+			UnmapViewOfFile(m_data);
+			CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+			CloseHandle(static_cast<HANDLE>(m_fileHandle));
+			m_mappingHandle = nullptr;
+			m_fileHandle = nullptr;
+#else
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_pointDataOffset = 0;
+		m_particleNum.clear();
+	}
+
+	void PointCloudCache::write(
+		const std::string& cachePath,
+		uint64_t inputHash,
+		uint32_t pointFormat,
+		uint32_t pointSize,
+		const std::vector<int>& particleNum,
+		const void* pointData,
+		const float boundsMin[4],
+		const float boundsScale[4])
+	{
+		Header header{};
+		memcpy(header.magic, "AEPC", 4);
+		header.version = VERSION;
+		header.inputHash = inputHash;
+		header.pointFormat = pointFormat;
+		header.pointSize = pointSize;
+		header.pointCloudNum = static_cast<uint32_t>(particleNum.size());
+		header.pointNum = 0;
+		for (int num : particleNum) {
+			header.pointNum += static_cast<uint64_t>(num);
+		}
+		memcpy(header.boundsMin, boundsMin, sizeof(header.boundsMin));
+		memcpy(header.boundsScale, boundsScale, sizeof(header.boundsScale));
+
+		std::vector<char> particleNumData(getPointDataOffset(header.pointCloudNum) - sizeof(Header), 0);
+		for (size_t i = 0; i < particleNum.size(); i++) {
+			int32_t num = static_cast<int32_t>(particleNum[i]);
+			memcpy(particleNumData.data() + i * sizeof(int32_t), &num, sizeof(int32_t));
+		}
+
+		const std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary);
+			if (!file) {
+				throw std::runtime_error("failed to open " + tempPath + "!");
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(particleNumData.data(), particleNumData.size());
+			file.write(static_cast<const char*>(pointData), static_cast<std::streamsize>(header.pointNum * pointSize));
+			if (!file) {
+				throw std::runtime_error("failed to write " + tempPath + "!");
+			}
+		}
+		// std::rename() does not replace an existing file on Windows
+		std::remove(cachePath.c_str());
+		if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+			throw std::runtime_error("failed to rename " + tempPath + " to " + cachePath + "!");
+		}
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CameraIntrinsics.h"
+
+namespace AE {
+
+	// Versioned binary cache (.aepc) of the reconstructed point cloud, stored exactly as it is laid out in the particle SSBO.
+	// The file is keyed by a hash of the RGBD inputs, so a warm start maps it and skips image decoding and reconstruction.
+	//
+	// Layout (little endian):
+	//   Header
+	//   int32 particleNum[pointCloudNum], zero padded to a multiple of 16 bytes
+	//   pointNum * pointSize bytes of particle data
+	class PointCloudCache {
+	public:
+		static constexpr uint32_t VERSION = 1;
+		// Header::pointFormat is below it (PointCloud::PointFormat::Full, Compact)
+		static constexpr uint32_t POINT_FORMAT_COUNT = 2;
+
+		struct Header {
+			char magic[4];          // "AEPC"
+			uint32_t version;
+			uint64_t inputHash;
+			uint32_t pointFormat;   // PointCloud::PointFormat
+			uint32_t pointSize;     // bytes per point
+			uint32_t pointCloudNum;
+			uint32_t reserved;
+			uint64_t pointNum;
+			float boundsMin[4];     // quantization bounds of the compact format
+			float boundsScale[4];
+		};
+
+		PointCloudCache() = default;
+		~PointCloudCache();
+
+		// Not copyable or movable
+		PointCloudCache(const PointCloudCache&) = delete;
+		PointCloudCache& operator=(const PointCloudCache&) = delete;
+		PointCloudCache(PointCloudCache&&) = delete;
+		PointCloudCache& operator=(PointCloudCache&&) = delete;
+
+		// FNV-1a over pose.txt, every color/N.png and depth/N.pgm it lists, the intrinsics and the given settings
+		// (anything else that changes the reconstruction, e.g. filter sizes and the point format).
+		// Only reads the files, nothing is decoded.
+		static uint64_t hashInputs(const std::string& dataPath, const CameraIntrinsics& intrinsics, const std::vector<float>& settings);
+
+		// Maps the file. Returns false if it is missing, truncated, from another version or built from other inputs.
+		// Throws if it matches the inputs but holds an unknown point format (corrupt).
+		bool open(const std::string& cachePath, uint64_t inputHash);
+		void close();
+		// Writes to <cachePath>.tmp first and renames it, so a crash never leaves a half written cache behind
+		static void write(
+			const std::string& cachePath,
+			uint64_t inputHash,
+			uint32_t pointFormat,
+			uint32_t pointSize,
+			const std::vector<int>& particleNum,
+			const void* pointData,
+			const float boundsMin[4],
+			const float boundsScale[4]
+		);
+
+		bool isOpen() const { return m_data != nullptr; }
+		const Header& getHeader() const { return *reinterpret_cast<const Header*>(m_data); }
+		const std::vector<int>& getParticleNum() const { return m_particleNum; }
+		int getPointCloudNum() const { return static_cast<int>(m_particleNum.size()); }
+		// Points right into the mapped file, valid until close()
+		const void* getPointData() const { return m_data + m_pointDataOffset; }
+		size_t getFileSize() const { return m_size; }
+
+	private:
+		static size_t getPointDataOffset(uint32_t pointCloudNum);
+
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		size_t m_pointDataOffset = 0;
+		std::vector<int> m_particleNum;
+		void* m_fileHandle = nullptr;    // Windows only
+		void* m_mappingHandle = nullptr; // Windows only
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+#include "RGBDFrameLoader.h"
+
+namespace AE {
+
+	RGBDFrameLoader::RGBDFrameLoader(uint32_t ringSize, uint32_t ioThreadNum)
+		: m_ringSize{ std::max(1u, ringSize) }
+		, m_ioThreadNum{ std::max(1u, ioThreadNum) }
+	{}
+
+	RGBDFrameLoader::~RGBDFrameLoader() {
+		close();
+	}
+
+	int RGBDFrameLoader::open(const std::string& dataPath) {
+		close();
+		m_dataPath = dataPath;
+		m_cameraPos.clear();
+		m_cameraRotation.clear();
+
+		std::ifstream fin(m_dataPath + "pose.txt");
+		if (!fin) {
+			throw std::runtime_error("failed to open " + m_dataPath + "pose.txt! Please run the program in the directory that has 3Dvision/");
+		}
+		// One line per frame: tx ty tz qx qy qz qw
+		std::string line;
+		while (std::getline(fin, line)) {
+			std::istringstream lineStream(line);
+			float data[7] = { 0 };
+			int count = 0;
+			while (count < 7 && lineStream >> data[count]) {
+				count++;
+			}
+			if (count == 0) {
+				continue;
+			}
+			if (count != 7) {
+				throw std::runtime_error("failed to parse pose " + std::to_string(m_cameraPos.size() + 1) + " in pose.txt!");
+			}
+
+			// Position
+			m_cameraPos.emplace_back(data[0], data[1], data[2]);
+			// Rotation (Quaternion -> Mat4)
+			glm::quat cameraQuaternion{ data[6], data[3], data[4], data[5] };
+			m_cameraRotation.emplace_back(glm::toMat4(cameraQuaternion));
+		}
+
+		m_slots.clear();
+		m_slots.resize(m_ringSize);
+		m_nextDecode = 0;
+		m_nextConsume = 0;
+		m_stop = false;
+		m_waitMs = 0.0;
+		uint32_t threadNum = std::min(m_ioThreadNum, static_cast<uint32_t>(std::max(1, getFrameCount())));
+		for (uint32_t i = 0; i < threadNum; i++) {
+			m_ioThreads.emplace_back(&RGBDFrameLoader::ioLoop, this);
+		}
+		return getFrameCount();
+	}
+
+	bool RGBDFrameLoader::next(RGBDFrame& frame) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_nextConsume >= getFrameCount()) {
+			return false;
+		}
+
+		Slot& slot = m_slots[m_nextConsume % m_ringSize];
+		auto startTime = std::chrono::high_resolution_clock::now();
+		m_frameReady.wait(lock, [&slot] { return slot.ready; });
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_waitMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+		std::exception_ptr exception = slot.exception;
+		frame = std::move(slot.frame);
+		slot.frame = RGBDFrame{};
+		slot.exception = nullptr;
+		slot.ready = false;
+		m_nextConsume++;
+		lock.unlock();
+		m_slotFreed.notify_all();
+
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+		return true;
+	}
+
+	void RGBDFrameLoader::close() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_slotFreed.notify_all();
+		for (std::thread& ioThread : m_ioThreads) {
+			ioThread.join();
+		}
+		m_ioThreads.clear();
+	}
+
+	void RGBDFrameLoader::ioLoop() {
+		const int frameCount = getFrameCount();
+		while (true) {
+			int frameIndex;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				// A frame may only be decoded once its slot has been handed to the consumer
+				m_slotFreed.wait(lock, [this, frameCount] {
+					return m_stop || m_nextDecode >= frameCount || m_nextDecode < m_nextConsume + static_cast<int>(m_ringSize);
+				});
+				if (m_stop || m_nextDecode >= frameCount) {
+					return;
+				}
+				frameIndex = m_nextDecode++;
+			}
+
+			Slot& slot = m_slots[frameIndex % m_ringSize];
+			try {
+				decode(frameIndex, slot);
+			}
+			catch (...) {
+				slot.exception = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				slot.ready = true;
+			}
+			m_frameReady.notify_all();
+		}
+	}
+
+	void RGBDFrameLoader::decode(int frameIndex, Slot& slot) const {
+		std::string index = std::to_string(frameIndex + 1);
+		std::string colorPath = m_dataPath + "color/" + index + ".png";
+		std::string depthPath = m_dataPath + "depth/" + index + ".pgm";
+
+		RGBDFrame& frame = slot.frame;
+		frame.index = frameIndex;
+		//frame.color = cv::imread(colorPath, cv::IMREAD_UNCHANGED);
+		frame.color = cv::imread(colorPath);
+		if (frame.color.data == NULL) {
+			throw std::runtime_error("failed to read " + colorPath + "!");
+		}
+		frame.depth = cv::imread(depthPath, -1);
+		if (frame.depth.data == NULL) {
+			throw std::runtime_error("failed to read " + depthPath + "!");
+		}
+		frame.cameraPos = m_cameraPos[frameIndex];
+		frame.cameraRotation = m_cameraRotation[frameIndex];
+	}
+
+} // namespace AE
\ No newline at end of file
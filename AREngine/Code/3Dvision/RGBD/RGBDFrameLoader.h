@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+namespace AE {
+
+	struct RGBDFrame {
+		int index = -1;
+		cv::Mat color;
+		cv::Mat depth;
+		glm::vec3 cameraPos{ 0.f };
+		glm::mat4 cameraRotation{ 1.f };
+	};
+
+	// Streams an RGBD sequence of any length.
+	// The frame count comes from the lines of pose.txt, color/N.png and depth/N.pgm are decoded on I/O threads
+	// into a ring of ringSize slots, and the consumer pulls them in order with next().
+	// At most ringSize decoded frames (+ the one the consumer holds) are alive at any time.
+	class RGBDFrameLoader {
+	public:
+		RGBDFrameLoader(uint32_t ringSize, uint32_t ioThreadNum);
+		~RGBDFrameLoader();
+
+		// Not copyable or movable
+		RGBDFrameLoader(const RGBDFrameLoader&) = delete;
+		RGBDFrameLoader& operator=(const RGBDFrameLoader&) = delete;
+		RGBDFrameLoader(RGBDFrameLoader&&) = delete;
+		RGBDFrameLoader& operator=(RGBDFrameLoader&&) = delete;
+
+		// Reads pose.txt under dataPath and starts decoding. Returns the frame count.
+		int open(const std::string& dataPath);
+		// Blocks until the next frame is decoded. Returns false once every frame has been consumed.
+		// Rethrows a decode error of that frame.
+		bool next(RGBDFrame& frame);
+		// Stops the I/O threads. Frames that are still queued are dropped.
+		void close();
+
+		int getFrameCount() const { return static_cast<int>(m_cameraPos.size()); }
+		// Time next() spent blocked on decoding since open()
+		double getWaitMs() const { return m_waitMs; }
+
+	private:
+		struct Slot {
+			RGBDFrame frame;
+			std::exception_ptr exception;
+			bool ready = false;
+		};
+
+		void ioLoop();
+		void decode(int frameIndex, Slot& slot) const;
+
+		const uint32_t m_ringSize;
+		const uint32_t m_ioThreadNum;
+		std::string m_dataPath;
+		std::vector<glm::vec3> m_cameraPos;
+		std::vector<glm::mat4> m_cameraRotation;
+
+		std::vector<Slot> m_slots;
+		std::vector<std::thread> m_ioThreads;
+		std::mutex m_mutex;
+		std::condition_variable m_slotFreed;
+		std::condition_variable m_frameReady;
+		int m_nextDecode = 0;
+		int m_nextConsume = 0;
+		bool m_stop = false;
+		double m_waitMs = 0.0;
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -1,101 +1,194 @@
-#include <fstream>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/quaternion.hpp>
-
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <iostream>
+#include <stdexcept>
+
+#include "../../Utils/AREngineDefines.h"
 #include "RGBDvision.h"
 
 namespace AE {
 
 	void RGBDvision::setCameraExternalParameters() {
-		std::ifstream fin("3DVision/RGBD/pose.txt");
-		assert(fin && "Please run the program in the directory that has pose.txt");
-        std::string png = ".png";
-        std::string pgm = ".pgm";
-        for (int i = 0; i < 5; i++) {
-            int index = i + 1;
-            std::string colorPath = "3DVision/RGBD/color/" + std::to_string(index) + png;
-            std::string depthPath = "3DVision/RGBD/depth/" + std::to_string(index) + pgm;
-            //m_colorImgs.emplace_back(cv::imread(colorPath, cv::IMREAD_UNCHANGED));
-            m_colorImgs.emplace_back(cv::imread(colorPath));
-            if (m_colorImgs[i].data == NULL) {
-                printf("file read error");
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        // Reads pose.txt and starts decoding the first frames in the background
+        m_frameLoader.open(RGBD_DATA_PATH);
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        m_stageTimings.poseMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	}
+
+	void RGBDvision::generatePointCloud(bool extractSurfacePoints) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        const bool fuseFrames = m_reconstructionMode == ReconstructionMode::TSDFFusion;
+        int imageNum = m_frameLoader.getFrameCount();
+        m_pointCloudPositions.assign(fuseFrames ? 1 : imageNum, {});
+        m_pointCloudColors.assign(fuseFrames ? 1 : imageNum, {});
+        m_particleNum.assign(fuseFrames ? 1 : imageNum, 0);
+        m_stageTimings.backProjectMs = 0.0;
+        if (fuseFrames) {
+            m_tsdfVolume.reset();
+        }
+
+        // Back-projection of frame i overlaps with decoding of the following frames
+        RGBDFrame frame;
+        while (m_frameLoader.next(frame)) {
+            int i = frame.index;
+            std::cout << "Converting RGBD images " << i + 1 << std::endl;
+
+#ifdef SHOW_RGBD_FRAMES
+            const char* windowName = "OpenCV window";
+            cv::imshow(windowName, frame.color);
+            cv::waitKey(0);
+#endif
+
+            // set camera pose
+            setViewPose(frame.cameraPos, frame.cameraRotation);
+
+#ifdef BENCHMARK_BACK_PROJECTION
+            if (i == 0) {
+                m_backProjector.benchmark(frame.color, frame.depth, m_inverseViewMatrix, BENCHMARK_BACK_PROJECTION);
             }
-            //cv::cvtColor(m_colorImgs[i], m_colorImgs[i], cv::COLOR_BGR2RGBA);
-            m_depthImgs.emplace_back(cv::imread(depthPath, -1));
-            if (m_depthImgs[i].data == NULL) {
-                printf("file read error");
+#endif
+            if (fuseFrames) {
+                m_tsdfVolume.integrate(frame.color, frame.depth, m_intrinsics, m_inverseViewMatrix);
+                continue;
             }
 
-            float data[7] = { 0 };
-            for (auto& d : data) {
-                fin >> d;
+            auto backProjectStartTime = std::chrono::high_resolution_clock::now();
+            m_backProjector.backProject(frame.color, frame.depth, m_inverseViewMatrix, m_pointCloudPositions[i], m_pointCloudColors[i]);
+            auto backProjectEndTime = std::chrono::high_resolution_clock::now();
+            m_stageTimings.backProjectMs += std::chrono::duration<double, std::milli>(backProjectEndTime - backProjectStartTime).count();
+            m_particleNum[i] = static_cast<int>(m_pointCloudPositions[i].size());
+        }
+        // Release the last decoded images
+        frame = RGBDFrame{};
+
+        if (fuseFrames) {
+            auto extractStartTime = std::chrono::high_resolution_clock::now();
+            if (extractSurfacePoints) {
+                m_particleNum[0] = static_cast<int>(m_tsdfVolume.extractPointCloud(m_pointCloudPositions[0], m_pointCloudColors[0]));
             }
+            auto extractEndTime = std::chrono::high_resolution_clock::now();
+            m_stageTimings.fusionMs = m_tsdfVolume.getStats().integrateMs;
+            m_stageTimings.extractMs = std::chrono::duration<double, std::milli>(extractEndTime - extractStartTime).count();
+            printf("TSDF fusion: %d frames, %zu blocks (%.1f MB), %d surface points, integrate %.2f ms, extract %.2f ms\n",
+                m_tsdfVolume.getStats().frameNum, m_tsdfVolume.getBlockCount(), m_tsdfVolume.getMemoryUsage() / (1024.0 * 1024.0),
+                m_particleNum[0], m_stageTimings.fusionMs, m_stageTimings.extractMs);
+        }
 
-            // Position
-            glm::vec3 cameraPosition = { data[0], data[1], data[2] };
-            // Rotation (Quaternion -> Mat4)
-            glm::quat cameraQuaternion{ data[6], data[3], data[4], data[5] };
-            glm::mat4 cameraRotationMat = glm::toMat4(cameraQuaternion);
+        auto endTime = std::chrono::high_resolution_clock::now();
+        m_stageTimings.decodeWaitMs = m_frameLoader.getWaitMs();
+        m_stageTimings.generateMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    }
+
+    void RGBDvision::downsamplePointCloud(float voxelSize) {
+        VoxelGridFilter::Settings settings = m_voxelGridFilter.getSettings();
+        settings.voxelSize = voxelSize;
+        m_voxelGridFilter.setSettings(settings);
+
+        std::vector<glm::vec4> positions, colors;
+        m_voxelGridFilter.filter(m_pointCloudPositions, m_pointCloudColors, positions, colors);
+
+        const VoxelGridFilter::Stats& stats = m_voxelGridFilter.getLastStats();
+        m_stageTimings.downsampleMs = stats.filterMs;
+        printf("Voxel grid filter (%.3f): %zu points -> %zu points (x%.2f fewer) in %.2f ms, %.2f probes per point\n",
+            voxelSize, stats.pointsIn, stats.pointsOut,
+            stats.pointsOut ? double(stats.pointsIn) / stats.pointsOut : 0.0, stats.filterMs, stats.averageProbeLength);
+
+        m_particleNum.assign(1, static_cast<int>(positions.size()));
+        m_pointCloudPositions.assign(1, {});
+        m_pointCloudColors.assign(1, {});
+        m_pointCloudPositions[0] = std::move(positions);
+        m_pointCloudColors[0] = std::move(colors);
+    }
 
-            m_cameraPos.emplace_back(cameraPosition);
-            m_cameraRotation.emplace_back(cameraRotationMat);
-            int debug = 0;
+    void RGBDvision::generateMesh() {
+        if (m_reconstructionMode != ReconstructionMode::TSDFFusion) {
+            throw std::runtime_error("failed to generate mesh! Mesh extraction needs the TSDF fusion reconstruction mode");
         }
-	}
+        auto startTime = std::chrono::high_resolution_clock::now();
+        m_tsdfVolume.extractMesh(m_mesh, &m_meshStats);
+        auto endTime = std::chrono::high_resolution_clock::now();
+        m_stageTimings.meshMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        printf("Marching cubes: %zu triangles, %zu vertices in %.2f ms (vertices %.2f ms, triangles %.2f ms, weld + normals %.2f ms)\n",
+            m_meshStats.triangleNum, m_meshStats.vertexNum, m_stageTimings.meshMs,
+            m_meshStats.vertexMs, m_meshStats.triangleMs, m_meshStats.weldMs);
+    }
 
-	void RGBDvision::generatePointCloud() {
-        float cx = 325.5;
-        float cy = 253.5;
-        float fx = 518.0;
-        float fy = 519.0;
-        float depthScale = 1000.0;
+    template <typename Particle, typename WriteChunk>
+    void RGBDvision::forEachChunk(Particle* dst, const WriteChunk& write) const {
+        const int grainSize = 1 << 14;
+        for (size_t i = 0; i < m_pointCloudPositions.size(); i++) {
+            const int pointNum = static_cast<int>(m_pointCloudPositions[i].size());
+            m_threadPool.parallelFor(0, pointNum, grainSize, [&](int begin, int end) {
+                write(i, begin, end, dst + begin);
+            });
+            dst += pointNum;
+        }
+    }
 
-        int imageNum = 5;
-        std::vector<std::vector<glm::vec4>> pointCloud_position(imageNum);
-        std::vector<std::vector<glm::vec4>> pointCloud_color(imageNum);
-        std::vector<int> particleNum(imageNum);
+    void RGBDvision::writeParticles(ParticleInstance* dst) const {
+        forEachChunk(dst, [this](size_t cloud, int begin, int end, ParticleInstance* out) {
+            const glm::vec4* positions = m_pointCloudPositions[cloud].data();
+            const glm::vec4* colors = m_pointCloudColors[cloud].data();
+            for (int j = begin; j < end; j++) {
+                *out++ = ParticleInstance(positions[j], colors[j]);
+            }
+        });
+    }
 
-        for (int i = 0; i < imageNum; i++) {
-            std::cout << "Converting RGBD images " << i + 1 << std::endl;
-            cv::Mat color = m_colorImgs[i];
-            cv::Mat depth = m_depthImgs[i];
+    void RGBDvision::writeParticles(CompactParticleInstance* dst, const PointQuantizer& quantizer) const {
+        forEachChunk(dst, [this, &quantizer](size_t cloud, int begin, int end, CompactParticleInstance* out) {
+            const glm::vec4* positions = m_pointCloudPositions[cloud].data();
+            const glm::vec4* colors = m_pointCloudColors[cloud].data();
+            for (int j = begin; j < end; j++) {
+                *out++ = quantizer.encode(positions[j], colors[j]);
+            }
+        });
+    }
 
-            const char* windowName = "OpenCV window";
-            cv::imshow(windowName, color);
-            cv::waitKey(0);
+    void RGBDvision::getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+        boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+        for (const std::vector<glm::vec4>& positions : m_pointCloudPositions) {
+            for (const glm::vec4& position : positions) {
+                boundsMin = glm::min(boundsMin, glm::vec3(position));
+                boundsMax = glm::max(boundsMax, glm::vec3(position));
+            }
+        }
+        if (getTotalParticleNum() == 0) {
+            boundsMin = boundsMax = glm::vec3(0.f);
+        }
+    }
 
-            pointCloud_position[i].reserve(color.rows * color.cols);
-            pointCloud_color[i].reserve(color.rows * color.cols);
+    void RGBDvision::releasePointCloud() {
+        std::vector<std::vector<glm::vec4>>().swap(m_pointCloudPositions);
+        std::vector<std::vector<glm::vec4>>().swap(m_pointCloudColors);
+    }
 
-            // set camera pose
-            setViewPose(m_cameraPos[i], m_cameraRotation[i]);
-
-            for (int v = 0; v < color.rows; v++) {
-                for (int u = 0; u < color.cols; u++) {
-                    unsigned int d = depth.ptr<unsigned short>(v)[u];
-                    if (d == 0) {
-                        continue;
-                    }
-
-                    glm::vec4 point{ 1.f };
-                    point[2] = float(d) / depthScale;
-                    point[0] = (u - cx) * point[2] / fx;
-                    point[1] = (v - cy) * point[2] / fy;
-                    glm::vec4 pointWorld = m_inverseViewMatrix * point;
-
-                    glm::vec4 pointColor{ 1.f };
-                    pointColor[0] = color.data[v * color.step + u * color.channels() + 2] / 255.f; // red
-                    pointColor[1] = color.data[v * color.step + u * color.channels() + 1] / 255.f; // green
-                    pointColor[2] = color.data[v * color.step + u * color.channels()] / 255.f;     // blue
-
-                    pointCloud_position[i].emplace_back(pointWorld);
-                    pointCloud_color[i].emplace_back(pointColor);
-                }
-            }
-            particleNum[i] = pointCloud_position[i].size();
+    size_t RGBDvision::getTotalParticleNum() const {
+        size_t total = 0;
+        for (int num : m_particleNum) {
+            total += num;
         }
-        m_particleSystem.setPointCloud(imageNum, particleNum, pointCloud_position, pointCloud_color);
+        return total;
+    }
+
+    uint64_t RGBDvision::hashInputs(const std::vector<float>& settings) const {
+        const TSDFVolume::Settings& tsdfSettings = m_tsdfVolume.getSettings();
+        std::vector<float> reconstructionSettings{
+            static_cast<float>(m_reconstructionMode),
+            tsdfSettings.voxelSize,
+            tsdfSettings.truncation,
+            tsdfSettings.maxWeight,
+            tsdfSettings.maxDepth
+        };
+        reconstructionSettings.insert(reconstructionSettings.end(), settings.begin(), settings.end());
+        return PointCloudCache::hashInputs(RGBD_DATA_PATH, m_intrinsics, reconstructionSettings);
     }
 
     void RGBDvision::setViewPose(glm::vec3 position, glm::mat4 rotationMat) {
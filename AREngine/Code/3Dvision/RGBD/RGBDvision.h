@@ -1,28 +1,118 @@
 #pragma once
 
-#include "../../Utils/AREngineIncludes.h"
-#include "../../Camera.h"
-#include "../../ParticleSystem/ParticleSystem.h"
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "../../Utils/AREngineDefines.h"
+#include "../../Utils/ThreadPool.h"
+#include "BackProjector.h"
+#include "RGBDFrameLoader.h"
+#include "PointCloudCache.h"
+#include "../Filter/VoxelGridFilter.h"
+#include "../TSDF/TSDFVolume.h"
+#include "../../ParticleSystem/ParticleInstance.h"
 
 namespace AE {
 
+	// Reconstructs the RGBD sequence either into one point cloud per frame (PointAccumulation)
+	// or by fusing every frame into a TSDF volume and extracting one cloud from its surface (TSDFFusion).
+	// Has no Vulkan/GLFW dependency so that it can also be driven by HeadlessIngest.
 	class RGBDvision {
 	public:
-		RGBDvision(ParticleSystem& particleSystem)
-			: m_particleSystem{ particleSystem }
-		{}
+		enum class ReconstructionMode {
+			PointAccumulation,
+			TSDFFusion
+		};
+
+		struct StageTimings {
+			double poseMs = 0.0;        // pose.txt
+			double decodeWaitMs = 0.0;  // back-projection stalled on image decode
+			double backProjectMs = 0.0; // sum over all frames
+			double generateMs = 0.0;    // generatePointCloud() wall time, decode overlaps with back-projection
+			double downsampleMs = 0.0;  // downsamplePointCloud()
+			double fusionMs = 0.0;      // TSDF integration, sum over all frames
+			double extractMs = 0.0;     // TSDF surface extraction
+			double meshMs = 0.0;        // generateMesh()
+		};
 
+		RGBDvision(ThreadPool& threadPool)
+			: m_threadPool{ threadPool }
+			, m_frameLoader{ RGBD_FRAME_RING_SIZE, RGBD_IO_THREAD_NUM }
+			, m_backProjector{ threadPool }
+			, m_voxelGridFilter{ threadPool }
+			, m_tsdfVolume{ threadPool }
+		{
+			m_backProjector.setIntrinsics(m_intrinsics);
+#ifdef RGBD_TSDF_FUSION
+			TSDFVolume::Settings settings{};
+			settings.voxelSize = TSDF_VOXEL_SIZE;
+			settings.truncation = TSDF_TRUNCATION;
+			m_tsdfVolume.setSettings(settings);
+			m_reconstructionMode = ReconstructionMode::TSDFFusion;
+#endif
+		}
+
+		// Reads pose.txt to find the frame count and starts streaming the frames
 		void setCameraExternalParameters();
-		void generatePointCloud();
+		// Back-projects or fuses the frames as they arrive from the loader. With extractSurfacePoints false a TSDFFusion
+		// reconstruction stops at the volume, e.g. when only generateMesh() follows.
+		void generatePointCloud(bool extractSurfacePoints = true);
+		// Fuses the per-frame clouds into a single cloud with one averaged point per occupied voxel
+		void downsamplePointCloud(float voxelSize);
+		// Marching cubes over the fused TSDF volume (TSDFFusion only)
+		void generateMesh();
 
 		void setViewPose(glm::vec3 position, glm::mat4 rotationMat);
 
+		// Write the clouds back to back into dst (getTotalParticleNum() points), e.g. a mapped PointCloud::IngestBuffer
+		void writeParticles(ParticleInstance* dst) const;
+		void writeParticles(CompactParticleInstance* dst, const PointQuantizer& quantizer) const;
+		// Bounding box over every cloud (zero when there are no points)
+		void getBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+		// Frees the positions and colors once they have been handed over, getParticleNum() is kept
+		void releasePointCloud();
+		// Cache key of the reconstruction: the RGBD inputs, the intrinsics, the reconstruction mode + TSDF settings
+		// and the caller's own settings (e.g. filter size, point format). Reads but does not decode the images.
+		uint64_t hashInputs(const std::vector<float>& settings) const;
+
+		void setReconstructionMode(ReconstructionMode mode) { m_reconstructionMode = mode; }
+		ReconstructionMode getReconstructionMode() const { return m_reconstructionMode; }
+		TSDFVolume& getTSDFVolume() { return m_tsdfVolume; }
+
+		int getFrameCount() const { return m_frameLoader.getFrameCount(); }
+		int getPointCloudNum() const { return static_cast<int>(m_particleNum.size()); }
+		size_t getTotalParticleNum() const;
+		const std::vector<int>& getParticleNum() const { return m_particleNum; }
+		const std::vector<std::vector<glm::vec4>>& getPointCloudPositions() const { return m_pointCloudPositions; }
+		const std::vector<std::vector<glm::vec4>>& getPointCloudColors() const { return m_pointCloudColors; }
+		const StageTimings& getStageTimings() const { return m_stageTimings; }
+		const TriangleMesh& getMesh() const { return m_mesh; }
+		const MarchingCubes::Stats& getMeshStats() const { return m_meshStats; }
+
 	private:
-		ParticleSystem& m_particleSystem;
-		std::vector<cv::Mat> m_colorImgs, m_depthImgs;
-		std::vector<glm::vec3> m_cameraPos;
-		std::vector<glm::mat4> m_cameraRotation;
+		// Calls write(cloud, begin, end, dst) for chunks of every cloud in parallel, dst already offset to the chunk
+		template <typename Particle, typename WriteChunk>
+		void forEachChunk(Particle* dst, const WriteChunk& write) const;
+
+		ThreadPool& m_threadPool;
+		RGBDFrameLoader m_frameLoader;
 		glm::mat4 m_inverseViewMatrix{ 1.f };
+		CameraIntrinsics m_intrinsics{};
+		BackProjector m_backProjector;
+		VoxelGridFilter m_voxelGridFilter;
+		TSDFVolume m_tsdfVolume;
+		ReconstructionMode m_reconstructionMode = ReconstructionMode::PointAccumulation;
+
+		std::vector<int> m_particleNum;
+		std::vector<std::vector<glm::vec4>> m_pointCloudPositions;
+		std::vector<std::vector<glm::vec4>> m_pointCloudColors;
+		TriangleMesh m_mesh;
+		MarchingCubes::Stats m_meshStats{};
+		StageTimings m_stageTimings{};
 	};
 
 } // namespace AE
\ No newline at end of file
@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <chrono>
+
+#include "MarchingCubes.h"
+#include "TSDFVolume.h"
+
+namespace AE {
+
+	const int MarchingCubes::s_cornerOffsets[8][3] = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+		{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+	};
+
+	const int MarchingCubes::s_edgeCorners[12][2] = {
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+
+	// Generated from the face connectivity of every corner sign mask: ambiguous faces separate the negative corners,
+	// and every polygon is fanned from a vertex whose diagonals do not run along a cube face.
+	// This keeps the surface watertight and manifold across neighbouring cells.
+	const uint16_t MarchingCubes::s_edgeTable[256] = {
+		0x000, 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
+		0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
+		0x190, 0x099, 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c,
+		0x99c, 0x895, 0xb9f, 0xa96, 0xd9a, 0xc93, 0xf99, 0xe90,
+		0x230, 0x339, 0x033, 0x13a, 0x636, 0x73f, 0x435, 0x53c,
+		0xa3c, 0xb35, 0x83f, 0x936, 0xe3a, 0xf33, 0xc39, 0xd30,
+		0x3a0, 0x2a9, 0x1a3, 0x0aa, 0x7a6, 0x6af, 0x5a5, 0x4ac,
+		0xbac, 0xaa5, 0x9af, 0x8a6, 0xfaa, 0xea3, 0xda9, 0xca0,
+		0x460, 0x569, 0x663, 0x76a, 0x066, 0x16f, 0x265, 0x36c,
+		0xc6c, 0xd65, 0xe6f, 0xf66, 0x86a, 0x963, 0xa69, 0xb60,
+		0x5f0, 0x4f9, 0x7f3, 0x6fa, 0x1f6, 0x0ff, 0x3f5, 0x2fc,
+		0xdfc, 0xcf5, 0xfff, 0xef6, 0x9fa, 0x8f3, 0xbf9, 0xaf0,
+		0x650, 0x759, 0x453, 0x55a, 0x256, 0x35f, 0x055, 0x15c,
+		0xe5c, 0xf55, 0xc5f, 0xd56, 0xa5a, 0xb53, 0x859, 0x950,
+		0x7c0, 0x6c9, 0x5c3, 0x4ca, 0x3c6, 0x2cf, 0x1c5, 0x0cc,
+		0xfcc, 0xec5, 0xdcf, 0xcc6, 0xbca, 0xac3, 0x9c9, 0x8c0,
+		0x8c0, 0x9c9, 0xac3, 0xbca, 0xcc6, 0xdcf, 0xec5, 0xfcc,
+		0x0cc, 0x1c5, 0x2cf, 0x3c6, 0x4ca, 0x5c3, 0x6c9, 0x7c0,
+		0x950, 0x859, 0xb53, 0xa5a, 0xd56, 0xc5f, 0xf55, 0xe5c,
+		0x15c, 0x055, 0x35f, 0x256, 0x55a, 0x453, 0x759, 0x650,
+		0xaf0, 0xbf9, 0x8f3, 0x9fa, 0xef6, 0xfff, 0xcf5, 0xdfc,
+		0x2fc, 0x3f5, 0x0ff, 0x1f6, 0x6fa, 0x7f3, 0x4f9, 0x5f0,
+		0xb60, 0xa69, 0x963, 0x86a, 0xf66, 0xe6f, 0xd65, 0xc6c,
+		0x36c, 0x265, 0x16f, 0x066, 0x76a, 0x663, 0x569, 0x460,
+		0xca0, 0xda9, 0xea3, 0xfaa, 0x8a6, 0x9af, 0xaa5, 0xbac,
+		0x4ac, 0x5a5, 0x6af, 0x7a6, 0x0aa, 0x1a3, 0x2a9, 0x3a0,
+		0xd30, 0xc39, 0xf33, 0xe3a, 0x936, 0x83f, 0xb35, 0xa3c,
+		0x53c, 0x435, 0x73f, 0x636, 0x13a, 0x033, 0x339, 0x230,
+		0xe90, 0xf99, 0xc93, 0xd9a, 0xa96, 0xb9f, 0x895, 0x99c,
+		0x69c, 0x795, 0x49f, 0x596, 0x29a, 0x393, 0x099, 0x190,
+		0xf00, 0xe09, 0xd03, 0xc0a, 0xb06, 0xa0f, 0x905, 0x80c,
+		0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x000
+	};
+
+	const int8_t MarchingCubes::s_triangleTable[256][16] = {
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9, 10,  2,  9,  2,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  9,  2,  9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11,  3,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0, 11,  3,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  8,  1,  8,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 11,  3, 10,  3,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10, 11,  0, 11,  8, -1, -1, -1, -1, -1, -1, -1 },
+		{  9, 10, 11,  9, 11,  3,  9,  3,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  9, 10,  8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  7,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  7,  1,  7,  4,  1,  4,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  4, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9, 10,  2,  9,  2,  0,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  7,  2,  7,  4,  2,  4,  9,  2,  9, 10, -1, -1, -1, -1 },
+		{ 11,  3,  2,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  7,  0,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0, 11,  3,  2,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  7,  1,  7,  4,  1,  4,  9, -1, -1, -1, -1 },
+		{ 10, 11,  3, 10,  3,  1,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10, 11,  0, 11,  7,  0,  7,  4, -1, -1, -1, -1 },
+		{  9, 10, 11,  9, 11,  3,  9,  3,  0,  8,  7,  4, -1, -1, -1, -1 },
+		{  9, 10, 11,  9, 11,  7,  9,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5,  1,  4,  1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  4,  1,  4,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8, 10,  2,  1,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5, 10,  4, 10,  2,  4,  2,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  4,  2,  4,  5,  2,  5, 10, -1, -1, -1, -1 },
+		{ 11,  3,  2,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  8,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5,  1,  4,  1,  0, 11,  3,  2, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  8,  1,  8,  4,  1,  4,  5, -1, -1, -1, -1 },
+		{ 10, 11,  3, 10,  3,  1,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10, 11,  0, 11,  8,  4,  5,  9, -1, -1, -1, -1 },
+		{  4,  5, 10,  4, 10, 11,  4, 11,  3,  4,  3,  0, -1, -1, -1, -1 },
+		{  4,  5, 10,  4, 10, 11,  4, 11,  8, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  8,  7,  9,  7,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  5,  0,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  7,  5,  8,  5,  1,  8,  1,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  7,  1,  7,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1,  9,  8,  7,  9,  7,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  5,  0,  5,  9, 10,  2,  1, -1, -1, -1, -1 },
+		{  8,  7,  5,  8,  5, 10,  8, 10,  2,  8,  2,  0, -1, -1, -1, -1 },
+		{  2,  3,  7,  2,  7,  5,  2,  5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11,  3,  2,  9,  8,  7,  9,  7,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  7,  0,  7,  5,  0,  5,  9, -1, -1, -1, -1 },
+		{  8,  7,  5,  8,  5,  1,  8,  1,  0, 11,  3,  2, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  7,  1,  7,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 11,  3, 10,  3,  1,  9,  8,  7,  9,  7,  5, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10, 11,  0, 11,  7,  0,  7,  5,  0,  5,  9, -1 },
+		{  5, 10, 11,  5, 11,  3,  5,  3,  0,  5,  0,  8,  5,  8,  7, -1 },
+		{ 10, 11,  7, 10,  7,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  9,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  5,  6,  2,  5,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  5,  6,  2,  5,  2,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  5,  6,  9,  6,  2,  9,  2,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  9,  2,  9,  5,  2,  5,  6, -1, -1, -1, -1 },
+		{ 11,  3,  2,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  8,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0, 11,  3,  2,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  8,  1,  8,  9,  5,  6, 10, -1, -1, -1, -1 },
+		{  5,  6, 11,  5, 11,  3,  5,  3,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1,  5,  0,  5,  6,  0,  6, 11,  0, 11,  8, -1, -1, -1, -1 },
+		{  9,  5,  6,  9,  6, 11,  9, 11,  3,  9,  3,  0, -1, -1, -1, -1 },
+		{  5,  6, 11,  5, 11,  8,  5,  8,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  7,  4,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  4,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  8,  7,  4,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  7,  1,  7,  4,  1,  4,  9,  5,  6, 10, -1, -1, -1, -1 },
+		{  5,  6,  2,  5,  2,  1,  8,  7,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  4,  5,  6,  2,  5,  2,  1, -1, -1, -1, -1 },
+		{  9,  5,  6,  9,  6,  2,  9,  2,  0,  8,  7,  4, -1, -1, -1, -1 },
+		{  2,  3,  7,  2,  7,  4,  2,  4,  9,  2,  9,  5,  2,  5,  6, -1 },
+		{ 11,  3,  2,  8,  7,  4,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  7,  0,  7,  4,  5,  6, 10, -1, -1, -1, -1 },
+		{  9,  1,  0, 11,  3,  2,  8,  7,  4,  5,  6, 10, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  7,  1,  7,  4,  1,  4,  9,  5,  6, 10, -1 },
+		{  5,  6, 11,  5, 11,  3,  5,  3,  1,  8,  7,  4, -1, -1, -1, -1 },
+		{  0,  1,  5,  0,  5,  6,  0,  6, 11,  0, 11,  7,  0,  7,  4, -1 },
+		{  9,  5,  6,  9,  6, 11,  9, 11,  3,  9,  3,  0,  8,  7,  4, -1 },
+		{  9,  5,  6,  9,  6, 11,  9, 11,  7,  9,  7,  4, -1, -1, -1, -1 },
+		{  4,  6, 10,  4, 10,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  4,  6, 10,  4, 10,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  6, 10,  4, 10,  1,  4,  1,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  4,  1,  4,  6,  1,  6, 10, -1, -1, -1, -1 },
+		{  9,  4,  6,  9,  6,  2,  9,  2,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  9,  4,  6,  9,  6,  2,  9,  2,  1, -1, -1, -1, -1 },
+		{  4,  6,  2,  4,  2,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  4,  2,  4,  6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11,  3,  2,  4,  6, 10,  4, 10,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  8,  4,  6, 10,  4, 10,  9, -1, -1, -1, -1 },
+		{  4,  6, 10,  4, 10,  1,  4,  1,  0, 11,  3,  2, -1, -1, -1, -1 },
+		{  1,  2, 11,  1, 11,  8,  1,  8,  4,  1,  4,  6,  1,  6, 10, -1 },
+		{  9,  4,  6,  9,  6, 11,  9, 11,  3,  9,  3,  1, -1, -1, -1, -1 },
+		{  1,  9,  4,  1,  4,  6,  1,  6, 11,  1, 11,  8,  1,  8,  0, -1 },
+		{  4,  6, 11,  4, 11,  3,  4,  3,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  6, 11,  4, 11,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  9,  8, 10,  8,  7, 10,  7,  6, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  7,  0,  7,  6,  0,  6, 10,  0, 10,  9, -1, -1, -1, -1 },
+		{  8,  7,  6,  8,  6, 10,  8, 10,  1,  8,  1,  0, -1, -1, -1, -1 },
+		{  1,  3,  7,  1,  7,  6,  1,  6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  8,  7,  9,  7,  6,  9,  6,  2,  9,  2,  1, -1, -1, -1, -1 },
+		{  7,  6,  2,  7,  2,  1,  7,  1,  9,  7,  9,  0,  7,  0,  3, -1 },
+		{  8,  7,  6,  8,  6,  2,  8,  2,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  7,  2,  7,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11,  3,  2, 10,  9,  8, 10,  8,  7, 10,  7,  6, -1, -1, -1, -1 },
+		{  0,  2, 11,  0, 11,  7,  0,  7,  6,  0,  6, 10,  0, 10,  9, -1 },
+		{  8,  7,  6,  8,  6, 10,  8, 10,  1,  8,  1,  0, 11,  3,  2, -1 },
+		{  1,  2, 11,  1, 11,  7,  1,  7,  6,  1,  6, 10, -1, -1, -1, -1 },
+		{  9,  8,  7,  9,  7,  6,  9,  6, 11,  9, 11,  3,  9,  3,  1, -1 },
+		{  0,  1,  9, 11,  7,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  6, 11,  3,  6,  3,  0,  6,  0,  8,  6,  8,  7, -1, -1, -1, -1 },
+		{ 11,  7,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8, 10,  2,  1,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{  9, 10,  2,  9,  2,  0,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  9,  2,  9, 10,  6,  7, 11, -1, -1, -1, -1 },
+		{  6,  7,  3,  6,  3,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2,  6,  0,  6,  7,  0,  7,  8, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  6,  7,  3,  6,  3,  2, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  2,  6,  1,  6,  7,  1,  7,  8,  1,  8,  9, -1, -1, -1, -1 },
+		{ 10,  6,  7, 10,  7,  3, 10,  3,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10,  6,  0,  6,  7,  0,  7,  8, -1, -1, -1, -1 },
+		{  9, 10,  6,  9,  6,  7,  9,  7,  3,  9,  3,  0, -1, -1, -1, -1 },
+		{  6,  7,  8,  6,  8,  9,  6,  9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  8, 11,  6,  8,  6,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11,  6,  0,  6,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  8, 11,  6,  8,  6,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3, 11,  1, 11,  6,  1,  6,  4,  1,  4,  9, -1, -1, -1, -1 },
+		{ 10,  2,  1,  8, 11,  6,  8,  6,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11,  6,  0,  6,  4, 10,  2,  1, -1, -1, -1, -1 },
+		{  9, 10,  2,  9,  2,  0,  8, 11,  6,  8,  6,  4, -1, -1, -1, -1 },
+		{  3, 11,  6,  3,  6,  4,  3,  4,  9,  3,  9, 10,  3, 10,  2, -1 },
+		{  6,  4,  8,  6,  8,  3,  6,  3,  2, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2,  6,  0,  6,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  6,  4,  8,  6,  8,  3,  6,  3,  2, -1, -1, -1, -1 },
+		{  1,  2,  6,  1,  6,  4,  1,  4,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  6,  4, 10,  4,  8, 10,  8,  3, 10,  3,  1, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10,  6,  0,  6,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  6,  4, 10,  4,  8, 10,  8,  3, 10,  3,  0, 10,  0,  9, -1 },
+		{  9, 10,  6,  9,  6,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  5,  1,  4,  1,  0,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  4,  1,  4,  5,  6,  7, 11, -1, -1, -1, -1 },
+		{ 10,  2,  1,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8, 10,  2,  1,  4,  5,  9,  6,  7, 11, -1, -1, -1, -1 },
+		{  4,  5, 10,  4, 10,  2,  4,  2,  0,  6,  7, 11, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  4,  2,  4,  5,  2,  5, 10,  6,  7, 11, -1 },
+		{  6,  7,  3,  6,  3,  2,  4,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2,  6,  0,  6,  7,  0,  7,  8,  4,  5,  9, -1, -1, -1, -1 },
+		{  4,  5,  1,  4,  1,  0,  6,  7,  3,  6,  3,  2, -1, -1, -1, -1 },
+		{  1,  2,  6,  1,  6,  7,  1,  7,  8,  1,  8,  4,  1,  4,  5, -1 },
+		{ 10,  6,  7, 10,  7,  3, 10,  3,  1,  4,  5,  9, -1, -1, -1, -1 },
+		{  0,  1, 10,  0, 10,  6,  0,  6,  7,  0,  7,  8,  4,  5,  9, -1 },
+		{ 10,  6,  7, 10,  7,  3, 10,  3,  0, 10,  0,  4, 10,  4,  5, -1 },
+		{ 10,  6,  7, 10,  7,  8, 10,  8,  4, 10,  4,  5, -1, -1, -1, -1 },
+		{  9,  8, 11,  9, 11,  6,  9,  6,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11,  6,  0,  6,  5,  0,  5,  9, -1, -1, -1, -1 },
+		{  8, 11,  6,  8,  6,  5,  8,  5,  1,  8,  1,  0, -1, -1, -1, -1 },
+		{  1,  3, 11,  1, 11,  6,  1,  6,  5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  2,  1,  9,  8, 11,  9, 11,  6,  9,  6,  5, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11,  6,  0,  6,  5,  0,  5,  9, 10,  2,  1, -1 },
+		{  8, 11,  6,  8,  6,  5,  8,  5, 10,  8, 10,  2,  8,  2,  0, -1 },
+		{  3, 11,  6,  3,  6,  5,  3,  5, 10,  3, 10,  2, -1, -1, -1, -1 },
+		{  6,  5,  9,  6,  9,  8,  6,  8,  3,  6,  3,  2, -1, -1, -1, -1 },
+		{  0,  2,  6,  0,  6,  5,  0,  5,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  3,  2,  8,  2,  6,  8,  6,  5,  8,  5,  1,  8,  1,  0, -1 },
+		{  1,  2,  6,  1,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  6,  5,  9,  6,  9,  8,  6,  8,  3,  6,  3,  1,  6,  1, 10, -1 },
+		{  0,  1, 10,  0, 10,  6,  0,  6,  5,  0,  5,  9, -1, -1, -1, -1 },
+		{  8,  3,  0, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  5,  7, 11,  5, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  5,  7, 11,  5, 11, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0,  5,  7, 11,  5, 11, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  9,  5,  7, 11,  5, 11, 10, -1, -1, -1, -1 },
+		{  5,  7, 11,  5, 11,  2,  5,  2,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  5,  7, 11,  5, 11,  2,  5,  2,  1, -1, -1, -1, -1 },
+		{  9,  5,  7,  9,  7, 11,  9, 11,  2,  9,  2,  0, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  9,  2,  9,  5,  2,  5,  7,  2,  7, 11, -1 },
+		{ 10,  5,  7, 10,  7,  3, 10,  3,  2, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 10,  0, 10,  5,  0,  5,  7,  0,  7,  8, -1, -1, -1, -1 },
+		{  9,  1,  0, 10,  5,  7, 10,  7,  3, 10,  3,  2, -1, -1, -1, -1 },
+		{  2, 10,  5,  2,  5,  7,  2,  7,  8,  2,  8,  9,  2,  9,  1, -1 },
+		{  5,  7,  3,  5,  3,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1,  5,  0,  5,  7,  0,  7,  8, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  5,  7,  9,  7,  3,  9,  3,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  5,  7,  8,  5,  8,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  8, 11, 10,  8, 10,  5,  8,  5,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11, 10,  0, 10,  5,  0,  5,  4, -1, -1, -1, -1 },
+		{  9,  1,  0,  8, 11, 10,  8, 10,  5,  8,  5,  4, -1, -1, -1, -1 },
+		{  3, 11, 10,  3, 10,  5,  3,  5,  4,  3,  4,  9,  3,  9,  1, -1 },
+		{  5,  4,  8,  5,  8, 11,  5, 11,  2,  5,  2,  1, -1, -1, -1, -1 },
+		{ 11,  2,  1, 11,  1,  5, 11,  5,  4, 11,  4,  0, 11,  0,  3, -1 },
+		{  5,  4,  8,  5,  8, 11,  5, 11,  2,  5,  2,  0,  5,  0,  9, -1 },
+		{  2,  3, 11,  9,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  5,  4, 10,  4,  8, 10,  8,  3, 10,  3,  2, -1, -1, -1, -1 },
+		{  0,  2, 10,  0, 10,  5,  0,  5,  4, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  1,  0, 10,  5,  4, 10,  4,  8, 10,  8,  3, 10,  3,  2, -1 },
+		{  2, 10,  5,  2,  5,  4,  2,  4,  9,  2,  9,  1, -1, -1, -1, -1 },
+		{  5,  4,  8,  5,  8,  3,  5,  3,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1,  5,  0,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  5,  4,  8,  5,  8,  3,  5,  3,  0,  5,  0,  9, -1, -1, -1, -1 },
+		{  9,  5,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  7, 11,  4, 11, 10,  4, 10,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3,  8,  4,  7, 11,  4, 11, 10,  4, 10,  9, -1, -1, -1, -1 },
+		{  4,  7, 11,  4, 11, 10,  4, 10,  1,  4,  1,  0, -1, -1, -1, -1 },
+		{  1,  3,  8,  1,  8,  4,  1,  4,  7,  1,  7, 11,  1, 11, 10, -1 },
+		{  9,  4,  7,  9,  7, 11,  9, 11,  2,  9,  2,  1, -1, -1, -1, -1 },
+		{  0,  3,  8,  9,  4,  7,  9,  7, 11,  9, 11,  2,  9,  2,  1, -1 },
+		{  4,  7, 11,  4, 11,  2,  4,  2,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3,  8,  2,  8,  4,  2,  4,  7,  2,  7, 11, -1, -1, -1, -1 },
+		{ 10,  9,  4, 10,  4,  7, 10,  7,  3, 10,  3,  2, -1, -1, -1, -1 },
+		{  2, 10,  9,  2,  9,  4,  2,  4,  7,  2,  7,  8,  2,  8,  0, -1 },
+		{  4,  7,  3,  4,  3,  2,  4,  2, 10,  4, 10,  1,  4,  1,  0, -1 },
+		{  1,  2, 10,  4,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  4,  7,  9,  7,  3,  9,  3,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  9,  4,  1,  4,  7,  1,  7,  8,  1,  8,  0, -1, -1, -1, -1 },
+		{  4,  7,  3,  4,  3,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  4,  7,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 10,  9, 11,  9,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  3, 11,  0, 11, 10,  0, 10,  9, -1, -1, -1, -1, -1, -1, -1 },
+		{  8, 11, 10,  8, 10,  1,  8,  1,  0, -1, -1, -1, -1, -1, -1, -1 },
+		{  1,  3, 11,  1, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  8, 11,  9, 11,  2,  9,  2,  1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11,  2,  1, 11,  1,  9, 11,  9,  0, 11,  0,  3, -1, -1, -1, -1 },
+		{  8, 11,  2,  8,  2,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  2,  3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10,  9,  8, 10,  8,  3, 10,  3,  2, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  2, 10,  0, 10,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  3,  2,  8,  2, 10,  8, 10,  1,  8,  1,  0, -1, -1, -1, -1 },
+		{  1,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  9,  8,  3,  9,  3,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  0,  1,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{  8,  3,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }
+	};
+
+	namespace {
+
+		constexpr int BLOCK_SIZE = TSDFVolume::BLOCK_SIZE;
+
+		int voxelIndex(int x, int y, int z) {
+			return (z * BLOCK_SIZE + y) * BLOCK_SIZE + x;
+		}
+
+		// Block indices of the block itself and of its +x/+y/+z neighbours, indexed by dx | dy << 1 | dz << 2
+		struct BlockNeighbourhood {
+			int blocks[8];
+		};
+
+		// Vertices on the voxel edges owned by one block (the edges starting at one of its voxels).
+		// Edge ids (voxelIndex * 3 + axis) are stored in ascending order for the lookup from the cells.
+		struct BlockVertices {
+			std::vector<uint16_t> edgeIds;
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> colors;
+			uint32_t firstVertex = 0;
+		};
+
+		double elapsedMs(std::chrono::high_resolution_clock::time_point startTime) {
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+
+	} // namespace
+
+	size_t MarchingCubes::extract(const TSDFVolume& volume, TriangleMesh& mesh) {
+		const int blockNum = static_cast<int>(volume.getBlockCount());
+		const float voxelSize = volume.getSettings().voxelSize;
+		mesh.clear();
+		m_lastStats = Stats{};
+
+		// 1. vertices on every crossed edge whose two voxels have been observed
+		auto startTime = std::chrono::high_resolution_clock::now();
+		std::vector<BlockNeighbourhood> neighbourhoods(blockNum);
+		std::vector<BlockVertices> blockVertices(blockNum);
+		m_threadPool.parallelFor(0, blockNum, 16, [&](int begin, int end) {
+			for (int b = begin; b < end; b++) {
+				const TSDFVolume::Block& block = volume.getBlock(b);
+				for (int n = 0; n < 8; n++) {
+					neighbourhoods[b].blocks[n] = n == 0 ? b : volume.findBlockIndex(block.coord + glm::ivec3{ n & 1, (n >> 1) & 1, (n >> 2) & 1 });
+				}
+
+				BlockVertices& vertices = blockVertices[b];
+				const glm::ivec3 origin = block.coord * BLOCK_SIZE;
+				for (int z = 0; z < BLOCK_SIZE; z++) {
+					for (int y = 0; y < BLOCK_SIZE; y++) {
+						for (int x = 0; x < BLOCK_SIZE; x++) {
+							const int index = voxelIndex(x, y, z);
+							const TSDFVolume::Voxel& v0 = block.voxels[index];
+							if (v0.weight <= 0.f) {
+								continue;
+							}
+							const glm::ivec3 local{ x, y, z };
+							for (int axis = 0; axis < 3; axis++) {
+								glm::ivec3 next = local;
+								next[axis]++;
+								const TSDFVolume::Voxel* v1;
+								if (next[axis] < BLOCK_SIZE) {
+									v1 = &block.voxels[voxelIndex(next.x, next.y, next.z)];
+								}
+								else {
+									int neighbour = neighbourhoods[b].blocks[1 << axis];
+									next[axis] = 0;
+									v1 = neighbour < 0 ? nullptr : &volume.getBlock(neighbour).voxels[voxelIndex(next.x, next.y, next.z)];
+								}
+								if (v1 == nullptr || v1->weight <= 0.f || (v0.sdf < 0.f) == (v1->sdf < 0.f)) {
+									continue;
+								}
+
+								float t = v0.sdf / (v0.sdf - v1->sdf);
+								glm::vec3 position = glm::vec3(origin + local) * voxelSize;
+								position[axis] += t * voxelSize;
+								glm::vec3 color;
+								for (int c = 0; c < 3; c++) {
+									color[c] = (v0.color[c] + t * (v1->color[c] - v0.color[c])) / 255.f;
+								}
+								vertices.edgeIds.push_back(static_cast<uint16_t>(index * 3 + axis));
+								vertices.positions.push_back(position);
+								vertices.colors.push_back(color);
+							}
+						}
+					}
+				}
+			}
+		});
+		uint32_t vertexNum = 0;
+		for (BlockVertices& vertices : blockVertices) {
+			vertices.firstVertex = vertexNum;
+			vertexNum += static_cast<uint32_t>(vertices.positions.size());
+		}
+		m_lastStats.vertexMs = elapsedMs(startTime);
+
+		// 2. triangles of every fully observed cell, referring to the vertices of the block owning each edge
+		startTime = std::chrono::high_resolution_clock::now();
+		std::vector<std::vector<uint32_t>> blockIndices(blockNum);
+		m_threadPool.parallelFor(0, blockNum, 16, [&](int begin, int end) {
+			const TSDFVolume::Voxel* corners[8];
+			for (int b = begin; b < end; b++) {
+				const BlockNeighbourhood& neighbourhood = neighbourhoods[b];
+				for (int z = 0; z < BLOCK_SIZE; z++) {
+					for (int y = 0; y < BLOCK_SIZE; y++) {
+						for (int x = 0; x < BLOCK_SIZE; x++) {
+							int cubeIndex = 0;
+							bool observed = true;
+							for (int i = 0; i < 8 && observed; i++) {
+								int cx = x + s_cornerOffsets[i][0];
+								int cy = y + s_cornerOffsets[i][1];
+								int cz = z + s_cornerOffsets[i][2];
+								int neighbour = neighbourhood.blocks[(cx / BLOCK_SIZE) | (cy / BLOCK_SIZE) << 1 | (cz / BLOCK_SIZE) << 2];
+								corners[i] = neighbour < 0 ? nullptr
+									: &volume.getBlock(neighbour).voxels[voxelIndex(cx % BLOCK_SIZE, cy % BLOCK_SIZE, cz % BLOCK_SIZE)];
+								observed = corners[i] != nullptr && corners[i]->weight > 0.f;
+								cubeIndex |= (observed && corners[i]->sdf < 0.f) << i;
+							}
+							if (!observed || s_edgeTable[cubeIndex] == 0) {
+								continue;
+							}
+
+							uint32_t edgeVertices[12];
+							for (int e = 0; e < 12; e++) {
+								if ((s_edgeTable[cubeIndex] & (1 << e)) == 0) {
+									continue;
+								}
+								// The edge is owned by the block of its lower corner
+								int c0 = s_edgeCorners[e][0];
+								int c1 = s_edgeCorners[e][1];
+								int axis = 0;
+								while (s_cornerOffsets[c0][axis] == s_cornerOffsets[c1][axis]) {
+									axis++;
+								}
+								int lowerCorner = s_cornerOffsets[c0][axis] < s_cornerOffsets[c1][axis] ? c0 : c1;
+								int lx = x + s_cornerOffsets[lowerCorner][0];
+								int ly = y + s_cornerOffsets[lowerCorner][1];
+								int lz = z + s_cornerOffsets[lowerCorner][2];
+								const BlockVertices& owner = blockVertices[neighbourhood.blocks[(lx / BLOCK_SIZE) | (ly / BLOCK_SIZE) << 1 | (lz / BLOCK_SIZE) << 2]];
+								uint16_t edgeId = static_cast<uint16_t>(voxelIndex(lx % BLOCK_SIZE, ly % BLOCK_SIZE, lz % BLOCK_SIZE) * 3 + axis);
+								auto it = std::lower_bound(owner.edgeIds.begin(), owner.edgeIds.end(), edgeId);
+								edgeVertices[e] = owner.firstVertex + static_cast<uint32_t>(it - owner.edgeIds.begin());
+							}
+
+							for (int i = 0; s_triangleTable[cubeIndex][i] != -1; i++) {
+								blockIndices[b].push_back(edgeVertices[s_triangleTable[cubeIndex][i]]);
+							}
+						}
+					}
+				}
+			}
+		});
+		m_lastStats.triangleMs = elapsedMs(startTime);
+
+		// 3. drop the vertices that no fully observed cell uses, then area weighted normals
+		startTime = std::chrono::high_resolution_clock::now();
+		std::vector<uint32_t> remap(vertexNum, UINT32_MAX);
+		size_t indexNum = 0;
+		for (const std::vector<uint32_t>& indices : blockIndices) {
+			indexNum += indices.size();
+		}
+		mesh.indices.reserve(indexNum);
+		uint32_t usedNum = 0;
+		for (const std::vector<uint32_t>& indices : blockIndices) {
+			for (uint32_t index : indices) {
+				if (remap[index] == UINT32_MAX) {
+					remap[index] = usedNum++;
+				}
+				mesh.indices.push_back(remap[index]);
+			}
+		}
+		mesh.positions.resize(usedNum);
+		mesh.colors.resize(usedNum);
+		mesh.normals.assign(usedNum, glm::vec3{ 0.f });
+		m_threadPool.parallelFor(0, blockNum, 64, [&](int begin, int end) {
+			for (int b = begin; b < end; b++) {
+				const BlockVertices& vertices = blockVertices[b];
+				for (size_t i = 0; i < vertices.positions.size(); i++) {
+					uint32_t index = remap[vertices.firstVertex + i];
+					if (index != UINT32_MAX) {
+						mesh.positions[index] = vertices.positions[i];
+						mesh.colors[index] = vertices.colors[i];
+					}
+				}
+			}
+		});
+		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+			const glm::vec3& p0 = mesh.positions[mesh.indices[i]];
+			const glm::vec3 faceNormal = glm::cross(mesh.positions[mesh.indices[i + 1]] - p0, mesh.positions[mesh.indices[i + 2]] - p0);
+			for (int k = 0; k < 3; k++) {
+				mesh.normals[mesh.indices[i + k]] += faceNormal;
+			}
+		}
+		m_threadPool.parallelFor(0, static_cast<int>(usedNum), 1 << 14, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				float length = glm::length(mesh.normals[i]);
+				mesh.normals[i] = length > 0.f ? mesh.normals[i] / length : glm::vec3{ 0.f, 0.f, 1.f };
+			}
+		});
+		m_lastStats.weldMs = elapsedMs(startTime);
+
+		m_lastStats.triangleNum = mesh.getTriangleCount();
+		m_lastStats.vertexNum = mesh.positions.size();
+		return mesh.getTriangleCount();
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "../../Utils/ThreadPool.h"
+
+namespace AE {
+
+	class TSDFVolume;
+
+	// Indexed triangle list. Vertices shared by neighbouring triangles are stored once.
+	struct TriangleMesh {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> colors;
+		std::vector<glm::vec3> normals;
+		std::vector<uint32_t> indices;
+
+		size_t getTriangleCount() const { return indices.size() / 3; }
+		void clear() {
+			positions.clear();
+			colors.clear();
+			normals.clear();
+			indices.clear();
+		}
+	};
+
+	// Extracts the zero level set of a TSDFVolume.
+	// Only cells whose 8 corners have been observed produce triangles, so unobserved space is left open.
+	// Triangles are wound counter-clockwise seen from the positive (free space) side and normals point that way.
+	// Blocks are processed in parallel: every block first creates the vertices of the voxel edges it owns,
+	// then triangulates its cells referring to its own and its +x/+y/+z neighbours' vertices, so that vertices are welded across blocks.
+	class MarchingCubes {
+	public:
+		struct Stats {
+			size_t triangleNum = 0;
+			size_t vertexNum = 0;
+			double vertexMs = 0.0;   // edge vertices of all blocks
+			double triangleMs = 0.0; // cell triangulation of all blocks
+			double weldMs = 0.0;     // compaction of the unreferenced vertices + normals
+		};
+
+		MarchingCubes(ThreadPool& threadPool) : m_threadPool{ threadPool } {}
+
+		// Returns the number of triangles
+		size_t extract(const TSDFVolume& volume, TriangleMesh& mesh);
+		const Stats& getLastStats() const { return m_lastStats; }
+
+		// 12 bit mask of the cube edges crossed by the surface, indexed by the corner sign mask
+		static const uint16_t s_edgeTable[256];
+		// Up to 5 triangles as cube edge triplets per corner sign mask, terminated by -1
+		static const int8_t s_triangleTable[256][16];
+		// Corner offsets and the two corners of every edge (corner i has its bit i set in the sign mask)
+		static const int s_cornerOffsets[8][3];
+		static const int s_edgeCorners[12][2];
+
+	private:
+		ThreadPool& m_threadPool;
+		Stats m_lastStats{};
+	};
+
+} // namespace AE
\ No newline at end of file
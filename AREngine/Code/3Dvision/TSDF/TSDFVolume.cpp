@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+#include "TSDFVolume.h"
+
+namespace AE {
+
+	namespace {
+
+		int floorDiv(int value, int divisor) {
+			int quotient = value / divisor;
+			return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+		}
+
+		int voxelIndex(int x, int y, int z) {
+			return (z * TSDFVolume::BLOCK_SIZE + y) * TSDFVolume::BLOCK_SIZE + x;
+		}
+
+		// Inverse of a rotation + translation matrix
+		glm::mat4 rigidInverse(const glm::mat4& m) {
+			glm::mat4 inverse{ 1.f };
+			for (int c = 0; c < 3; c++) {
+				for (int r = 0; r < 3; r++) {
+					inverse[c][r] = m[r][c];
+				}
+			}
+			for (int r = 0; r < 3; r++) {
+				inverse[3][r] = -(m[r][0] * m[3][0] + m[r][1] * m[3][1] + m[r][2] * m[3][2]);
+			}
+			return inverse;
+		}
+
+	} // namespace
+
+	void TSDFVolume::setSettings(const Settings& settings) {
+		if (settings.voxelSize <= 0.f || settings.truncation <= 0.f) {
+			throw std::runtime_error("voxel size and truncation of the TSDF volume must be positive!");
+		}
+		m_settings = settings;
+		reset();
+	}
+
+	void TSDFVolume::reset() {
+		m_blockIndices.clear();
+		m_blocks.clear();
+		m_stats = Stats{};
+	}
+
+	uint64_t TSDFVolume::packBlockKey(const glm::ivec3& blockCoord) {
+		// 21 bits per axis, biased so that negative block coordinates stay positive
+		const int64_t bias = 1 << 20;
+		const uint64_t mask = (1ull << 21) - 1;
+		return ((static_cast<uint64_t>(blockCoord.x + bias) & mask) << 42)
+			| ((static_cast<uint64_t>(blockCoord.y + bias) & mask) << 21)
+			| (static_cast<uint64_t>(blockCoord.z + bias) & mask);
+	}
+
+	const TSDFVolume::Block* TSDFVolume::findBlock(const glm::ivec3& blockCoord) const {
+		auto it = m_blockIndices.find(packBlockKey(blockCoord));
+		return it == m_blockIndices.end() ? nullptr : m_blocks[it->second].get();
+	}
+
+	int TSDFVolume::findBlockIndex(const glm::ivec3& blockCoord) const {
+		auto it = m_blockIndices.find(packBlockKey(blockCoord));
+		return it == m_blockIndices.end() ? -1 : static_cast<int>(it->second);
+	}
+
+	const TSDFVolume::Voxel* TSDFVolume::findVoxel(const glm::ivec3& voxelCoord) const {
+		glm::ivec3 blockCoord{
+			floorDiv(voxelCoord.x, BLOCK_SIZE),
+			floorDiv(voxelCoord.y, BLOCK_SIZE),
+			floorDiv(voxelCoord.z, BLOCK_SIZE)
+		};
+		const Block* block = findBlock(blockCoord);
+		if (block == nullptr) {
+			return nullptr;
+		}
+		return &block->voxels[voxelIndex(
+			voxelCoord.x - blockCoord.x * BLOCK_SIZE,
+			voxelCoord.y - blockCoord.y * BLOCK_SIZE,
+			voxelCoord.z - blockCoord.z * BLOCK_SIZE)];
+	}
+
+	size_t TSDFVolume::getMemoryUsage() const {
+		return m_blocks.size() * (sizeof(Block) + sizeof(std::unique_ptr<Block>))
+			+ m_blockIndices.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+	}
+
+	void TSDFVolume::allocateBlocks(
+		const cv::Mat& depth,
+		const CameraIntrinsics& intrinsics,
+		const glm::mat4& cameraToWorld,
+		std::vector<uint32_t>& touchedBlocks)
+	{
+		// Every depth sample touches the blocks along its ray within the truncation band
+		const float blockEdge = m_settings.voxelSize * BLOCK_SIZE;
+		const float inverseBlockEdge = 1.f / blockEdge;
+		const float step = std::min(m_settings.truncation, blockEdge * 0.5f);
+		const int stepNum = static_cast<int>(std::ceil(2.f * m_settings.truncation / step));
+
+		std::vector<uint64_t> keys;
+		std::mutex keysMutex;
+		m_threadPool.parallelFor(0, depth.rows, 16, [&](int rowBegin, int rowEnd) {
+			std::vector<uint64_t> localKeys;
+			uint64_t lastKey = ~0ull;
+			for (int v = rowBegin; v < rowEnd; v++) {
+				const uint16_t* depthRow = depth.ptr<uint16_t>(v);
+				for (int u = 0; u < depth.cols; u++) {
+					if (depthRow[u] == 0) {
+						continue;
+					}
+					float d = depthRow[u] / intrinsics.depthScale;
+					if (d > m_settings.maxDepth) {
+						continue;
+					}
+					// Camera space point at depth 1, scaled along the ray
+					glm::vec3 ray{ (u - intrinsics.cx) / intrinsics.fx, (v - intrinsics.cy) / intrinsics.fy, 1.f };
+					for (int s = 0; s <= stepNum; s++) {
+						float z = std::max(d - m_settings.truncation + s * step, 1e-3f);
+						glm::vec4 world = cameraToWorld * glm::vec4(ray * z, 1.f);
+						glm::ivec3 blockCoord{
+							static_cast<int>(std::floor(world.x * inverseBlockEdge)),
+							static_cast<int>(std::floor(world.y * inverseBlockEdge)),
+							static_cast<int>(std::floor(world.z * inverseBlockEdge))
+						};
+						uint64_t key = packBlockKey(blockCoord);
+						// Neighbouring samples mostly land in the same block
+						if (key != lastKey) {
+							localKeys.push_back(key);
+							lastKey = key;
+						}
+					}
+				}
+			}
+			std::sort(localKeys.begin(), localKeys.end());
+			localKeys.erase(std::unique(localKeys.begin(), localKeys.end()), localKeys.end());
+			std::lock_guard<std::mutex> lock(keysMutex);
+			keys.insert(keys.end(), localKeys.begin(), localKeys.end());
+		});
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		const int64_t bias = 1 << 20;
+		const uint64_t mask = (1ull << 21) - 1;
+		touchedBlocks.clear();
+		touchedBlocks.reserve(keys.size());
+		for (uint64_t key : keys) {
+			auto result = m_blockIndices.emplace(key, static_cast<uint32_t>(m_blocks.size()));
+			if (result.second) {
+				std::unique_ptr<Block> block = std::make_unique<Block>();
+				block->coord = glm::ivec3{
+					static_cast<int>(static_cast<int64_t>((key >> 42) & mask) - bias),
+					static_cast<int>(static_cast<int64_t>((key >> 21) & mask) - bias),
+					static_cast<int>(static_cast<int64_t>(key & mask) - bias)
+				};
+				m_blocks.emplace_back(std::move(block));
+			}
+			touchedBlocks.push_back(result.first->second);
+		}
+	}
+
+	void TSDFVolume::integrate(
+		const cv::Mat& color,
+		const cv::Mat& depth,
+		const CameraIntrinsics& intrinsics,
+		const glm::mat4& cameraToWorld)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<uint32_t> touchedBlocks;
+		allocateBlocks(depth, intrinsics, cameraToWorld, touchedBlocks);
+
+		const glm::mat4 worldToCamera = rigidInverse(cameraToWorld);
+		const glm::vec4 voxelStepX = worldToCamera[0] * m_settings.voxelSize;
+		const float inverseTruncation = 1.f / m_settings.truncation;
+		const int channels = color.channels();
+
+		m_threadPool.parallelFor(0, static_cast<int>(touchedBlocks.size()), 8, [&](int begin, int end) {
+			for (int b = begin; b < end; b++) {
+				Block& block = *m_blocks[touchedBlocks[b]];
+				const glm::ivec3 origin = block.coord * BLOCK_SIZE;
+				for (int z = 0; z < BLOCK_SIZE; z++) {
+					for (int y = 0; y < BLOCK_SIZE; y++) {
+						glm::vec4 world{
+							origin.x * m_settings.voxelSize,
+							(origin.y + y) * m_settings.voxelSize,
+							(origin.z + z) * m_settings.voxelSize,
+							1.f
+						};
+						glm::vec4 camera = worldToCamera * world;
+						for (int x = 0; x < BLOCK_SIZE; x++, camera += voxelStepX) {
+							if (camera.z <= 0.f) {
+								continue;
+							}
+							int u = static_cast<int>(std::floor(intrinsics.fx * camera.x / camera.z + intrinsics.cx + 0.5f));
+							int v = static_cast<int>(std::floor(intrinsics.fy * camera.y / camera.z + intrinsics.cy + 0.5f));
+							if (u < 0 || v < 0 || u >= depth.cols || v >= depth.rows) {
+								continue;
+							}
+							uint16_t rawDepth = depth.ptr<uint16_t>(v)[u];
+							if (rawDepth == 0) {
+								continue;
+							}
+							float d = rawDepth / intrinsics.depthScale;
+							float sdf = d - camera.z;
+							if (d > m_settings.maxDepth || sdf < -m_settings.truncation) {
+								continue;
+							}
+
+							Voxel& voxel = block.voxels[voxelIndex(x, y, z)];
+							float tsdf = std::min(1.f, sdf * inverseTruncation);
+							float weight = voxel.weight + 1.f;
+							voxel.sdf = (voxel.sdf * voxel.weight + tsdf) / weight;
+							const uint8_t* pixel = color.data + v * color.step + u * channels;
+							// BGR -> RGB
+							for (int c = 0; c < 3; c++) {
+								float blended = (voxel.color[c] * voxel.weight + pixel[2 - c]) / weight;
+								voxel.color[c] = static_cast<uint8_t>(blended + 0.5f);
+							}
+							voxel.weight = std::min(weight, m_settings.maxWeight);
+						}
+					}
+				}
+			}
+		});
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_stats.frameNum++;
+		m_stats.blocksTouched = touchedBlocks.size();
+		m_stats.integrateMs += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	}
+
+	size_t TSDFVolume::extractPointCloud(std::vector<glm::vec4>& positions, std::vector<glm::vec4>& colors) const {
+		// Points are gathered per block and concatenated in block order, so the result does not depend on the thread count
+		std::vector<std::vector<glm::vec4>> blockPositions(m_blocks.size());
+		std::vector<std::vector<glm::vec4>> blockColors(m_blocks.size());
+		const float voxelSize = m_settings.voxelSize;
+
+		m_threadPool.parallelFor(0, static_cast<int>(m_blocks.size()), 16, [&](int begin, int end) {
+			for (int b = begin; b < end; b++) {
+				const Block& block = *m_blocks[b];
+				const glm::ivec3 origin = block.coord * BLOCK_SIZE;
+				for (int z = 0; z < BLOCK_SIZE; z++) {
+					for (int y = 0; y < BLOCK_SIZE; y++) {
+						for (int x = 0; x < BLOCK_SIZE; x++) {
+							const Voxel& voxel = block.voxels[voxelIndex(x, y, z)];
+							if (voxel.weight <= 0.f) {
+								continue;
+							}
+							const glm::ivec3 local{ x, y, z };
+							for (int axis = 0; axis < 3; axis++) {
+								glm::ivec3 neighbourLocal = local;
+								neighbourLocal[axis]++;
+								const Voxel* neighbour = neighbourLocal[axis] < BLOCK_SIZE
+									? &block.voxels[voxelIndex(neighbourLocal.x, neighbourLocal.y, neighbourLocal.z)]
+									: findVoxel(origin + neighbourLocal);
+								if (neighbour == nullptr || neighbour->weight <= 0.f || (voxel.sdf < 0.f) == (neighbour->sdf < 0.f)) {
+									continue;
+								}
+								float t = voxel.sdf / (voxel.sdf - neighbour->sdf);
+								glm::vec3 position = glm::vec3(origin + local) * voxelSize;
+								position[axis] += t * voxelSize;
+								glm::vec3 color;
+								for (int c = 0; c < 3; c++) {
+									color[c] = (voxel.color[c] + t * (neighbour->color[c] - voxel.color[c])) / 255.f;
+								}
+								blockPositions[b].emplace_back(position, 1.f);
+								blockColors[b].emplace_back(color, 1.f);
+							}
+						}
+					}
+				}
+			}
+		});
+
+		size_t pointNum = 0;
+		for (const std::vector<glm::vec4>& points : blockPositions) {
+			pointNum += points.size();
+		}
+		positions.clear();
+		colors.clear();
+		positions.reserve(pointNum);
+		colors.reserve(pointNum);
+		for (size_t b = 0; b < m_blocks.size(); b++) {
+			positions.insert(positions.end(), blockPositions[b].begin(), blockPositions[b].end());
+			colors.insert(colors.end(), blockColors[b].begin(), blockColors[b].end());
+		}
+		return pointNum;
+	}
+
+	size_t TSDFVolume::extractMesh(TriangleMesh& mesh, MarchingCubes::Stats* stats) const {
+		MarchingCubes marchingCubes{ m_threadPool };
+		size_t triangleNum = marchingCubes.extract(*this, mesh);
+		if (stats != nullptr) {
+			*stats = marchingCubes.getLastStats();
+		}
+		return triangleNum;
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "../../Utils/ThreadPool.h"
+#include "../RGBD/CameraIntrinsics.h"
+#include "MarchingCubes.h"
+
+namespace AE {
+
+	// Truncated signed distance field stored in 8x8x8 voxel blocks.
+	// Blocks are only allocated around observed surfaces and looked up through a hash map,
+	// so memory grows with the surface area of the scene instead of with its bounding box or the frame count.
+	// Voxel (i, j, k) is sampled at (i, j, k) * voxelSize in world space. Negative distances are behind the surface.
+	class TSDFVolume {
+	public:
+		static constexpr int BLOCK_SIZE = 8;
+		static constexpr int BLOCK_VOXEL_NUM = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+		struct Settings {
+			float voxelSize = 0.01f;   // world units (meters for the RGBD set)
+			float truncation = 0.04f;  // distances are clamped to [-truncation, truncation] and stored normalized
+			float maxWeight = 64.f;    // caps the running average so that the volume can still adapt
+			float maxDepth = 4.f;      // depth samples further away are ignored (meters)
+		};
+
+		struct Voxel {
+			float sdf = 1.f;      // normalized to [-1, 1]
+			float weight = 0.f;   // 0 = never observed
+			uint8_t color[4] = { 0, 0, 0, 0 }; // rgb + padding
+		};
+
+		struct Block {
+			glm::ivec3 coord;
+			Voxel voxels[BLOCK_VOXEL_NUM];
+		};
+
+		struct Stats {
+			int frameNum = 0;
+			double integrateMs = 0.0;    // sum over all frames
+			size_t blocksTouched = 0;    // by the last frame
+		};
+
+		TSDFVolume(ThreadPool& threadPool) : m_threadPool{ threadPool } {}
+
+		// Not copyable or movable
+		TSDFVolume(const TSDFVolume&) = delete;
+		TSDFVolume& operator=(const TSDFVolume&) = delete;
+		TSDFVolume(TSDFVolume&&) = delete;
+		TSDFVolume& operator=(TSDFVolume&&) = delete;
+
+		// Changing the settings clears the volume
+		void setSettings(const Settings& settings);
+		const Settings& getSettings() const { return m_settings; }
+		void reset();
+
+		// Fuses a color + 16bit depth frame taken from cameraToWorld (the inverse view matrix of the frame)
+		void integrate(
+			const cv::Mat& color,
+			const cv::Mat& depth,
+			const CameraIntrinsics& intrinsics,
+			const glm::mat4& cameraToWorld
+		);
+
+		// One point per zero crossing along the x, y and z voxel edges, positions and colors interpolated.
+		size_t extractPointCloud(std::vector<glm::vec4>& positions, std::vector<glm::vec4>& colors) const;
+		// Marching cubes over every observed cell, see MarchingCubes
+		size_t extractMesh(TriangleMesh& mesh, MarchingCubes::Stats* stats = nullptr) const;
+
+		size_t getBlockCount() const { return m_blocks.size(); }
+		const Block& getBlock(size_t index) const { return *m_blocks[index]; }
+		const Block* findBlock(const glm::ivec3& blockCoord) const;
+		// -1 when the block has not been allocated
+		int findBlockIndex(const glm::ivec3& blockCoord) const;
+		// nullptr when the voxel has no block
+		const Voxel* findVoxel(const glm::ivec3& voxelCoord) const;
+		size_t getMemoryUsage() const;
+		const Stats& getStats() const { return m_stats; }
+
+		static uint64_t packBlockKey(const glm::ivec3& blockCoord);
+
+	private:
+		void allocateBlocks(
+			const cv::Mat& depth,
+			const CameraIntrinsics& intrinsics,
+			const glm::mat4& cameraToWorld,
+			std::vector<uint32_t>& touchedBlocks
+		);
+
+		ThreadPool& m_threadPool;
+		Settings m_settings{};
+		Stats m_stats{};
+		std::unordered_map<uint64_t, uint32_t> m_blockIndices;
+		std::vector<std::unique_ptr<Block>> m_blocks;
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -2,10 +2,13 @@
 #include <map>
 #include <array>
 #include <chrono> // current system time with high precision
+#include <cmath>
+#include <limits>
 
 #include "Application.h"
 #include "Buffer.h"
 #include "Texture.h"
+#include "UploadManager.h"
 
 namespace AE {
 
@@ -21,13 +24,14 @@ namespace AE {
 		m_validLayers.setupDebugMessenger(m_vkInstance.getInstance());
 		m_devices.createSurface(m_vkInstance.getInstance(), m_winApp);
 		m_devices.pickPhysicalDevice(m_vkInstance.getInstance());
-		m_devices.createLogicalDevice();
+		m_devices.createLogicalDevice(m_vkInstance.getMemoryProperties2Function());
 		// global descriptor set layout
 		m_descriptorSetLayouts.emplace_back(
 			DescriptorSetLayout::Builder(m_devices)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			// Both uniform blocks live in the UniformAllocator, FrameInfo::m_dynamicOffsets selects them
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
 			// particle descriptors
-			.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT)
 			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
 			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
 			.build()
@@ -63,8 +67,8 @@ namespace AE {
 		m_globalPool = 
 			DescriptorPool::Builder(m_devices)
 			.setMaxSets(MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT)
 			.build();
@@ -79,49 +83,64 @@ namespace AE {
 			.setMaxSets(MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT)
 			.build();
+		auto sceneLoadStartTime = std::chrono::high_resolution_clock::now();
 		loadGameObjects();
 		//m_particleSystem.loadPointCloud();
-		m_3Dvision.setCameraExternalParameters();
-		m_3Dvision.generatePointCloud();
+		if (m_simulatedPointNum > 0) {
+			m_particleSystem.getPointCloud().setSimulated(true);
+			m_particleSystem.loadPointCloud(static_cast<int>(m_simulatedPointNum));
+		}
+		else {
+#ifdef RGBD_MESH_RENDERING
+			// The mesh is drawn instead of the points, so the frames are only fused into the volume and the particle
+			// system gets an empty cloud, just for its descriptor sets
+			m_3Dvision.setCameraExternalParameters();
+			m_3Dvision.generatePointCloud(false);
+			m_3Dvision.generateMesh();
+			loadReconstructionMesh();
+			PointCloud::IngestBuffer ingest = m_particleSystem.getPointCloud().beginIngest(0, PointCloud::PointFormat::Full);
+			ingest.setParticleNum({ 0 });
+			m_particleSystem.setPointCloud(std::move(ingest));
+#else
+			loadPointCloud();
+#endif
+		}
+		// The one sync point of the scene load: every copy recorded above has finished after this
+		m_devices.getUploadManager().flush();
+		auto sceneLoadEndTime = std::chrono::high_resolution_clock::now();
+		// Compare with USE_DIRECT_UPLOAD commented out to measure the staging overhead
+		printf("Scene load and upload: %.2f ms (%s)\n",
+			std::chrono::duration<double, std::milli>(sceneLoadEndTime - sceneLoadStartTime).count(),
+			m_devices.getDeviceLocalMemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ? "direct" : "staged");
+		m_devices.getUploadManager().printStats("Scene upload");
+		m_uniformAllocator = std::make_unique<UniformAllocator>(m_devices, MAX_FRAMES_IN_FLIGHT);
 		m_renderer.createCommandBuffers();
+		m_renderer.createCommandRecorder(m_threadPool);
+#ifdef PARALLEL_COMMAND_RECORDING
+		m_renderer.getCommandRecorder().setThreadCount(m_recordingThreadCount);
+#endif
+		m_devices.getMemoryAllocator().printStats("Device memory after loading the scene");
+		m_devices.getMemoryAllocator().printBudget("Memory budget");
+		if (m_uploadBenchmarkMB > 0) {
+			runUploadBenchmark();
+		}
 	}
 
 	void Application::mainLoop() {
 		std::vector<std::vector<VkDescriptorSet>> descriptorSets(MAX_FRAMES_IN_FLIGHT);
-		std::vector<std::unique_ptr<Buffer>> uboBuffers(MAX_FRAMES_IN_FLIGHT);
-		std::vector<std::unique_ptr<Buffer>> particleUBObuffers(MAX_FRAMES_IN_FLIGHT);
-		for (int i = 0; i < uboBuffers.size(); i++) {
-			uboBuffers[i] = std::make_unique<Buffer>(
-				m_devices,
-				sizeof(GlobalUBO),
-				1,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-			);
-			uboBuffers[i]->map();
-
-			particleUBObuffers[i] = std::make_unique<Buffer>(
-				m_devices,
-				sizeof(ParticleUBO),
-				1,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-			);
-			particleUBObuffers[i]->map();
-
-			VkDescriptorBufferInfo particleUBObufferInfo = particleUBObuffers[i]->descriptorInfo();
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			VkDescriptorBufferInfo particleUBObufferInfo = m_uniformAllocator->descriptorInfo(i, sizeof(ParticleUBO));
+			// Both bindings refer to the same SSBO when the cloud is static
 			VkDescriptorBufferInfo storageBufferInfoLastFrame
 				= m_particleSystem
-				.getPointCloud()
-				.getSBOObuffers()[(MAX_FRAMES_IN_FLIGHT + i - 1) % MAX_FRAMES_IN_FLIGHT]->descriptorInfo();
+				.getSBOObuffer((MAX_FRAMES_IN_FLIGHT + i - 1) % MAX_FRAMES_IN_FLIGHT).descriptorInfo();
 			VkDescriptorBufferInfo storageBufferInfoCurrentFrame
 				= m_particleSystem
-				.getPointCloud()
-				.getSBOObuffers()[i]->descriptorInfo();
+				.getSBOObuffer(i).descriptorInfo();
 
 			// i: frame , j: descriptor set number
 			descriptorSets[i].resize(m_descriptorSetLayouts.size());
-			VkDescriptorBufferInfo bufferInfo = uboBuffers[i]->descriptorInfo();
+			VkDescriptorBufferInfo bufferInfo = m_uniformAllocator->descriptorInfo(i, sizeof(GlobalUBO));
 			DescriptorWriter(*m_descriptorSetLayouts[0], *m_globalPool)
 				.writeBuffer(0, &bufferInfo)
 				.writeBuffer(1, &particleUBObufferInfo)
@@ -132,12 +151,10 @@ namespace AE {
 			// Indirect Descriptor Set
 			VkDescriptorBufferInfo indirectBufferInfoLastFrame
 				= m_particleSystem
-				.getPointCloud()
-				.getIndirectCommandsBuffers()[(MAX_FRAMES_IN_FLIGHT + i - 1) % MAX_FRAMES_IN_FLIGHT]->descriptorInfo();
+				.getIndirectCommandsBuffer((MAX_FRAMES_IN_FLIGHT + i - 1) % MAX_FRAMES_IN_FLIGHT).descriptorInfo();
 			VkDescriptorBufferInfo indirectBufferInfoCurrentFrame
 				= m_particleSystem
-				.getPointCloud()
-				.getIndirectCommandsBuffers()[i]->descriptorInfo();
+				.getIndirectCommandsBuffer(i).descriptorInfo();
 
 			DescriptorWriter(*m_descriptorSetLayouts[1], *m_indirectPool)
 				.writeBuffer(0, &indirectBufferInfoLastFrame)
@@ -168,6 +185,12 @@ namespace AE {
 
 		std::chrono::steady_clock::time_point beginTime = std::chrono::high_resolution_clock::now();
 		std::chrono::steady_clock::time_point prevTime = std::chrono::high_resolution_clock::now();
+		uint64_t frameCount = 0;
+		double frameTimeSum = 0.0;
+		MemoryAllocator::Stats loopStartStats = m_devices.getMemoryAllocator().getStats();
+#ifdef MEMORY_BUDGET_LOG_INTERVAL
+		float nextBudgetLogTime = MEMORY_BUDGET_LOG_INTERVAL;
+#endif
 
 		while (!m_winApp.shouldClose()) {
 			glfwPollEvents();
@@ -179,6 +202,12 @@ namespace AE {
 
 			/*float fps = 1.f / frameTime;
 			printf("fps: %f\n", fps);*/
+#ifdef MEMORY_BUDGET_LOG_INTERVAL
+			if (passedTime >= nextBudgetLogTime) {
+				m_devices.getMemoryAllocator().printBudget("Memory budget");
+				nextBudgetLogTime = passedTime + MEMORY_BUDGET_LOG_INTERVAL;
+			}
+#endif
 
 			m_cameraController.moveInPlaneXZ(m_winApp.getWindowPointer(), frameTime, viewerObject);
 			m_camera.setViewYXZ(viewerObject.m_transformMat.m_translation, viewerObject.m_transformMat.m_rotation);
@@ -204,8 +233,12 @@ namespace AE {
 				ubo.view = m_camera.getView();
 				ubo.inverseView = m_camera.getInverseView();
 				m_pointLightSystem.update(frameInfo, ubo);
-				uboBuffers[frameIndex]->writeToBuffer(&ubo);
-				uboBuffers[frameIndex]->flush();
+#ifdef RGBD_MESH_RENDERING
+				// The reconstructed colors already contain the lighting of the captured scene
+				ubo.ambientLightColor.w = 1.f;
+#endif
+				m_uniformAllocator->beginFrame(frameIndex);
+				uint32_t uboOffset = m_uniformAllocator->push(ubo);
 
 				ParticleUBO particleUBO{};
 				particleUBO.deltaTime = frameTime;
@@ -214,31 +247,114 @@ namespace AE {
 					frameTime,
 					{ 0.f, -1.f, 0.f }
 				);*/
-				particleUBObuffers[frameIndex]->writeToBuffer(&particleUBO);
-				particleUBObuffers[frameIndex]->flush();
+				uint32_t particleUBOoffset = m_uniformAllocator->push(particleUBO);
+				m_uniformAllocator->flush();
+				// in binding order of the global descriptor set
+				frameInfo.m_dynamicOffsets = { uboOffset, particleUBOoffset };
+
+#ifdef PARALLEL_COMMAND_RECORDING
+				// Everything inside the render pass is queued and then recorded on the thread pool by endSwapChainRenderPass()
+				const VkSubpassContents renderPassContents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+#else
+				const VkSubpassContents renderPassContents = VK_SUBPASS_CONTENTS_INLINE;
+#endif
+#ifdef RGBD_MESH_RENDERING
+				FrameInfo reconstructionFrameInfo{
+					frameIndex,
+					frameTime,
+					commandBuffer,
+					m_camera,
+					descriptorSets[frameIndex],
+					m_reconstructionObjects,
+					frameInfo.m_dynamicOffsets
+				};
 
+				// render
+				m_renderer.beginSwapChainRenderPass(commandBuffer, renderPassContents);
+#ifdef PARALLEL_COMMAND_RECORDING
+				m_simpleRenderSystem.renderGameObjects(reconstructionFrameInfo, m_renderer.getCommandRecorder());
+#else
+				m_simpleRenderSystem.renderGameObjects(reconstructionFrameInfo);
+#endif
+#else
+				// Page in before the frame is submitted, the graphics queue acquires the slots before it draws them
+				m_particleSystem.updatePointCloud(frameInfo, m_renderer.getFrameScheduler());
 				// Compute
-				m_particleSystem.dispatch(frameInfo);
+				if (m_particleSystem.hasComputePass()) {
+					FrameInfo computeFrameInfo = frameInfo;
+					computeFrameInfo.m_commandBuffer = m_renderer.beginCompute();
+					m_particleSystem.dispatch(computeFrameInfo);
+					m_renderer.endCompute();
+				}
 
 				// render
-				m_renderer.beginSwapChainRenderPass(commandBuffer);
+				m_renderer.beginSwapChainRenderPass(commandBuffer, renderPassContents);
+#ifdef PARALLEL_COMMAND_RECORDING
+				m_particleSystem.renderPointCloud(frameInfo, m_renderer.getCommandRecorder());
+#ifdef MANY_MODEL_SCENE_COUNT
+				// The benchmark scene draws its models too
+				m_simpleRenderSystem.renderGameObjects(frameInfo, m_renderer.getCommandRecorder());
+#endif
+#else
 				m_particleSystem.renderPointCloud(frameInfo);
+#ifdef MANY_MODEL_SCENE_COUNT
+				m_simpleRenderSystem.renderGameObjects(frameInfo);
+#endif
+#endif
+#endif
 				// render solid objects first, then render any semi-transparent objects
 				//m_simpleRenderSystem.renderGameObjects(frameInfo);
 				//m_pointLightSystem.render(frameInfo);
 				
 				m_renderer.endSwapChainRenderPass(commandBuffer);
 				m_renderer.endFrame();
+				frameCount++;
+				frameTimeSum += frameTime;
 			}
 		}
 		vkDeviceWaitIdle(m_devices.getLogicalDevice());
+
+		if (frameCount > 0) {
+			// Compare with ASYNC_COMPUTE commented out to measure the overlap (needs --simulate-point-cloud or SIMULATE_POINT_CLOUD,
+			// static clouds have no compute pass)
+#ifdef ASYNC_COMPUTE
+			const char* computeMode = "async compute";
+#else
+			const char* computeMode = "inline compute";
+#endif
+			if (!m_particleSystem.hasComputePass()) {
+				computeMode = "no compute pass";
+			}
+			printf("Frame time: %.3f ms on average over %llu frames (%s, %zu game objects)\n",
+				frameTimeSum * 1000.0 / frameCount, static_cast<unsigned long long>(frameCount), computeMode, m_gameObjects.size());
+			// Per frame host writes to non-coherent memory, should follow the bytes written rather than the buffer sizes
+			MemoryAllocator::Stats loopEndStats = m_devices.getMemoryAllocator().getStats();
+			printf("Mapped memory flushes: %.1f bytes in %.2f vkFlushMappedMemoryRanges calls per frame over %llu frames\n",
+				static_cast<double>(loopEndStats.flushedBytes - loopStartStats.flushedBytes) / frameCount,
+				static_cast<double>(loopEndStats.flushCount - loopStartStats.flushCount) / frameCount,
+				static_cast<unsigned long long>(frameCount));
+		}
+		m_renderer.getFrameScheduler().printStats("Frame scheduler");
+#ifdef PARALLEL_COMMAND_RECORDING
+		m_renderer.getCommandRecorder().printStats("Parallel command recording");
+#endif
+		if (PagedPointCloud* pagedPointCloud = m_particleSystem.getPagedPointCloud()) {
+			pagedPointCloud->printStats("Point cloud paging");
+			m_devices.getUploadManager().printStats("Uploads (scene and paging)");
+		}
 	}
 
 	void Application::cleanup() {
 		m_renderer.cleanupSwapChain();
+		m_renderer.destroyFrameScheduler();
+		m_renderer.destroyCommandRecorder();
 		m_simpleRenderSystem.cleanupGraphicsPipeline();
 		m_pointLightSystem.cleanupGraphicsPipeline();
 		m_particleSystem.cleanupParticleSystem();
+		m_devices.destroyUploadManager();
+		if (m_devices.hasDedicatedTransferQueue()) {
+			vkDestroyCommandPool(m_devices.getLogicalDevice(), m_devices.getTransferCommandPool(), nullptr);
+		}
 		vkDestroyCommandPool(m_devices.getLogicalDevice(), m_devices.getCommandPool(), nullptr);
 		for (int i = 0; i < m_descriptorSetLayouts.size(); i++) {
 			m_VkDescriptorSetLayouts[i] = nullptr;
@@ -247,7 +363,11 @@ namespace AE {
 		m_globalPool = nullptr; // call destructor
 		m_texturePool = nullptr; // call destructor
 		m_indirectPool = nullptr; // call destructor
+		m_uniformAllocator = nullptr; // call destructor
 		m_gameObjects.clear(); // call destructor
+		m_reconstructionObjects.clear(); // call destructor
+		m_devices.destroyResourceRecycler();
+		m_devices.destroyMemoryAllocator();
 		vkDestroyDevice(m_devices.getLogicalDevice(), nullptr);
 		if (m_validLayers.enableValidationLayers) {
 			DestroyDebugUtilsMessengerEXT(m_vkInstance.getInstance(), m_validLayers.m_debugMessenger, nullptr);
@@ -282,6 +402,30 @@ namespace AE {
 		floor.m_transformMat.m_scale = { 3.f, 1.f, 3.f };
 		m_gameObjects.emplace(floor.getId(), std::move(floor));
 
+#ifdef MANY_MODEL_SCENE_COUNT
+		// Every copy gets its own vertex and index buffer (plus two staging buffers while uploading)
+		Model::Builder vaseBuilder{};
+		vaseBuilder.loadModel("Models/smooth_vase.obj");
+		for (int i = 0; i < MANY_MODEL_SCENE_COUNT; i++) {
+			GameObject vase = GameObject::createGameObject();
+			vase.m_model = Model::createModelFromBuilder(m_devices, vaseBuilder);
+			vase.m_transformMat.m_translation = { (i % 20 - 10) * .2f, .5f, (i / 20) * .2f };
+			vase.m_transformMat.m_scale = { .5f, .5f, .5f };
+			m_gameObjects.emplace(vase.getId(), std::move(vase));
+		}
+#endif
+		if (m_sceneObjectCount > 0) {
+			std::shared_ptr<Model> vaseModel = Model::createModelFromFile(m_devices, "Models/smooth_vase.obj");
+			const int rowLength = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(m_sceneObjectCount))));
+			for (uint32_t i = 0; i < m_sceneObjectCount; i++) {
+				GameObject vase = GameObject::createGameObject();
+				vase.m_model = vaseModel;
+				vase.m_transformMat.m_translation = { (static_cast<int>(i) % rowLength - rowLength / 2) * .2f, .5f, (static_cast<int>(i) / rowLength) * .2f };
+				vase.m_transformMat.m_scale = { .5f, .5f, .5f };
+				m_gameObjects.emplace(vase.getId(), std::move(vase));
+			}
+		}
+
 		std::vector<glm::vec3> lightColors{
 			{1.f, .1f, .1f},
 			{.1f, .1f, 1.f},
@@ -304,4 +448,203 @@ namespace AE {
 		}
 	}
 
+	// Reconstructs the RGBD sequence (or reads POINT_CLOUD_FILE_PATH) and uploads it to the particle SSBOs.
+	// With RGBD_POINT_CLOUD_CACHE the result is stored in SSBO layout, and later launches with the same inputs map that file instead.
+	void Application::loadPointCloud() {
+		auto startTime = std::chrono::high_resolution_clock::now();
+#ifdef POINT_CLOUD_FILE_PATH
+		{
+			// Decoded straight into the staging region
+			PointCloudIO pointCloudIO{ m_threadPool };
+			PointCloud::IngestBuffer ingest;
+			pointCloudIO.read(POINT_CLOUD_FILE_PATH, [this, &ingest](size_t pointNum) {
+				ingest = m_particleSystem.getPointCloud().beginIngest(pointNum, PointCloud::PointFormat::Full);
+				return ingest.getParticles();
+			});
+			const PointCloudIO::Stats& stats = pointCloudIO.getLastStats();
+			ingest.setParticleNum({ static_cast<int>(stats.pointNum) });
+			m_particleSystem.setPointCloud(std::move(ingest));
+			printf("Read %s: %zu points, %.2f MB in %.2f ms (%.1f MB/s), peak RSS %.1f MB\n",
+				POINT_CLOUD_FILE_PATH, stats.pointNum, stats.fileBytes / (1024.0 * 1024.0), stats.ms, stats.megaBytesPerSecond,
+				getPeakResidentBytes() / (1024.0 * 1024.0));
+			return;
+		}
+#endif
+#ifdef RGBD_COMPACT_POINT_FORMAT
+		const PointCloud::PointFormat pointFormat = PointCloud::PointFormat::Compact;
+#else
+		const PointCloud::PointFormat pointFormat = PointCloud::PointFormat::Full;
+#endif
+
+#ifdef RGBD_POINT_CLOUD_CACHE
+#if defined(VOXEL_GRID_FILTER_SIZE) && !defined(RGBD_TSDF_FUSION)
+		const float filterSize = VOXEL_GRID_FILTER_SIZE;
+#else
+		const float filterSize = 0.f;
+#endif
+#ifdef POINT_CLOUD_PAGING
+		// The cache holds the points in chunk order, so a different chunk size rebuilds it
+		const uint64_t inputHash = m_3Dvision.hashInputs({ filterSize, static_cast<float>(pointFormat), static_cast<float>(POINT_CLOUD_PAGE_CHUNK_SIZE) });
+#else
+		const uint64_t inputHash = m_3Dvision.hashInputs({ filterSize, static_cast<float>(pointFormat) });
+#endif
+		auto hashEndTime = std::chrono::high_resolution_clock::now();
+
+		auto cache = std::make_unique<PointCloudCache>();
+		if (cache->open(RGBD_POINT_CLOUD_CACHE, inputHash)) {
+			const size_t cacheSize = cache->getFileSize();
+			m_particleSystem.setPointCloud(std::move(cache));
+
+			auto endTime = std::chrono::high_resolution_clock::now();
+			printf("Point cloud startup (warm, %s): %.2f ms (hash %.2f ms), %.2f MB, peak RSS %.1f MB\n",
+				RGBD_POINT_CLOUD_CACHE,
+				std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+				std::chrono::duration<double, std::milli>(hashEndTime - startTime).count(),
+				cacheSize / (1024.0 * 1024.0),
+				getPeakResidentBytes() / (1024.0 * 1024.0));
+			return;
+		}
+#endif
+
+		m_3Dvision.setCameraExternalParameters();
+		m_3Dvision.generatePointCloud();
+#if defined(VOXEL_GRID_FILTER_SIZE) && !defined(RGBD_TSDF_FUSION)
+		m_3Dvision.downsamplePointCloud(VOXEL_GRID_FILTER_SIZE);
+#endif
+
+		// The reconstruction is written once, straight into the mapped staging region, and then freed
+		auto ingestStartTime = std::chrono::high_resolution_clock::now();
+		PointCloud::IngestBuffer ingest = m_particleSystem.getPointCloud().beginIngest(m_3Dvision.getTotalParticleNum(), pointFormat);
+		if (pointFormat == PointCloud::PointFormat::Compact) {
+			glm::vec3 boundsMin, boundsMax;
+			m_3Dvision.getBounds(boundsMin, boundsMax);
+			PointQuantizer quantizer{ boundsMin, boundsMax };
+			m_3Dvision.writeParticles(ingest.getCompactParticles(), quantizer);
+			ingest.setQuantizer(quantizer);
+		}
+		else {
+			m_3Dvision.writeParticles(ingest.getParticles());
+		}
+		ingest.setParticleNum(m_3Dvision.getParticleNum());
+		m_3Dvision.releasePointCloud();
+#ifdef RGBD_POINT_CLOUD_CACHE
+#ifdef POINT_CLOUD_PAGING
+		// Written in chunk order and paged from the mapped file, like a warm start, so the cloud is never held in host memory
+		m_particleSystem.sortIntoChunks(ingest);
+		ingest.writeCache(RGBD_POINT_CLOUD_CACHE, inputHash);
+		auto writtenCache = std::make_unique<PointCloudCache>();
+		if (writtenCache->open(RGBD_POINT_CLOUD_CACHE, inputHash)) {
+			m_particleSystem.setPointCloud(std::move(writtenCache));
+		}
+		else {
+			m_particleSystem.setPointCloud(std::move(ingest));
+		}
+#else
+		ingest.writeCache(RGBD_POINT_CLOUD_CACHE, inputHash);
+		m_particleSystem.setPointCloud(std::move(ingest));
+#endif
+#else
+		m_particleSystem.setPointCloud(std::move(ingest));
+#endif
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		printf("Point cloud startup%s: %.2f ms (ingest %.2f ms), peak RSS %.1f MB\n",
+#ifdef RGBD_POINT_CLOUD_CACHE
+			" (cold, wrote " RGBD_POINT_CLOUD_CACHE ")",
+#else
+			"",
+#endif
+			std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+			std::chrono::duration<double, std::milli>(endTime - ingestStartTime).count(),
+			getPeakResidentBytes() / (1024.0 * 1024.0));
+	}
+
+	void Application::loadReconstructionMesh() {
+		const TriangleMesh& mesh = m_3Dvision.getMesh();
+		if (mesh.getTriangleCount() == 0) {
+			return;
+		}
+
+		Model::Builder builder{};
+		builder.m_vertices.resize(mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			builder.m_vertices[i].position = mesh.positions[i];
+			builder.m_vertices[i].color = mesh.colors[i];
+			builder.m_vertices[i].normal = mesh.normals[i];
+		}
+		builder.m_indices = mesh.indices;
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		GameObject reconstruction = GameObject::createGameObject();
+		reconstruction.m_model = Model::createModelFromBuilder(m_devices, builder);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		printf("Staged reconstruction mesh: %zu triangles, %zu vertices in %.2f ms\n",
+			mesh.getTriangleCount(), mesh.positions.size(),
+			std::chrono::duration<double, std::milli>(endTime - startTime).count());
+		m_reconstructionObjects.emplace(reconstruction.getId(), std::move(reconstruction));
+	}
+
+	// Uploads m_uploadBenchmarkMB to a device local buffer through the staging ring and, with USE_DIRECT_UPLOAD where
+	// device local memory is host visible, in place, so both paths are timed on the same device in one run. Also compares the growth of the
+	// driver reported heap usage (VK_EXT_memory_budget) with what the allocator accounted for.
+	void Application::runUploadBenchmark() {
+		constexpr int RUN_NUM = 5;
+		const VkDeviceSize size = static_cast<VkDeviceSize>(m_uploadBenchmarkMB) * 1024 * 1024;
+		std::vector<char> data(static_cast<size_t>(size));
+		for (size_t i = 0; i < data.size(); i++) {
+			data[i] = static_cast<char>(i * 31);
+		}
+		MemoryAllocator& allocator = m_devices.getMemoryAllocator();
+		UploadManager& uploadManager = m_devices.getUploadManager();
+
+		auto benchmark = [&](bool staged, VkMemoryPropertyFlags properties) {
+			const char* label = staged ? "staged" : "direct";
+			const std::vector<MemoryAllocator::HeapBudget> budgetsBefore = allocator.getHeapBudgets();
+			Buffer buffer{ m_devices, size, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties };
+			const std::vector<MemoryAllocator::HeapBudget> budgetsAfter = allocator.getHeapBudgets();
+			if (!staged && !uploadManager.writesInPlace(buffer)) {
+				printf("Upload benchmark, direct: skipped, USE_DIRECT_UPLOAD is off\n");
+				return;
+			}
+			if (staged && buffer.isHostVisible()) {
+				printf("Upload benchmark: every device local memory type is host visible, the staged copy goes to host visible memory too\n");
+			}
+
+			// Best of RUN_NUM, each until the data can be read by the device
+			double bestMs = std::numeric_limits<double>::max();
+			for (int run = 0; run < RUN_NUM; run++) {
+				auto startTime = std::chrono::high_resolution_clock::now();
+				if (staged) {
+					// The VkBuffer overload always goes through the staging ring
+					uploadManager.uploadBuffer(buffer.getBuffer(), data.data(), size);
+				}
+				else {
+					uploadManager.uploadBuffer(buffer, data.data(), size);
+				}
+				uploadManager.flush();
+				auto endTime = std::chrono::high_resolution_clock::now();
+				bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+			}
+			printf("Upload benchmark, %s: %u MB in %.2f ms (%.1f MB/s), best of %d\n",
+				label, m_uploadBenchmarkMB, bestMs, m_uploadBenchmarkMB / (bestMs / 1000.0), RUN_NUM);
+			for (size_t i = 0; i < budgetsAfter.size() && i < budgetsBefore.size(); i++) {
+				const double allocatedMB = (budgetsAfter[i].allocatedBytes - budgetsBefore[i].allocatedBytes) / (1024.0 * 1024.0);
+				const double usageMB = (static_cast<double>(budgetsAfter[i].usage) - static_cast<double>(budgetsBefore[i].usage)) / (1024.0 * 1024.0);
+				if (allocatedMB != 0.0 || usageMB != 0.0) {
+					printf("    heap %u: allocated %.1f MB, %s usage grew by %.1f MB\n",
+						static_cast<uint32_t>(i), allocatedMB, budgetsAfter[i].fromDriver ? "driver reported" : "estimated", usageMB);
+				}
+			}
+		};
+
+		benchmark(true, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (allocator.supportsDirectUpload()) {
+			benchmark(false, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		}
+		else {
+			printf("Upload benchmark, direct: skipped, device local memory is not host visible\n");
+		}
+		uploadManager.printStats("Upload benchmark");
+	}
+
 } // namespace AE
\ No newline at end of file
@@ -14,7 +14,11 @@
 #include "Camera.h"
 #include "Input/KeyboardMovementController.h"
 #include "Descriptors.h"
+#include "UniformAllocator.h"
 #include "ParticleSystem/ParticleSystem.h"
+#include "ParticleSystem/PointCloudIO.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/MemoryUsage.h"
 
 #include "3Dvision/RGBD/RGBDvision.h"
 
@@ -35,6 +39,18 @@ namespace AE {
 		const char* m_appName = APPLICATION_NAME;
 
 		void run();
+		// Before run(), see Renderer::setFramesInFlight()
+		void setFramesInFlight(uint32_t framesInFlight) { m_renderer.setFramesInFlight(framesInFlight); }
+		// Before run(): render pointNum generated points that the compute shader updates every frame instead of the
+		// RGBD reconstruction, so that the compute pass runs (see ASYNC_COMPUTE)
+		void setSimulatedPointCloud(uint32_t pointNum) { m_simulatedPointNum = pointNum; }
+		// Before run(): after loading, time a megaBytes upload staged and written in place (see runUploadBenchmark())
+		void setUploadBenchmark(uint32_t megaBytes) { m_uploadBenchmarkMB = megaBytes; }
+		// Before run(): objectCount extra vases sharing one model, i.e. one draw each without more buffers, and the threads
+		// that record them (see ParallelCommandRecorder::setThreadCount()). The frame time printed at exit then shows how
+		// the CPU side of a frame scales with threads.
+		void setSceneObjects(uint32_t objectCount) { m_sceneObjectCount = objectCount; }
+		void setRecordingThreads(uint32_t threadCount) { m_recordingThreadCount = threadCount; }
 
 	private:
 		void initVulkan();
@@ -42,7 +58,9 @@ namespace AE {
 		void cleanup();
 
 		void loadGameObjects();
+		void loadReconstructionMesh();
 		void loadPointCloud();
+		void runUploadBenchmark();
 
 		WinApplication m_winApp{ WIDTH, HEIGHT, m_appName };
 		ValidationLayers m_validLayers;
@@ -55,12 +73,19 @@ namespace AE {
 		std::unique_ptr<DescriptorPool> m_globalPool{};
 		std::unique_ptr<DescriptorPool> m_texturePool{};
 		std::unique_ptr<DescriptorPool> m_indirectPool{};
+		std::unique_ptr<UniformAllocator> m_uniformAllocator{};
 		std::vector<std::unique_ptr<DescriptorSetLayout>> m_descriptorSetLayouts;
 		std::vector<VkDescriptorSetLayout> m_VkDescriptorSetLayouts;
 		GameObject::Map m_gameObjects;
+		GameObject::Map m_reconstructionObjects;
 		Camera m_camera{};
 		KeyboardMovementController m_cameraController{};
-		RGBDvision m_3Dvision{ m_particleSystem };
+		ThreadPool m_threadPool{};
+		RGBDvision m_3Dvision{ m_threadPool };
+		uint32_t m_simulatedPointNum = 0;
+		uint32_t m_uploadBenchmarkMB = 0;
+		uint32_t m_sceneObjectCount = 0;
+		uint32_t m_recordingThreadCount = 0;
 		//RGBDvision m_3Dvision{ m_camera, m_particleSystem };
 	};
 
@@ -5,10 +5,12 @@
  * https://github.com/SaschaWillems/Vulkan/blob/master/base/VulkanBuffer.h
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
 #include "Buffer.h"
+#include "ResourceRecycler.h"
 
 namespace AE {
 
@@ -43,18 +45,21 @@ namespace AE {
     {
         m_alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         m_bufferSize = m_alignmentSize * instanceCount;
-        m_devices.createBuffer(m_bufferSize, usageFlags, memoryPropertyFlags, m_buffer, m_memory);
+        m_devices.getResourceRecycler().createBuffer(m_bufferSize, usageFlags, memoryPropertyFlags, m_buffer, m_memory);
+        m_nonCoherent = m_devices.getMemoryAllocator().isNonCoherent(m_memory.memoryTypeIndex);
     }
 
     Buffer::~Buffer() {
         unmap();
-        vkDestroyBuffer(m_devices.getLogicalDevice(), m_buffer, nullptr);
-        vkFreeMemory(m_devices.getLogicalDevice(), m_memory, nullptr);
+        // Destroyed or pooled once no frame in flight can use it anymore
+        m_devices.getResourceRecycler().destroyBuffer(m_buffer, m_memory, m_bufferSize, m_usageFlags, m_memoryPropertyFlags);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note The memory allocator keeps host visible memory mapped, so this only points into that mapping
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -62,20 +67,21 @@ namespace AE {
      * @return VkResult of the buffer mapping call
      */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(m_buffer && m_memory && "Called map on buffer before create");
-        return vkMapMemory(m_devices.getLogicalDevice(), m_memory, offset, size, 0, &m_mapped);
+        assert(m_buffer && m_memory.memory && "Called map on buffer before create");
+        if (m_memory.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        m_mapped = static_cast<char*>(m_memory.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The memory itself stays mapped until the allocator releases it
      */
     void Buffer::unmap() {
-        if (m_mapped) {
-            vkUnmapMemory(m_devices.getLogicalDevice(), m_memory);
-            m_mapped = nullptr;
-        }
+        m_mapped = nullptr;
     }
 
     /**
@@ -87,7 +93,7 @@ namespace AE {
      * @param offset (Optional) Byte offset from beginning of mapped region
      *
      */
-    void Buffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize offset) {
+    void Buffer::writeToBuffer(const void* data, VkDeviceSize size, VkDeviceSize offset) {
         assert(m_mapped && "Cannot copy to unmapped buffer");
 
         if (size == VK_WHOLE_SIZE) {
@@ -98,12 +104,76 @@ namespace AE {
             memOffset += offset;
             memcpy(memOffset, data, size);
         }
+        markDirty(size, offset);
+    }
+
+    /**
+     * Remember a written range of the buffer for the next flushDirty()
+     *
+     * @note Overlapping and touching ranges are merged after widening them to nonCoherentAtomSize,
+     * so a flush never covers an atom twice
+     *
+     * @param size (Optional) Size of the written range. Pass VK_WHOLE_SIZE for the complete buffer.
+     * @param offset (Optional) Byte offset from beginning
+     */
+    void Buffer::markDirty(VkDeviceSize size, VkDeviceSize offset) {
+        if (!m_nonCoherent) {
+            return;
+        }
+        // The allocation starts on an atom boundary, so aligning relative to the buffer is aligning the memory offset
+        const VkDeviceSize atomSize = m_devices.getMemoryAllocator().getNonCoherentAtomSize();
+        VkDeviceSize begin = size == VK_WHOLE_SIZE ? 0 : offset;
+        VkDeviceSize end = size == VK_WHOLE_SIZE ? m_bufferSize : offset + size;
+        begin -= begin % atomSize;
+        end = std::min((end + atomSize - 1) / atomSize * atomSize, m_memory.size);
+
+        // First range that ends at or after begin, everything from there that starts at or before end is merged
+        auto it = std::lower_bound(m_dirtyRanges.begin(), m_dirtyRanges.end(), begin, [](const DirtyRange& range, VkDeviceSize value) {
+            return range.end < value;
+        });
+        while (it != m_dirtyRanges.end() && it->begin <= end) {
+            begin = std::min(begin, it->begin);
+            end = std::max(end, it->end);
+            it = m_dirtyRanges.erase(it);
+        }
+        m_dirtyRanges.insert(it, DirtyRange{ begin, end });
+    }
+
+    /**
+     * Flush every range written since the last call
+     *
+     * @note Does nothing for coherent memory
+     *
+     * @return VkResult of the flush call
+     */
+    VkResult Buffer::flushDirty() {
+        if (m_dirtyRanges.empty()) {
+            return VK_SUCCESS;
+        }
+        std::vector<VkMappedMemoryRange> mappedRanges(m_dirtyRanges.size());
+        for (size_t i = 0; i < m_dirtyRanges.size(); i++) {
+            mappedRanges[i].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            mappedRanges[i].memory = m_memory.memory;
+            mappedRanges[i].offset = m_memory.offset + m_dirtyRanges[i].begin;
+            mappedRanges[i].size = m_dirtyRanges[i].end - m_dirtyRanges[i].begin;
+        }
+        m_dirtyRanges.clear();
+        return m_devices.getMemoryAllocator().flushMappedRanges(mappedRanges);
+    }
+
+    VkDeviceSize Buffer::getDirtyBytes() const {
+        VkDeviceSize bytes = 0;
+        for (const DirtyRange& range : m_dirtyRanges) {
+            bytes += range.end - range.begin;
+        }
+        return bytes;
     }
 
     /**
      * Flush a memory range of the buffer to make it visible to the device
      *
-     * @note Only required for non-coherent memory
+     * @note Only required for non-coherent memory, skipped for coherent memory. Prefer flushDirty(),
+     * this flushes the range whether it was written or not.
      *
      * @param size (Optional) Size of the memory range to flush. Pass VK_WHOLE_SIZE to flush the
      * complete buffer range.
@@ -112,12 +182,10 @@ namespace AE {
      * @return VkResult of the flush call
      */
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(m_devices.getLogicalDevice(), 1, &mappedRange);
+        if (!m_nonCoherent) {
+            return VK_SUCCESS;
+        }
+        return m_devices.getMemoryAllocator().flushMappedRanges({ m_devices.getMemoryAllocator().getMappedRange(m_memory, size, offset) });
     }
 
     /**
@@ -132,11 +200,7 @@ namespace AE {
      * @return VkResult of the invalidate call
      */
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = m_memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
+        VkMappedMemoryRange mappedRange = m_devices.getMemoryAllocator().getMappedRange(m_memory, size, offset);
         return vkInvalidateMappedMemoryRanges(m_devices.getLogicalDevice(), 1, &mappedRange);
     }
 
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <vector>
+
 #include "Devices.h"
 
 namespace AE {
 
-    // wraps VkBuffer and VkBuffferMemory into a single object
+    // wraps VkBuffer and its sub-allocated memory into a single object
     class Buffer {
     public:
         Buffer(
@@ -23,8 +25,13 @@ namespace AE {
         VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         void unmap();
 
-        void writeToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        void writeToBuffer(const void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        // writeToBuffer() marks what it wrote, markDirty() is for writes through getMappedMemory().
+        // flushDirty() flushes every range marked since the last call with one vkFlushMappedMemoryRanges.
+        void markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        VkResult flushDirty();
+        VkDeviceSize getDirtyBytes() const;
         VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
         VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
@@ -36,6 +43,8 @@ namespace AE {
 
         VkBuffer getBuffer() const { return m_buffer; }
         void* getMappedMemory() const { return m_mapped; }
+        // The memory type is host visible, so map() works (also for device local memory on UMA / resizable BAR)
+        bool isHostVisible() const { return m_memory.mapped != nullptr; }
         uint32_t getInstanceCount() const { return m_instanceCount; }
         VkDeviceSize getInstanceSize() const { return m_instanceSize; }
         VkDeviceSize getAlignmentSize() const { return m_instanceSize; }
@@ -44,12 +53,18 @@ namespace AE {
         VkDeviceSize getBufferSize() const { return m_bufferSize; }
 
     private:
+        // [begin, end) relative to the buffer, widened to nonCoherentAtomSize
+        struct DirtyRange {
+            VkDeviceSize begin;
+            VkDeviceSize end;
+        };
+
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
 
         Devices& m_devices;
         void* m_mapped = nullptr;
         VkBuffer m_buffer = VK_NULL_HANDLE;
-        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        MemoryAllocation m_memory{};
 
         VkDeviceSize m_bufferSize;
         uint32_t m_instanceCount;
@@ -57,6 +72,8 @@ namespace AE {
         VkDeviceSize m_alignmentSize;
         VkBufferUsageFlags m_usageFlags;
         VkMemoryPropertyFlags m_memoryPropertyFlags;
+        bool m_nonCoherent = false;              // coherent memory needs no flush, so nothing is tracked for it
+        std::vector<DirtyRange> m_dirtyRanges{}; // sorted, neither overlapping nor touching
     };
 
 } // namespace AE
\ No newline at end of file
@@ -1,12 +1,20 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <set>
 
 #include "Devices.h"
 #include "Renderer/WinApplication.h"
 #include "Utils/ValidationLayers.h"
+#include "Utils/AREngineDefines.h"
 #include "Renderer/SwapChain.h"
+#include "UploadManager.h"
+#include "ResourceRecycler.h"
 
 namespace AE {
 
+	Devices::~Devices() = default;
+
 	SwapChainSupportDetails Devices::querySwapChainSupport(VkPhysicalDevice& device, VkSurfaceKHR& surface) {
 		SwapChainSupportDetails details;
 
@@ -101,7 +109,9 @@ namespace AE {
 			&& extensionsSupported 
 			&& swapChainAdequate 
 			&& supportedFeatures.samplerAnisotropy
-			&& supportedFeatures.multiDrawIndirect;
+			&& supportedFeatures.multiDrawIndirect
+			// Indirect draws of point clouds start at the first point of their cloud or chunk (PagedPointCloud slots)
+			&& supportedFeatures.drawIndirectFirstInstance;
 #else
 		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(device, &deviceProperties);
@@ -112,7 +122,8 @@ namespace AE {
 
 		// only usable for dedicated graphics cards that support geometry shaders.
 		return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-			deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader;
+			deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader &&
+			deviceFeatures.samplerAnisotropy && deviceFeatures.multiDrawIndirect && deviceFeatures.drawIndirectFirstInstance;
 #endif
 	}
 
@@ -162,24 +173,48 @@ namespace AE {
 			}
 			i++;
 		}
+#ifdef USE_TRANSFER_QUEUE
+		for (uint32_t family = 0; family < queueFamilyCount; family++) {
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				indices.transferFamily = family;
+				break;
+			}
+		}
+#endif
 
 		return indices;
 	}
 
-	void Devices::createLogicalDevice() {
+	void Devices::createLogicalDevice(PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2) {
 		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value() };
+		m_graphicsQueueFamily = indices.graphicsAndComputeFamily.value();
+		// Uploads fall back to the graphics queue when there is no transfer only family
+		m_transferQueueFamily = indices.transferFamily.value_or(m_graphicsQueueFamily);
+		uniqueQueueFamilies.insert(m_transferQueueFamily);
+
+		// The particle compute pass gets a second queue of the graphics family when the family has one, so that it runs
+		// next to the graphics work without queue family ownership transfers of the SSBOs
+		uint32_t graphicsQueueCount = 1;
+#ifdef ASYNC_COMPUTE
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+		graphicsQueueCount = std::min(queueFamilies[m_graphicsQueueFamily].queueCount, 2u);
+#endif
 
 		// Vulkan lets you assign priorities to queues to influence the scheduling of command buffer execution using floating point numbers between 0.0 and 1.0. This is required even if there is only a single queue:
-		float queuePriority = 1.0f;
+		float queuePriorities[] = { 1.0f, 1.0f };
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
 			VkDeviceQueueCreateInfo queueCreateInfo{};
 			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 			queueCreateInfo.queueFamilyIndex = queueFamily;
-			queueCreateInfo.queueCount = 1;
-			queueCreateInfo.pQueuePriorities = &queuePriority;
+			queueCreateInfo.queueCount = queueFamily == m_graphicsQueueFamily ? graphicsQueueCount : 1;
+			queueCreateInfo.pQueuePriorities = queuePriorities;
 			queueCreateInfos.emplace_back(queueCreateInfo);
 		}
 
@@ -187,6 +222,7 @@ namespace AE {
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -194,8 +230,13 @@ namespace AE {
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		const bool memoryBudget = getMemoryProperties2 != nullptr && isDeviceExtensionAvailable(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memoryBudget) {
+			enabledExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		if (m_validLayers.enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(m_validLayers.m_validationLayers.size());
@@ -212,6 +253,19 @@ namespace AE {
 		// We can use the vkGetDeviceQueue function to retrieve queue handles for each queue family. The parameters are the logical device, queue family, queue index and a pointer to the variable to store the queue handle in. Because we're only creating a single queue from this family, we'll simply use index 0.
 		vkGetDeviceQueue(m_device, indices.graphicsAndComputeFamily.value(), 0, &m_graphicsComputeQueue);
 		vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+		vkGetDeviceQueue(m_device, m_transferQueueFamily, 0, &m_transferQueue);
+		vkGetDeviceQueue(m_device, m_graphicsQueueFamily, graphicsQueueCount - 1, &m_computeQueue);
+#ifdef ASYNC_COMPUTE
+		printf("Particle compute uses %s\n", graphicsQueueCount > 1 ? "a second graphics family queue" : "the graphics queue (separate submission)");
+#endif
+		printf("Uploads use queue family %u (%s)\n", m_transferQueueFamily, hasDedicatedTransferQueue() ? "transfer only" : "graphics");
+
+		m_memoryAllocator = std::make_unique<MemoryAllocator>(m_physicalDevice, m_device);
+		if (memoryBudget) {
+			m_memoryAllocator->enableMemoryBudget(m_physicalDevice, getMemoryProperties2);
+		}
+		printf("Device local memory is %shost visible\n", m_memoryAllocator->supportsDirectUpload() ? "" : "not ");
+		m_resourceRecycler = std::make_unique<ResourceRecycler>(*this);
 	}
 
 	void Devices::createSurface(VkInstance& vkInstance, WinApplication& winApp) {
@@ -220,6 +274,19 @@ namespace AE {
 		}
 	}
 
+	bool Devices::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+		for (const VkExtensionProperties& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	bool Devices::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -255,23 +322,23 @@ namespace AE {
 	}
 
 	uint32_t Devices::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) &&
-				(memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
-		}
+		return m_memoryAllocator->findMemoryType(typeFilter, properties);
+	}
 
-		throw std::runtime_error("failed to find suitable memory type!");
+	VkMemoryPropertyFlags Devices::getDeviceLocalMemoryProperties() const {
+#ifdef USE_DIRECT_UPLOAD
+		if (m_memoryAllocator->supportsDirectUpload()) {
+			return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		}
+#endif
+		return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 	}
 
 	void Devices::createImageWithInfo(
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory) 
+		MemoryAllocation& imageMemory) 
 	{
 		if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
@@ -280,16 +347,12 @@ namespace AE {
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(m_device, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		MemoryAllocator::ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL
+			? MemoryAllocator::ResourceKind::OptimalImage
+			: MemoryAllocator::ResourceKind::Buffer;
+		imageMemory = m_memoryAllocator->allocate(memRequirements, properties, kind);
 
-		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
-		}
-
-		if (vkBindImageMemory(m_device, image, imageMemory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(m_device, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
 			throw std::runtime_error("failed to bind image memory!");
 		}
 	}
@@ -305,16 +368,34 @@ namespace AE {
 		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
 		}
+
+		m_transferCommandPool = m_commandPool;
+		if (hasDedicatedTransferQueue()) {
+			poolInfo.queueFamilyIndex = m_transferQueueFamily;
+			if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_transferCommandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create transfer command pool!");
+			}
+		}
+
+		m_uploadManager = std::make_unique<UploadManager>(*this);
 	}
 
-	// Create a buffer and memory for it. Then, bind them.
-	// Once we integrate a memory allocator, we need to rewrite this function.
+	void Devices::destroyUploadManager() {
+		m_uploadManager = nullptr;
+	}
+
+	void Devices::destroyResourceRecycler() {
+		m_resourceRecycler->printStats("Resource recycler");
+		m_resourceRecycler = nullptr;
+	}
+
+	// Create a buffer, sub-allocate memory for it from the memory allocator and bind it at that offset.
 	void Devices::createBuffer(
 		VkDeviceSize size,
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory) 
+		MemoryAllocation& bufferMemory) 
 	{
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -329,57 +410,15 @@ namespace AE {
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
+		bufferMemory = m_memoryAllocator->allocate(memRequirements, properties, MemoryAllocator::ResourceKind::Buffer);
 
 		// Fourth parameter is the offset within the region of memory.
-		// If the offset is non-zero, then it is required to be divisible by memRequirements.alignment.
-		vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
-	}
-
-	void Devices::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0;  // Optional
-		copyRegion.dstOffset = 0;  // Optional
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
+		// The allocator returns offsets divisible by memRequirements.alignment.
+		vkBindBufferMemory(m_device, buffer, bufferMemory.memory, bufferMemory.offset);
 	}
 
-	void Devices::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = layerCount;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = { width, height, 1 };
-
-		vkCmdCopyBufferToImage(
-			commandBuffer,
-			buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-		endSingleTimeCommands(commandBuffer);
+	void Devices::freeMemory(const MemoryAllocation& memory) {
+		m_memoryAllocator->free(memory);
 	}
 
 	VkCommandBuffer Devices::beginSingleTimeCommands() {
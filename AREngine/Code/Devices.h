@@ -2,14 +2,18 @@
 
 #include <iostream>
 #include <optional>
+#include <memory>
 
 #include "Utils/AREngineIncludes.h"
+#include "MemoryAllocator.h"
 
 namespace AE {
 
 	class WinApplication;
 	class ValidationLayers;
 	class SwapChain;
+	class UploadManager;
+	class ResourceRecycler;
 
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
@@ -22,6 +26,8 @@ namespace AE {
 		// std::optional is a wrapper that contains no value until you assign something to it. At any point you can query if it contains a value or not by calling its has_value() member function.
 		std::optional<uint32_t> graphicsAndComputeFamily;
 		std::optional<uint32_t> presentFamily;
+		// Transfer only family (no graphics or compute), typically a DMA engine. Empty when the device has none.
+		std::optional<uint32_t> transferFamily;
 
 		bool isComplete() {
 			return graphicsAndComputeFamily.has_value() && presentFamily.has_value();
@@ -34,6 +40,7 @@ namespace AE {
 		Devices(AE::ValidationLayers& validLayers) : m_validLayers{ validLayers }
 		{
 		}
+		~Devices();
 
 		// Not copyable or movable
 		Devices(const Devices&) = delete;
@@ -45,15 +52,20 @@ namespace AE {
 		QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 		VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		// Memory properties for GPU resident buffers filled once by the host (vertices, indices, SSBOs).
+		// DEVICE_LOCAL | HOST_VISIBLE when the memory allocator supports direct uploads, so that
+		// UploadManager::uploadBuffer() writes them in place instead of staging, DEVICE_LOCAL otherwise.
+		VkMemoryPropertyFlags getDeviceLocalMemoryProperties() const;
 		
 		void pickPhysicalDevice(VkInstance& vkInstance);
-		void createLogicalDevice();
+		// getMemoryProperties2 may be nullptr, VK_EXT_memory_budget is only enabled with it
+		void createLogicalDevice(PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr);
 		void createSurface(VkInstance& vkInstance, WinApplication& winApp);
 		void createImageWithInfo(
 			const VkImageCreateInfo& imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
-			VkDeviceMemory& imageMemory
+			MemoryAllocation& imageMemory
 		);
 		void createCommandPool();
 		void createBuffer(
@@ -61,12 +73,19 @@ namespace AE {
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory
+			MemoryAllocation& bufferMemory
 		);
-		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+		// Returns the memory of createBuffer() / createImageWithInfo() to the allocator
+		void freeMemory(const MemoryAllocation& memory);
+		// Must be called after every buffer and image has been destroyed, before vkDestroyDevice
+		void destroyMemoryAllocator() { m_memoryAllocator = nullptr; }
+		// Destroys everything the resource recycler still holds. After vkDeviceWaitIdle and after the last
+		// Buffer and Texture is gone, before destroyMemoryAllocator().
+		void destroyResourceRecycler();
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+		// Waits for the uploads and releases the staging ring. Must be called before the command pool is destroyed.
+		void destroyUploadManager();
 
 		VkPhysicalDevice& getPhysicalDevice() { return m_physicalDevice; }
 		VkPhysicalDeviceProperties& getPhysicalDeviceProperties() { return m_properties; }
@@ -76,8 +95,21 @@ namespace AE {
 		VkQueue& getGraphicsQueue() { return m_graphicsComputeQueue; }
 		VkQueue& getGraphicsComandQueue() { return m_graphicsComputeQueue; }
 		VkQueue& getPresentQueue() { return m_presentQueue; }
+		// Same family as the graphics queue, the graphics queue itself when the family has a single queue
+		VkQueue& getComputeQueue() { return m_computeQueue; }
+		// The graphics queue and command pool when there is no dedicated transfer family
+		VkQueue& getTransferQueue() { return m_transferQueue; }
+		VkCommandPool& getTransferCommandPool() { return m_transferCommandPool; }
+		bool hasDedicatedTransferQueue() const { return m_transferQueueFamily != m_graphicsQueueFamily; }
+		uint32_t getGraphicsQueueFamily() const { return m_graphicsQueueFamily; }
+		uint32_t getTransferQueueFamily() const { return m_transferQueueFamily; }
 		VkSampleCountFlagBits getMSAAsamples() { return m_msaaSamples; }
 		VkPhysicalDeviceFeatures& getDeviceFeatures() { return m_deviceFeatures; }
+		MemoryAllocator& getMemoryAllocator() { return *m_memoryAllocator; }
+		// Created with the logical device. Buffer and Texture create and release their resources through it.
+		ResourceRecycler& getResourceRecycler() { return *m_resourceRecycler; }
+		// Created with the command pool
+		UploadManager& getUploadManager() { return *m_uploadManager; }
 
 	private:
 		bool isDeviceSuitable(VkPhysicalDevice device);
@@ -85,6 +117,7 @@ namespace AE {
 		int rateDeviceSuitability(VkPhysicalDevice device);
 #endif
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
 		VkSampleCountFlagBits getMaxUsableSampleCount();
 
 		const std::vector<const char*> deviceExtensions = {
@@ -99,9 +132,17 @@ namespace AE {
 		VkDevice m_device;
 		VkQueue m_graphicsComputeQueue;
 		VkQueue m_presentQueue;
+		VkQueue m_transferQueue;
+		VkQueue m_computeQueue;
+		uint32_t m_graphicsQueueFamily = 0;
+		uint32_t m_transferQueueFamily = 0;
 		VkSurfaceKHR m_surface;
 		VkCommandPool m_commandPool;
+		VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
 		VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT; // msaa: Multisample anti-aliasing
 		VkPhysicalDeviceFeatures m_deviceFeatures;
+		std::unique_ptr<MemoryAllocator> m_memoryAllocator;
+		std::unique_ptr<ResourceRecycler> m_resourceRecycler;
+		std::unique_ptr<UploadManager> m_uploadManager;
 	};
 } // namespace AE
\ No newline at end of file
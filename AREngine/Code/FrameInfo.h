@@ -35,6 +35,8 @@ namespace AE {
 		Camera& m_camera;
 		std::vector<VkDescriptorSet> m_descriptorSets;
 		GameObject::Map& m_gameObjects;
+		// For the dynamic uniform buffers of the global descriptor set (set 0), in binding order
+		std::vector<uint32_t> m_dynamicOffsets{};
 	};
 
 } // namespace AE
\ No newline at end of file
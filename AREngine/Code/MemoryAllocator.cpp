@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+
+#include "MemoryAllocator.h"
+
+namespace AE {
+
+	namespace {
+
+		// Block size of heaps bigger than 1 GB, smaller heaps use 1/8 of their size
+		constexpr VkDeviceSize LARGE_HEAP_BLOCK_SIZE = 256ull * 1024 * 1024;
+		constexpr VkDeviceSize SMALL_HEAP_MAX_SIZE = 1024ull * 1024 * 1024;
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		double toMegaBytes(VkDeviceSize bytes) {
+			return bytes / (1024.0 * 1024.0);
+		}
+
+	} // namespace
+
+	struct MemoryBlock {
+		MemoryBlock(VkDeviceSize size) : allocator{ size } {}
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		uint32_t poolIndex = 0;
+		TLSFAllocator allocator;
+	};
+
+	MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : m_device{ device } {
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		m_nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+		m_maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+		m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+		m_heapUsage.resize(m_memoryProperties.memoryHeapCount);
+
+		VkDeviceSize largestDeviceLocalHeap = 0;
+		for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++) {
+			if (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				largestDeviceLocalHeap = std::max(largestDeviceLocalHeap, m_memoryProperties.memoryHeaps[i].size);
+			}
+		}
+		const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+			const VkMemoryType& type = m_memoryProperties.memoryTypes[i];
+			if ((type.propertyFlags & directFlags) == directFlags && m_memoryProperties.memoryHeaps[type.heapIndex].size >= largestDeviceLocalHeap) {
+				m_directUploadMemoryType = i;
+				break;
+			}
+		}
+	}
+
+	MemoryAllocator::~MemoryAllocator() {
+		assert(m_stats.allocationCount == 0 && "destroying the memory allocator while buffers or images still use it");
+		for (Pool& pool : m_pools) {
+			for (std::unique_ptr<MemoryBlock>& block : pool.blocks) {
+				vkFreeMemory(m_device, block->memory, nullptr);
+			}
+		}
+	}
+
+	uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+		// Not some small BAR window that happens to come first
+		if (m_directUploadMemoryType != UINT32_MAX && (typeFilter & (1 << m_directUploadMemoryType)) &&
+			(m_memoryProperties.memoryTypes[m_directUploadMemoryType].propertyFlags & properties) == properties &&
+			(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+			return m_directUploadMemoryType;
+		}
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) &&
+				(m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	uint32_t MemoryAllocator::getHeapIndex(uint32_t memoryTypeIndex) const {
+		return m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	}
+
+	void MemoryAllocator::enableMemoryBudget(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2) {
+		m_physicalDevice = physicalDevice;
+		m_getMemoryProperties2 = getMemoryProperties2;
+	}
+
+	std::vector<MemoryAllocator::HeapBudget> MemoryAllocator::getHeapBudgets() {
+		std::vector<HeapBudget> budgets(m_memoryProperties.memoryHeapCount);
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		if (m_getMemoryProperties2 != nullptr) {
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memoryProperties2.pNext = &budgetProperties;
+			m_getMemoryProperties2(m_physicalDevice, &memoryProperties2);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++) {
+			HeapBudget& budget = budgets[i];
+			budget.heapSize = m_memoryProperties.memoryHeaps[i].size;
+			budget.deviceLocal = (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			budget.allocatedBytes = m_heapUsage[i].allocatedBytes;
+			budget.usedBytes = m_heapUsage[i].usedBytes;
+			budget.fromDriver = m_getMemoryProperties2 != nullptr;
+			if (budget.fromDriver) {
+				budget.budget = budgetProperties.heapBudget[i];
+				budget.usage = budgetProperties.heapUsage[i];
+			}
+			else {
+				// Without the extension: our own allocations against a fixed share of the heap
+				budget.budget = budget.heapSize / 10 * 8;
+				budget.usage = budget.allocatedBytes;
+			}
+		}
+		return budgets;
+	}
+
+	VkDeviceSize MemoryAllocator::getAvailableBytes(VkMemoryPropertyFlags properties) {
+		const uint32_t heapIndex = getHeapIndex(findMemoryType(UINT32_MAX, properties));
+		const HeapBudget budget = getHeapBudgets()[heapIndex];
+		return budget.usage < budget.budget ? budget.budget - budget.usage : 0;
+	}
+
+	void MemoryAllocator::printBudget(const char* label) {
+		std::vector<HeapBudget> budgets = getHeapBudgets();
+		printf("%s:", label);
+		for (uint32_t i = 0; i < budgets.size(); i++) {
+			const HeapBudget& budget = budgets[i];
+			printf(" heap %u%s %.1f / %.1f MB (ours %.1f MB, %.1f MB in use)%s", i, budget.deviceLocal ? " (device local)" : "",
+				toMegaBytes(budget.usage), toMegaBytes(budget.budget), toMegaBytes(budget.allocatedBytes), toMegaBytes(budget.usedBytes),
+				i + 1 < budgets.size() ? "," : "");
+		}
+		printf("%s\n", budgets.empty() || budgets[0].fromDriver ? "" : " (estimated, no VK_EXT_memory_budget)");
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		return heapSize <= SMALL_HEAP_MAX_SIZE ? alignUp(heapSize / 8, 32) : LARGE_HEAP_BLOCK_SIZE;
+	}
+
+	bool MemoryAllocator::isNonCoherent(uint32_t memoryTypeIndex) const {
+		VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	// Returns VK_NULL_HANDLE when the heap is out of memory
+	VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped) {
+		if (m_stats.deviceMemoryCount >= m_maxMemoryAllocationCount) {
+			throw std::runtime_error("failed to allocate device memory: maxMemoryAllocationCount reached!");
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			return VK_NULL_HANDLE;
+		}
+		m_stats.allocateMemoryCalls++;
+		m_stats.deviceMemoryCount++;
+
+		*mapped = nullptr;
+		if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			// A VkDeviceMemory can only be mapped once, so host visible memory is mapped as a whole and stays mapped
+			if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+				vkFreeMemory(m_device, memory, nullptr);
+				m_stats.deviceMemoryCount--;
+				throw std::runtime_error("failed to map device memory!");
+			}
+		}
+		m_heapUsage[getHeapIndex(memoryTypeIndex)].allocatedBytes += size;
+		return memory;
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, ResourceKind kind) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		MemoryAllocation allocation{};
+		allocation.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		VkDeviceSize size = memRequirements.size;
+		VkDeviceSize alignment = memRequirements.alignment;
+		if (isNonCoherent(allocation.memoryTypeIndex)) {
+			// Flushing or invalidating a whole atom must never touch a neighbour
+			alignment = std::max(alignment, m_nonCoherentAtomSize);
+			size = alignUp(size, m_nonCoherentAtomSize);
+		}
+		allocation.size = size;
+		m_stats.allocationRequests++;
+
+		VkDeviceSize blockSize = getBlockSize(allocation.memoryTypeIndex);
+		if (size <= blockSize / 2) {
+			uint32_t poolIndex = allocation.memoryTypeIndex * 2 + static_cast<uint32_t>(kind);
+			Pool& pool = m_pools[poolIndex];
+			TLSFAllocator::Allocation range;
+			MemoryBlock* block = nullptr;
+			for (std::unique_ptr<MemoryBlock>& candidate : pool.blocks) {
+				if (candidate->allocator.allocate(size, alignment, range)) {
+					block = candidate.get();
+					break;
+				}
+			}
+			if (block == nullptr) {
+				void* mapped;
+				VkDeviceMemory memory = allocateDeviceMemory(blockSize, allocation.memoryTypeIndex, &mapped);
+				if (memory != VK_NULL_HANDLE) {
+					pool.blocks.push_back(std::make_unique<MemoryBlock>(blockSize));
+					block = pool.blocks.back().get();
+					block->memory = memory;
+					block->mapped = mapped;
+					block->poolIndex = poolIndex;
+					block->allocator.allocate(size, alignment, range);
+					m_stats.blockCount++;
+					m_stats.blockBytes += blockSize;
+				}
+			}
+			if (block != nullptr) {
+				allocation.memory = block->memory;
+				allocation.offset = range.offset;
+				allocation.mapped = block->mapped != nullptr ? static_cast<char*>(block->mapped) + range.offset : nullptr;
+				allocation.block = block;
+				allocation.node = range.node;
+				m_stats.allocationCount++;
+				m_stats.usedBytes += size;
+				m_heapUsage[getHeapIndex(allocation.memoryTypeIndex)].usedBytes += size;
+				return allocation;
+			}
+			// No room for another block, try the exact size on its own
+		}
+
+		allocation.memory = allocateDeviceMemory(size, allocation.memoryTypeIndex, &allocation.mapped);
+		if (allocation.memory == VK_NULL_HANDLE) {
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+		m_stats.allocationCount++;
+		m_stats.dedicatedCount++;
+		m_stats.dedicatedBytes += size;
+		m_heapUsage[getHeapIndex(allocation.memoryTypeIndex)].usedBytes += size;
+		return allocation;
+	}
+
+	void MemoryAllocator::free(const MemoryAllocation& allocation) {
+		if (allocation.memory == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.allocationCount--;
+		HeapUsage& heapUsage = m_heapUsage[getHeapIndex(allocation.memoryTypeIndex)];
+		heapUsage.usedBytes -= allocation.size;
+
+		MemoryBlock* block = allocation.block;
+		if (block == nullptr) {
+			vkFreeMemory(m_device, allocation.memory, nullptr);
+			m_stats.deviceMemoryCount--;
+			m_stats.dedicatedCount--;
+			m_stats.dedicatedBytes -= allocation.size;
+			heapUsage.allocatedBytes -= allocation.size;
+			return;
+		}
+
+		block->allocator.free(allocation.node);
+		m_stats.usedBytes -= allocation.size;
+		if (!block->allocator.isEmpty()) {
+			return;
+		}
+		// Keep one empty block per pool, so that a load/unload cycle does not reallocate it every time
+		std::vector<std::unique_ptr<MemoryBlock>>& blocks = m_pools[block->poolIndex].blocks;
+		bool hasOtherEmptyBlock = std::any_of(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& other) {
+			return other.get() != block && other->allocator.isEmpty();
+		});
+		if (hasOtherEmptyBlock) {
+			m_stats.blockCount--;
+			m_stats.blockBytes -= block->allocator.getSize();
+			m_stats.deviceMemoryCount--;
+			heapUsage.allocatedBytes -= block->allocator.getSize();
+			vkFreeMemory(m_device, block->memory, nullptr);
+			blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& other) {
+				return other.get() == block;
+			}));
+		}
+	}
+
+	VkMappedMemoryRange MemoryAllocator::getMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const {
+		VkDeviceSize begin = allocation.offset + offset;
+		VkDeviceSize allocationEnd = allocation.offset + allocation.size;
+		VkDeviceSize end = size == VK_WHOLE_SIZE ? allocationEnd : begin + size;
+		if (isNonCoherent(allocation.memoryTypeIndex)) {
+			// The allocation itself starts and ends on atom boundaries
+			begin -= begin % m_nonCoherentAtomSize;
+			end = std::min(alignUp(end, m_nonCoherentAtomSize), allocationEnd);
+		}
+
+		VkMappedMemoryRange mappedRange = {};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = allocation.memory;
+		mappedRange.offset = begin;
+		mappedRange.size = end - begin;
+		return mappedRange;
+	}
+
+	VkResult MemoryAllocator::flushMappedRanges(const std::vector<VkMappedMemoryRange>& ranges) {
+		if (ranges.empty()) {
+			return VK_SUCCESS;
+		}
+		VkDeviceSize bytes = 0;
+		for (const VkMappedMemoryRange& range : ranges) {
+			bytes += range.size;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.flushCount++;
+			m_stats.flushedBytes += bytes;
+		}
+		return vkFlushMappedMemoryRanges(m_device, static_cast<uint32_t>(ranges.size()), ranges.data());
+	}
+
+	MemoryAllocator::Stats MemoryAllocator::getStats() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Stats stats = m_stats;
+		VkDeviceSize freeBytes = 0;
+		VkDeviceSize largestFreeRangeSum = 0;
+		for (const Pool& pool : m_pools) {
+			for (const std::unique_ptr<MemoryBlock>& block : pool.blocks) {
+				VkDeviceSize largestFreeRange = block->allocator.getLargestFreeRange();
+				freeBytes += block->allocator.getFreeBytes();
+				largestFreeRangeSum += largestFreeRange;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, largestFreeRange);
+				stats.freeRangeCount += block->allocator.getFreeRangeCount();
+			}
+		}
+		stats.fragmentation = freeBytes > 0 ? 1.f - static_cast<float>(static_cast<double>(largestFreeRangeSum) / freeBytes) : 0.f;
+		return stats;
+	}
+
+	void MemoryAllocator::printStats(const char* label) {
+		Stats stats = getStats();
+		printf("%s: %u buffers/images in %u VkDeviceMemory (%u blocks, %u dedicated), %llu vkAllocateMemory calls for %llu requests\n",
+			label, stats.allocationCount, stats.deviceMemoryCount, stats.blockCount, stats.dedicatedCount,
+			static_cast<unsigned long long>(stats.allocateMemoryCalls), static_cast<unsigned long long>(stats.allocationRequests));
+		printf("    blocks %.1f MB (%.1f MB used), dedicated %.1f MB, %u free ranges (largest %.1f MB), fragmentation %.1f%%\n",
+			toMegaBytes(stats.blockBytes), toMegaBytes(stats.usedBytes), toMegaBytes(stats.dedicatedBytes),
+			stats.freeRangeCount, toMegaBytes(stats.largestFreeRange), stats.fragmentation * 100.f);
+	}
+
+} // namespace AE
\ No newline at end of file
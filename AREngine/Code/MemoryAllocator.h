@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Utils/AREngineIncludes.h"
+#include "Utils/TLSFAllocator.h"
+
+namespace AE {
+
+	struct MemoryBlock;
+
+	// A range of a VkDeviceMemory handed out by MemoryAllocator. Bind the resource at memory + offset.
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// Start of this range when the memory type is host visible. The whole block stays mapped while it lives.
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		MemoryBlock* block = nullptr; // nullptr: dedicated VkDeviceMemory
+		uint32_t node = TLSFAllocator::INVALID_NODE;
+	};
+
+	// Sub-allocates buffers and images from a few big VkDeviceMemory blocks instead of calling vkAllocateMemory per resource,
+	// which keeps far below maxMemoryAllocationCount and wastes less alignment slack.
+	// There is one pool per memory type and resource kind: buffers (linear) and optimal tiling images never share a block,
+	// so bufferImageGranularity can be ignored inside a block. Each block is managed by a TLSFAllocator.
+	// Requests bigger than half a block (e.g. the point cloud SSBOs) get a dedicated VkDeviceMemory.
+	class MemoryAllocator {
+	public:
+		enum class ResourceKind {
+			Buffer,
+			OptimalImage
+		};
+
+		struct Stats {
+			uint32_t deviceMemoryCount = 0;    // live VkDeviceMemory objects (blocks + dedicated)
+			uint32_t blockCount = 0;
+			uint32_t dedicatedCount = 0;
+			uint32_t allocationCount = 0;      // live buffers and images
+			uint64_t allocateMemoryCalls = 0;  // vkAllocateMemory calls so far
+			uint64_t allocationRequests = 0;   // allocate() calls so far, i.e. vkAllocateMemory calls without sub-allocation
+			VkDeviceSize blockBytes = 0;       // reserved by the blocks
+			VkDeviceSize usedBytes = 0;        // sub-allocated from the blocks
+			VkDeviceSize dedicatedBytes = 0;
+			VkDeviceSize largestFreeRange = 0;
+			uint32_t freeRangeCount = 0;
+			uint64_t flushCount = 0;           // vkFlushMappedMemoryRanges calls so far
+			uint64_t flushedBytes = 0;         // bytes made visible to the device by them
+			// 1 - (sum of the largest free range of every block) / (free bytes of all blocks).
+			// 0: the free space of every block is one contiguous range.
+			float fragmentation = 0.f;
+		};
+
+		// Per memory heap. budget and usage come from VK_EXT_memory_budget when it is enabled and include other
+		// processes, otherwise usage is what this allocator took and budget 80% of the heap.
+		struct HeapBudget {
+			VkDeviceSize heapSize = 0;
+			VkDeviceSize budget = 0;
+			VkDeviceSize usage = 0;
+			VkDeviceSize allocatedBytes = 0; // VkDeviceMemory of this allocator (blocks + dedicated)
+			VkDeviceSize usedBytes = 0;      // by live buffers and images
+			bool deviceLocal = false;
+			bool fromDriver = false;
+		};
+
+		MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+		~MemoryAllocator();
+
+		// Not copyable or movable
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+		MemoryAllocator(MemoryAllocator&&) = delete;
+		MemoryAllocator& operator=(MemoryAllocator&&) = delete;
+
+		MemoryAllocation allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, ResourceKind kind);
+		void free(const MemoryAllocation& allocation);
+
+		// [offset, offset + size) of the allocation widened to nonCoherentAtomSize, for vkFlush/InvalidateMappedMemoryRanges.
+		// size may be VK_WHOLE_SIZE (up to the end of the allocation).
+		VkMappedMemoryRange getMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+		// One vkFlushMappedMemoryRanges call for all ranges, counted in the stats
+		VkResult flushMappedRanges(const std::vector<VkMappedMemoryRange>& ranges);
+		bool isNonCoherent(uint32_t memoryTypeIndex) const;
+		VkDeviceSize getNonCoherentAtomSize() const { return m_nonCoherentAtomSize; }
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		// The device has to be created with VK_EXT_memory_budget, the instance with VK_KHR_get_physical_device_properties2
+		void enableMemoryBudget(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2);
+		std::vector<HeapBudget> getHeapBudgets();
+		// Bytes left in the budget of the heap new resources with these properties would come from
+		VkDeviceSize getAvailableBytes(VkMemoryPropertyFlags properties);
+		void printBudget(const char* label);
+		// True on UMA devices (integrated GPUs, lavapipe) and with resizable BAR: the biggest device local heap
+		// has a host visible memory type, so GPU resident buffers can be written by the host without staging.
+		// A small (256 MB) BAR window next to a bigger device local heap does not count.
+		bool supportsDirectUpload() const { return m_directUploadMemoryType != UINT32_MAX; }
+		Stats getStats();
+		void printStats(const char* label);
+
+	private:
+		struct Pool {
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		struct HeapUsage {
+			VkDeviceSize allocatedBytes = 0;
+			VkDeviceSize usedBytes = 0;
+		};
+
+		uint32_t getHeapIndex(uint32_t memoryTypeIndex) const;
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+
+		VkDevice m_device;
+		VkPhysicalDeviceMemoryProperties m_memoryProperties;
+		VkDeviceSize m_nonCoherentAtomSize;
+		uint32_t m_maxMemoryAllocationCount;
+		uint32_t m_directUploadMemoryType = UINT32_MAX; // preferred for DEVICE_LOCAL | HOST_VISIBLE requests
+		std::vector<Pool> m_pools; // memoryTypeIndex * 2 + ResourceKind
+		std::vector<HeapUsage> m_heapUsage;
+		VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr;
+		std::mutex m_mutex;
+		Stats m_stats{};
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <glm/gtx/hash.hpp>
 
 #include "Model.h"
+#include "UploadManager.h"
 #include "Utils/AREngineDefines.h"
 #include "Utils/utils.h"
 #include "Input/tiny_obj_loader.h"
@@ -27,6 +28,10 @@ namespace AE {
         Builder builder{};
         builder.loadModel(filePath);
         //printf("Vertex count: %d\n", builder.m_vertices.size());
+        return createModelFromBuilder(devices, builder);
+    }
+
+    std::unique_ptr<Model> Model::createModelFromBuilder(Devices& devices, const Builder& builder) {
         std::unique_ptr<Model> new_model = std::make_unique<Model>(devices);
         new_model->createVertexBuffers(builder.m_vertices);
         new_model->createIndexBuffers(builder.m_indices);
@@ -39,28 +44,17 @@ namespace AE {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
         uint32_t vertexSize = sizeof(vertices[0]);
 
-        Buffer stagingBuffer{
-            m_devices,
-            vertexSize,
-            m_vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        // create a region of host(cpu) memory mapped to device memory and set data to point to the beginning of the mapped memory range
-        stagingBuffer.map();
-        // As we specified VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data will automatically be flushed to update device memory after memcpy
-        stagingBuffer.writeToBuffer((void*)vertices.data());
-
         m_vertexBuffer = std::make_unique<Buffer>(
             m_devices,
             vertexSize,
             m_vertexCount,
             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            m_devices.getDeviceLocalMemoryProperties()
         );
 
-        m_devices.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+        // written in place when device local memory is host visible, otherwise staged through the upload ring
+        // and copied with the next batch
+        m_devices.getUploadManager().uploadBuffer(*m_vertexBuffer, vertices.data(), bufferSize);
     }
 
     void Model::createIndexBuffers(const std::vector<uint32_t>& indices) {
@@ -73,26 +67,15 @@ namespace AE {
         VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
         uint32_t indexSize = sizeof(indices[0]);
 
-        Buffer stagingBuffer{
-            m_devices,
-            indexSize,
-            m_indexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)indices.data());
-
         m_indexBuffer = std::make_unique<Buffer>(
             m_devices,
             indexSize,
             m_indexCount,
             VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            m_devices.getDeviceLocalMemoryProperties()
         );
 
-        m_devices.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+        m_devices.getUploadManager().uploadBuffer(*m_indexBuffer, indices.data(), bufferSize);
     }
 
     void Model::createTexture(const char* filePath) {
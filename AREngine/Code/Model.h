@@ -40,6 +40,8 @@ namespace AE {
         Model& operator=(const Model&) = delete;
 
         static std::unique_ptr<Model> createModelFromFile(Devices& devices, const char* filePath);
+        // e.g. for meshes generated on the cpu such as the RGBD reconstruction
+        static std::unique_ptr<Model> createModelFromBuilder(Devices& devices, const Builder& builder);
 
         void createVertexBuffers(const std::vector<Vertex>& vertices);
         void createIndexBuffers(const std::vector<uint32_t>& indices);
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "../Utils/AREngineDefines.h"
+#include "PagedPointCloud.h"
+#include "../UploadManager.h"
+
+namespace AE {
+
+    PagedPointCloud::PagedPointCloud(Devices& devices, uint32_t indexCount, const Settings& settings)
+        : m_devices{ devices }, m_settings{ settings }, m_indexCount{ indexCount } {
+        m_settings.chunkCapacity = std::max(m_settings.chunkCapacity, 1u);
+        if (!(m_settings.chunkSize > 0.f)) {
+            throw std::runtime_error("failed to create paged point cloud! The chunk size must be positive");
+        }
+    }
+
+    glm::vec3 PagedPointCloud::getPosition(
+        const char* point,
+        PointCloud::PointFormat pointFormat,
+        const PointCloud::CompactPushConstantData& compactPushConstants
+    ) {
+        if (pointFormat == PointCloud::PointFormat::Compact) {
+            const CompactParticleInstance* particle = reinterpret_cast<const CompactParticleInstance*>(point);
+            const glm::vec3 quantized(
+                static_cast<float>(particle->positionXY & 0xffff),
+                static_cast<float>(particle->positionXY >> 16),
+                static_cast<float>(particle->positionZ & 0xffff)
+            );
+            return glm::vec3(compactPushConstants.boundsMin) + quantized * glm::vec3(compactPushConstants.boundsScale);
+        }
+        return glm::vec3(reinterpret_cast<const ParticleInstance*>(point)->position);
+    }
+
+    PagedPointCloud::Cells PagedPointCloud::findCells(
+        const char* points,
+        size_t pointCount,
+        PointCloud::PointFormat pointFormat,
+        const PointCloud::CompactPushConstantData& compactPushConstants,
+        float chunkSize
+    ) {
+        const uint32_t pointSize = PointCloud::getPointSize(pointFormat);
+        Cells cells{};
+
+        // Grid cell of every point, counting sort by cell
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        for (size_t i = 0; i < pointCount; i++) {
+            boundsMin = glm::min(boundsMin, getPosition(points + i * pointSize, pointFormat, compactPushConstants));
+        }
+        std::unordered_map<uint64_t, uint32_t> cellIndices;
+        std::vector<uint64_t> cellKeys;
+        cells.pointCells.resize(pointCount);
+        for (size_t i = 0; i < pointCount; i++) {
+            const glm::vec3 cell = glm::floor((getPosition(points + i * pointSize, pointFormat, compactPushConstants) - boundsMin) / chunkSize);
+            // 21 bits per axis, i.e. two million cells along each axis
+            const uint64_t key =
+                static_cast<uint64_t>(std::min(cell.x, 2097151.f)) |
+                static_cast<uint64_t>(std::min(cell.y, 2097151.f)) << 21 |
+                static_cast<uint64_t>(std::min(cell.z, 2097151.f)) << 42;
+            auto inserted = cellIndices.emplace(key, static_cast<uint32_t>(cellKeys.size()));
+            if (inserted.second) {
+                cellKeys.push_back(key);
+            }
+            cells.pointCells[i] = inserted.first->second;
+        }
+        // Cells in key order so that the chunks do not depend on the point order
+        cells.cellOrder.resize(cellKeys.size());
+        for (uint32_t i = 0; i < cells.cellOrder.size(); i++) {
+            cells.cellOrder[i] = i;
+        }
+        std::sort(cells.cellOrder.begin(), cells.cellOrder.end(), [&cellKeys](uint32_t a, uint32_t b) { return cellKeys[a] < cellKeys[b]; });
+        cells.cellCounts.assign(cellKeys.size(), 0);
+        for (uint32_t cell : cells.pointCells) {
+            cells.cellCounts[cell]++;
+        }
+        cells.cellFirst.resize(cellKeys.size());
+        size_t first = 0;
+        for (uint32_t cell : cells.cellOrder) {
+            cells.cellFirst[cell] = first;
+            first += cells.cellCounts[cell];
+        }
+        return cells;
+    }
+
+    void PagedPointCloud::sortIntoChunks(
+        void* points,
+        size_t pointCount,
+        PointCloud::PointFormat pointFormat,
+        const PointCloud::CompactPushConstantData& compactPushConstants,
+        const Settings& settings
+    ) {
+        const uint32_t pointSize = PointCloud::getPointSize(pointFormat);
+        char* data = static_cast<char*>(points);
+        const Cells cells = findCells(data, pointCount, pointFormat, compactPushConstants, settings.chunkSize);
+
+        // Stable within a cell, so sorted points stay where they are
+        std::vector<size_t> destination(pointCount);
+        std::vector<size_t> cellNext(cells.cellFirst);
+        for (size_t i = 0; i < pointCount; i++) {
+            destination[i] = cellNext[cells.pointCells[i]]++;
+        }
+        // Follows the cycles of the permutation, so only two points are held aside at a time
+        std::vector<char> carried(pointSize);
+        std::vector<char> displaced(pointSize);
+        for (size_t start = 0; start < pointCount; start++) {
+            if (destination[start] == start) {
+                continue;
+            }
+            memcpy(carried.data(), data + start * pointSize, pointSize);
+            size_t next = destination[start];
+            destination[start] = start;
+            while (next != start) {
+                memcpy(displaced.data(), data + next * pointSize, pointSize);
+                memcpy(data + next * pointSize, carried.data(), pointSize);
+                carried.swap(displaced);
+                const size_t after = destination[next];
+                destination[next] = next;
+                next = after;
+            }
+            memcpy(data + start * pointSize, carried.data(), pointSize);
+        }
+    }
+
+    void PagedPointCloud::build(
+        const void* points,
+        size_t pointCount,
+        PointCloud::PointFormat pointFormat,
+        const PointCloud::CompactPushConstantData& compactPushConstants
+    ) {
+        m_pointFormat = pointFormat;
+        m_compactPushConstants = compactPushConstants;
+        m_pointSize = PointCloud::getPointSize(pointFormat);
+        m_cache = nullptr;
+        buildChunks(static_cast<const char*>(points), pointCount, false);
+        createPool(pointCount);
+    }
+
+    void PagedPointCloud::build(
+        std::unique_ptr<PointCloudCache> cache,
+        PointCloud::PointFormat pointFormat,
+        const PointCloud::CompactPushConstantData& compactPushConstants
+    ) {
+        m_pointFormat = pointFormat;
+        m_compactPushConstants = compactPushConstants;
+        m_pointSize = PointCloud::getPointSize(pointFormat);
+        m_cache = std::move(cache);
+        const size_t pointCount = static_cast<size_t>(m_cache->getHeader().pointNum);
+        buildChunks(static_cast<const char*>(m_cache->getPointData()), pointCount, true);
+        if (m_points != m_cache->getPointData()) {
+            // Copied, the mapping is not needed anymore
+            m_cache = nullptr;
+        }
+        createPool(pointCount);
+    }
+
+    void PagedPointCloud::buildChunks(const char* points, size_t pointCount, bool pointsStay) {
+        const Cells cells = findCells(points, pointCount, m_pointFormat, m_compactPushConstants, m_settings.chunkSize);
+
+        std::vector<size_t> cellNext(cells.cellFirst);
+        bool chunkOrder = true;
+        for (size_t i = 0; i < pointCount && chunkOrder; i++) {
+            chunkOrder = cellNext[cells.pointCells[i]]++ == i;
+        }
+        m_pointCopy.clear();
+        if (pointsStay && chunkOrder) {
+            m_points = points;
+        }
+        else {
+            m_pointCopy.resize(pointCount * m_pointSize);
+            cellNext = cells.cellFirst;
+            for (size_t i = 0; i < pointCount; i++) {
+                memcpy(m_pointCopy.data() + cellNext[cells.pointCells[i]]++ * m_pointSize, points + i * m_pointSize, m_pointSize);
+            }
+            m_points = m_pointCopy.data();
+        }
+
+        // Chunks of at most chunkCapacity points with their own bounds
+        m_chunks.clear();
+        for (uint32_t cell : cells.cellOrder) {
+            for (size_t offset = 0; offset < cells.cellCounts[cell]; offset += m_settings.chunkCapacity) {
+                Chunk chunk{};
+                chunk.firstPoint = cells.cellFirst[cell] + offset;
+                chunk.pointCount = static_cast<uint32_t>(std::min<size_t>(cells.cellCounts[cell] - offset, m_settings.chunkCapacity));
+                chunk.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+                chunk.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+                for (uint32_t i = 0; i < chunk.pointCount; i++) {
+                    const glm::vec3 position = getPosition(m_points + (chunk.firstPoint + i) * m_pointSize, m_pointFormat, m_compactPushConstants);
+                    chunk.boundsMin = glm::min(chunk.boundsMin, position);
+                    chunk.boundsMax = glm::max(chunk.boundsMax, position);
+                }
+                m_chunks.push_back(chunk);
+            }
+        }
+        m_order.resize(m_chunks.size());
+    }
+
+    void PagedPointCloud::createPool(size_t pointCount) {
+        // Device pool, no bigger than the budget allows and than the whole cloud
+        const VkDeviceSize slotBytes = static_cast<VkDeviceSize>(m_settings.chunkCapacity) * m_pointSize;
+        const VkMemoryPropertyFlags poolProperties = m_devices.getDeviceLocalMemoryProperties();
+        const VkDeviceSize poolBytes = std::min(m_settings.poolBytes, m_devices.getMemoryAllocator().getAvailableBytes(poolProperties));
+        m_slotCount = static_cast<uint32_t>(std::min<VkDeviceSize>(poolBytes / slotBytes, std::max<size_t>(m_chunks.size(), 1)));
+        if (m_slotCount == 0) {
+            throw std::runtime_error("failed to create paged point cloud! Not even one chunk fits into the device memory budget");
+        }
+        m_pool = std::make_unique<Buffer>(
+            m_devices,
+            slotBytes,
+            m_slotCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            poolProperties
+        );
+        m_freeSlots.resize(m_slotCount);
+        for (uint32_t i = 0; i < m_slotCount; i++) {
+            // popped from the back, so slot 0 goes first
+            m_freeSlots[i] = m_slotCount - 1 - i;
+        }
+        m_evictedSlots.clear();
+
+
+        // At most one draw per slot. Also a storage buffer, so that it can stand in for the compute shader's indirect buffers.
+        m_indirectCommandsBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        for (std::unique_ptr<Buffer>& indirectCommandsBuffer : m_indirectCommandsBuffers) {
+            indirectCommandsBuffer = std::make_unique<Buffer>(
+                m_devices,
+                sizeof(VkDrawIndexedIndirectCommand),
+                m_slotCount,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            );
+            if (indirectCommandsBuffer->map() != VK_SUCCESS) {
+                throw std::runtime_error("failed to map point cloud indirect buffer!");
+            }
+        }
+        m_drawCounts.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+        m_stats = Stats{};
+        m_stats.chunkCount = static_cast<uint32_t>(m_chunks.size());
+        m_stats.slotCount = m_slotCount;
+        printf("Paged point cloud: %zu points in %zu chunks (%.2f m cells), %u slots of %u points (%.1f MB pool, %s), %s\n",
+            pointCount, m_chunks.size(), m_settings.chunkSize, m_slotCount, m_settings.chunkCapacity,
+            m_pool->getBufferSize() / (1024.0 * 1024.0), m_devices.getUploadManager().writesInPlace(*m_pool) ? "written in place" : "staged",
+            m_cache != nullptr ? "paged from the mapped cache" : "copied to host memory");
+    }
+
+    void PagedPointCloud::update(FrameInfo& frameInfo, FrameScheduler& frameScheduler) {
+        const uint64_t completedFrame = frameScheduler.getCompletedSerial();
+        while (!m_evictedSlots.empty() && m_evictedSlots.front().lastFrame <= completedFrame) {
+            m_freeSlots.push_back(m_evictedSlots.front().slot);
+            m_evictedSlots.pop_front();
+        }
+
+        rankChunks(frameInfo.m_camera);
+        uint32_t missingCount = 0;
+        m_stats.missingCount = 0;
+        for (const Chunk& chunk : m_chunks) {
+            if (chunk.wanted && chunk.slot < 0) {
+                missingCount++;
+                m_stats.missingCount += chunk.visible ? 1 : 0;
+            }
+        }
+        // The frame being recorded does not draw the evicted chunks, the last submitted one may
+        evictChunks(missingCount, frameScheduler.getSubmittedSerial());
+        pageIn();
+        writeDraws(frameInfo.m_frameIndex);
+    }
+
+    void PagedPointCloud::rankChunks(const Camera& camera) {
+        // Frustum planes (a, b, c, d), inside when a * x + b * y + c * z + d >= 0. Depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE).
+        const glm::mat4 clip = camera.getProjection() * camera.getView();
+        const glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+        const glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+        const glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+        const glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+        const glm::vec4 planes[6] = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+        const glm::vec3 cameraPosition = camera.getPosition();
+
+        for (Chunk& chunk : m_chunks) {
+            chunk.visible = true;
+            for (const glm::vec4& plane : planes) {
+                // The corner furthest along the plane normal
+                const glm::vec3 corner(
+                    plane.x >= 0.f ? chunk.boundsMax.x : chunk.boundsMin.x,
+                    plane.y >= 0.f ? chunk.boundsMax.y : chunk.boundsMin.y,
+                    plane.z >= 0.f ? chunk.boundsMax.z : chunk.boundsMin.z
+                );
+                if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+                    chunk.visible = false;
+                    break;
+                }
+            }
+            const glm::vec3 nearest = glm::clamp(cameraPosition, chunk.boundsMin, chunk.boundsMax);
+            chunk.distance = glm::length(nearest - cameraPosition);
+        }
+
+        // Visible chunks first, then the ones nearby to turn around to. The best m_slotCount are wanted.
+        for (uint32_t i = 0; i < m_order.size(); i++) {
+            m_order[i] = i;
+        }
+        auto better = [this](uint32_t a, uint32_t b) {
+            const Chunk& chunkA = m_chunks[a];
+            const Chunk& chunkB = m_chunks[b];
+            if (chunkA.visible != chunkB.visible) {
+                return chunkA.visible;
+            }
+            return chunkA.distance < chunkB.distance;
+        };
+        const size_t wantedCount = std::min<size_t>(m_slotCount, m_order.size());
+        std::nth_element(m_order.begin(), m_order.begin() + wantedCount, m_order.end(), better);
+        std::sort(m_order.begin(), m_order.begin() + wantedCount, better);
+        for (size_t i = 0; i < m_order.size(); i++) {
+            m_chunks[m_order[i]].wanted = i < wantedCount;
+        }
+    }
+
+    void PagedPointCloud::evictChunks(uint32_t missingCount, uint64_t lastFrame) {
+        const size_t slotsComing = m_freeSlots.size() + m_evictedSlots.size();
+        if (missingCount <= slotsComing) {
+            // Unwanted chunks stay resident as long as their slots are not needed, in case the camera turns back
+            return;
+        }
+        // The worst ranked resident chunks first
+        size_t evictCount = missingCount - slotsComing;
+        for (auto it = m_order.rbegin(); it != m_order.rend() && evictCount > 0; ++it) {
+            Chunk& chunk = m_chunks[*it];
+            if (chunk.wanted || chunk.slot < 0) {
+                continue;
+            }
+            m_evictedSlots.push_back({ static_cast<uint32_t>(chunk.slot), lastFrame });
+            chunk.slot = -1;
+            m_stats.evictedCount++;
+            evictCount--;
+        }
+    }
+
+    void PagedPointCloud::pageIn() {
+        const VkDeviceSize slotBytes = static_cast<VkDeviceSize>(m_settings.chunkCapacity) * m_pointSize;
+        UploadManager& uploadManager = m_devices.getUploadManager();
+        VkDeviceSize uploadedBytes = 0;
+
+        for (uint32_t chunkIndex : m_order) {
+            Chunk& chunk = m_chunks[chunkIndex];
+            if (!chunk.wanted || m_freeSlots.empty()) {
+                break;
+            }
+            if (chunk.slot >= 0) {
+                continue;
+            }
+            const VkDeviceSize bytes = static_cast<VkDeviceSize>(chunk.pointCount) * m_pointSize;
+            if (uploadedBytes > 0 && uploadedBytes + bytes > m_settings.uploadBytesPerFrame) {
+                break;
+            }
+            chunk.slot = static_cast<int32_t>(m_freeSlots.back());
+            m_freeSlots.pop_back();
+
+            // Nothing in flight reads a free slot. A host visible pool is written in place, otherwise the chunk goes
+            // through the staging ring and only the slot changes queue family on a dedicated transfer queue.
+            // Straight from the mapped cache file when there is one, the OS reads the chunk in.
+            uploadManager.uploadBuffer(*m_pool, m_points + chunk.firstPoint * m_pointSize, bytes, chunk.slot * slotBytes);
+            uploadedBytes += bytes;
+            m_stats.pagedInCount++;
+        }
+        m_stats.pagedInBytes += uploadedBytes;
+        if (uploadedBytes > 0) {
+            // Before the frame is submitted, so the graphics queue acquires the slots before it draws them
+            uploadManager.submit();
+        }
+    }
+
+    void PagedPointCloud::writeDraws(int frameIndex) {
+        Buffer& indirectCommandsBuffer = *m_indirectCommandsBuffers[frameIndex];
+        VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectCommandsBuffer.getMappedMemory());
+        uint32_t drawCount = 0;
+        m_stats.residentCount = 0;
+        for (const Chunk& chunk : m_chunks) {
+            if (chunk.slot < 0) {
+                continue;
+            }
+            m_stats.residentCount++;
+            if (!chunk.visible) {
+                continue;
+            }
+            VkDrawIndexedIndirectCommand& command = commands[drawCount++];
+            command.indexCount = m_indexCount;
+            command.instanceCount = chunk.pointCount;
+            command.firstIndex = 0;
+            command.vertexOffset = 0;
+            command.firstInstance = static_cast<uint32_t>(chunk.slot) * m_settings.chunkCapacity;
+        }
+        if (drawCount > 0) {
+            indirectCommandsBuffer.markDirty(drawCount * sizeof(VkDrawIndexedIndirectCommand), 0);
+            if (indirectCommandsBuffer.flushDirty() != VK_SUCCESS) {
+                throw std::runtime_error("failed to flush point cloud indirect buffer!");
+            }
+        }
+        m_drawCounts[frameIndex] = drawCount;
+        m_stats.drawCount = drawCount;
+    }
+
+    void PagedPointCloud::draw(FrameInfo& frameInfo) {
+        const uint32_t drawCount = m_drawCounts[frameInfo.m_frameIndex];
+        VkBuffer indirectBuffer = m_indirectCommandsBuffers[frameInfo.m_frameIndex]->getBuffer();
+        if (drawCount == 0) {
+            return;
+        }
+        if (m_devices.getDeviceFeatures().multiDrawIndirect) {
+            vkCmdDrawIndexedIndirect(frameInfo.m_commandBuffer, indirectBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else {
+            for (uint32_t i = 0; i < drawCount; i++) {
+                vkCmdDrawIndexedIndirect(frameInfo.m_commandBuffer, indirectBuffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+
+    void PagedPointCloud::printStats(const char* label) const {
+        printf("%s: %u/%u chunks resident in %u slots, %u drawn, %u visible missing, %llu paged in (%.1f MB), %llu evicted\n",
+            label,
+            m_stats.residentCount,
+            m_stats.chunkCount,
+            m_stats.slotCount,
+            m_stats.drawCount,
+            m_stats.missingCount,
+            static_cast<unsigned long long>(m_stats.pagedInCount),
+            m_stats.pagedInBytes / (1024.0 * 1024.0),
+            static_cast<unsigned long long>(m_stats.evictedCount));
+    }
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "../Utils/AREngineIncludes.h"
+#include "../Devices.h"
+#include "../Buffer.h"
+#include "../FrameInfo.h"
+#include "../Renderer/FrameScheduler.h"
+#include "PointCloud.h"
+
+namespace AE {
+
+    // Point cloud that does not have to fit into device memory.
+    // build() sorts the points into the cells of a uniform grid, cells with more than chunkCapacity points are split,
+    // and keeps the bounds of the chunks. The points of a mapped PointCloudCache that are already in chunk order
+    // (sortIntoChunks) are paged in straight from the file, other points are copied into host memory in chunk order.
+    // The device only holds a pool of fixed size slots (chunkCapacity points each) in one SSBO.
+    // update() ranks the chunks every frame, visible ones first and nearer ones before farther ones, pages the best
+    // ranked missing chunks into free slots and writes one indirect draw per resident visible chunk.
+    // At most uploadBytesPerFrame are paged in per frame through the UploadManager (one batch per frame, written in
+    // place when the pool is host visible), so moving the camera costs a bounded amount of frame time
+    // and the missing chunks pop in over the next frames instead.
+    // An evicted slot is tagged with the serial of the last submitted frame (FrameScheduler), and reused once that
+    // frame has completed and no frame in flight reads it anymore.
+    class PagedPointCloud {
+    public:
+        struct Settings {
+            float chunkSize = 1.f;                                  // grid cell edge length (meters)
+            uint32_t chunkCapacity = 64 * 1024;                     // points per slot
+            VkDeviceSize poolBytes = 256ull * 1024 * 1024;          // clamped to the device memory budget
+            VkDeviceSize uploadBytesPerFrame = 8ull * 1024 * 1024;  // at least one chunk per frame
+        };
+
+        struct Stats {
+            uint32_t chunkCount = 0;
+            uint32_t slotCount = 0;
+            uint32_t residentCount = 0;
+            uint32_t drawCount = 0;      // resident visible chunks of the last frame
+            uint32_t missingCount = 0;   // visible chunks of the last frame that were not resident (yet)
+            uint64_t pagedInCount = 0;
+            uint64_t pagedInBytes = 0;
+            uint64_t evictedCount = 0;
+        };
+
+        PagedPointCloud(Devices& devices, uint32_t indexCount, const Settings& settings);
+
+        // Not copyable or movable
+        PagedPointCloud(const PagedPointCloud&) = delete;
+        PagedPointCloud& operator=(const PagedPointCloud&) = delete;
+        PagedPointCloud(PagedPointCloud&&) = delete;
+        PagedPointCloud& operator=(PagedPointCloud&&) = delete;
+
+        // Reorders pointCount points in the SSBO layout of pointFormat in place, so that every chunk that build() makes
+        // of them with the chunk size of settings is one range. Cache them in this order to page from the file.
+        static void sortIntoChunks(
+            void* points,
+            size_t pointCount,
+            PointCloud::PointFormat pointFormat,
+            const PointCloud::CompactPushConstantData& compactPushConstants,
+            const Settings& settings
+        );
+
+        // Copies pointCount points in the SSBO layout of pointFormat into chunks and creates the device pool.
+        // compactPushConstants decode compact positions.
+        void build(
+            const void* points,
+            size_t pointCount,
+            PointCloud::PointFormat pointFormat,
+            const PointCloud::CompactPushConstantData& compactPushConstants
+        );
+        // Keeps the file mapped and pages the chunks in from it. Falls back to a copy when the points are not in chunk order.
+        void build(
+            std::unique_ptr<PointCloudCache> cache,
+            PointCloud::PointFormat pointFormat,
+            const PointCloud::CompactPushConstantData& compactPushConstants
+        );
+        // Before the frame is submitted: pages chunks in for the camera of frameInfo (submitted as an UploadManager
+        // batch right away) and writes the draws of frameInfo.m_frameIndex
+        void update(FrameInfo& frameInfo, FrameScheduler& frameScheduler);
+        void draw(FrameInfo& frameInfo);
+
+        Buffer& getPoolBuffer() { return *m_pool; }
+        Buffer& getIndirectCommandsBuffer(int frameIndex) { return *m_indirectCommandsBuffers[frameIndex]; }
+        PointCloud::PointFormat getPointFormat() const { return m_pointFormat; }
+        const PointCloud::CompactPushConstantData& getCompactPushConstants() const { return m_compactPushConstants; }
+        const Stats& getStats() const { return m_stats; }
+        void printStats(const char* label) const;
+
+    private:
+        struct Chunk {
+            glm::vec3 boundsMin;
+            glm::vec3 boundsMax;
+            size_t firstPoint;   // index in m_points
+            uint32_t pointCount;
+            int32_t slot = -1;   // -1 when not resident
+            // ranking of the current frame
+            bool visible = false;
+            bool wanted = false;
+            float distance = 0.f;
+        };
+
+        struct EvictedSlot {
+            uint32_t slot;
+            uint64_t lastFrame;  // serial of the last frame that may read it
+        };
+
+        // Grid cells of a point cloud, chunk order is cell key order
+        struct Cells {
+            std::vector<uint32_t> pointCells; // cell of every point
+            std::vector<uint32_t> cellOrder;  // cells in key order
+            std::vector<size_t> cellCounts;
+            std::vector<size_t> cellFirst;    // first point of every cell in chunk order
+        };
+
+        static glm::vec3 getPosition(
+            const char* point,
+            PointCloud::PointFormat pointFormat,
+            const PointCloud::CompactPushConstantData& compactPushConstants
+        );
+        static Cells findCells(
+            const char* points,
+            size_t pointCount,
+            PointCloud::PointFormat pointFormat,
+            const PointCloud::CompactPushConstantData& compactPushConstants,
+            float chunkSize
+        );
+        // pointsStay: the points outlive the paged cloud (m_cache), so they are not copied when they are in chunk order
+        void buildChunks(const char* points, size_t pointCount, bool pointsStay);
+        void createPool(size_t pointCount);
+        void rankChunks(const Camera& camera);
+        // Evicts unwanted chunks until there are enough slots, free or about to become free, for the missing wanted ones
+        void evictChunks(uint32_t missingCount, uint64_t lastFrame);
+        void pageIn();
+        void writeDraws(int frameIndex);
+
+        Devices& m_devices;
+        Settings m_settings;
+        uint32_t m_indexCount;
+        PointCloud::PointFormat m_pointFormat = PointCloud::PointFormat::Full;
+        PointCloud::CompactPushConstantData m_compactPushConstants{};
+        uint32_t m_pointSize = 0;
+
+        const char* m_points = nullptr;  // chunk after chunk, in m_cache or m_pointCopy
+        std::unique_ptr<PointCloudCache> m_cache;
+        std::vector<char> m_pointCopy;
+        std::vector<Chunk> m_chunks;
+        std::vector<uint32_t> m_order; // chunk indices, best ranked first
+
+        std::unique_ptr<Buffer> m_pool;
+        uint32_t m_slotCount = 0;
+        std::vector<uint32_t> m_freeSlots;
+        std::deque<EvictedSlot> m_evictedSlots;
+        std::vector<std::unique_ptr<Buffer>> m_indirectCommandsBuffers; // one per frame in flight, host visible
+        std::vector<uint32_t> m_drawCounts;
+        Stats m_stats{};
+    };
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace AE {
+
+    // One point of the particle SSBO (PointCloud::PointFormat::Full), must match Particle in the particle shaders.
+    // Kept free of Vulkan so that the point cloud readers/writers can be used by the headless build.
+    struct ParticleInstance {
+        ParticleInstance() {};
+        ParticleInstance(
+            float px, float py, float pz,
+            float cx = 1.f, float cy = 1.f, float cz = 1.f, float ca = 1.0f,
+            float vx = 0.f, float vy = 0.f, float vz = 1.f
+        )
+            : position{ px, py, pz, 1.0f }
+            , color{ cx, cy, cz, ca }
+            , velocity{ vx, vy, vz, 0.0f }
+        {}
+
+        ParticleInstance(
+            glm::vec4 pos, 
+            glm::vec4 color,
+            float vx = 0.f, float vy = 0.f, float vz = 1.f
+        )
+            : position{ pos }
+            , color{ color }
+            , velocity{ vx, vy, vz, 0.0f }
+        {}
+
+        glm::vec4 position;
+        glm::vec4 color;
+        glm::vec4 velocity;
+    };
+
+    // One point of the particle SSBO (PointCloud::PointFormat::Compact).
+    // Position quantized to 16 bits per axis against the cloud bounds, color as RGBA8.
+    // Must match CompactParticle in particle_shader_compact.vert
+    struct CompactParticleInstance {
+        uint32_t positionXY; // x | y << 16
+        uint32_t positionZ;  // z, upper 16 bits unused
+        uint32_t color;      // RGBA8, unpackUnorm4x8() in the shader
+    };
+
+    // Encodes CompactParticleInstances for one bounding box.
+    // With 16 bits per axis the step is extent / 65535, e.g. 0.08mm for a 5m scan.
+    class PointQuantizer {
+    public:
+        PointQuantizer() = default;
+        PointQuantizer(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+            : m_boundsMin{ boundsMin }
+            , m_scale{ (boundsMax - boundsMin) / 65535.f }
+        {
+            for (int axis = 0; axis < 3; ++axis) {
+                m_inverseScale[axis] = m_scale[axis] > 0.f ? 1.f / m_scale[axis] : 0.f;
+            }
+        }
+
+        CompactParticleInstance encode(const glm::vec4& position, const glm::vec4& color) const {
+            CompactParticleInstance particle;
+            particle.positionXY = quantize(position.x, 0) | (quantize(position.y, 1) << 16);
+            particle.positionZ = quantize(position.z, 2);
+            particle.color = 0;
+            for (int c = 0; c < 4; ++c) {
+                const float v = std::min(std::max(color[c], 0.f), 1.f) * 255.f + 0.5f;
+                particle.color |= static_cast<uint32_t>(v) << (8 * c);
+            }
+            return particle;
+        }
+
+        const glm::vec3& getBoundsMin() const { return m_boundsMin; }
+        // Size of one quantization step per axis, position = boundsMin + q * scale
+        const glm::vec3& getScale() const { return m_scale; }
+
+    private:
+        uint32_t quantize(float value, int axis) const {
+            const float q = (value - m_boundsMin[axis]) * m_inverseScale[axis] + 0.5f;
+            return static_cast<uint32_t>(std::min(std::max(q, 0.f), 65535.f));
+        }
+
+        glm::vec3 m_boundsMin{ 0.f };
+        glm::vec3 m_scale{ 0.f };
+        glm::vec3 m_inverseScale{ 0.f };
+    };
+
+} // namespace AE
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <cassert>
+#include <cstring>
 #include <array>
+#include <algorithm>
 
 #include "../Utils/AREngineIncludes.h"
 #include "ParticleSystem.h"
@@ -9,37 +11,109 @@
 
 namespace AE {
 
-	void ParticleSystem::loadPointCloud() {
+#ifdef POINT_CLOUD_PAGING
+	static PagedPointCloud::Settings getPagingSettings() {
+		PagedPointCloud::Settings settings{};
+		settings.chunkSize = POINT_CLOUD_PAGE_CHUNK_SIZE;
+		settings.poolBytes = static_cast<VkDeviceSize>(POINT_CLOUD_PAGING) * 1024 * 1024;
+		settings.uploadBytesPerFrame = static_cast<VkDeviceSize>(POINT_CLOUD_PAGE_UPLOAD_MB) * 1024 * 1024;
+		return settings;
+	}
+#endif
+
+	void ParticleSystem::loadPointCloud(int pointNum) {
 		const float pMean(0.0f);
 		const float pDeviation(0.3f);
-		std::vector<int> particleNum(POINT_CLOUD_NUM, PARTICLE_NUM);
+		const int cloudParticleNum = pointNum > 0 ? (pointNum + POINT_CLOUD_NUM - 1) / POINT_CLOUD_NUM : PARTICLE_NUM;
+		std::vector<int> particleNum(POINT_CLOUD_NUM, cloudParticleNum);
 
 		m_pointCloud.createVertexBuffers();
 		m_pointCloud.createIndexBuffers();
 		m_pointCloud.createIndirectBuffers(POINT_CLOUD_NUM, particleNum);
 		//m_pointCloud.createParticleModel();
-		m_pointCloud.generatePointCloud(POINT_CLOUD_NUM, PARTICLE_NUM, pMean, pDeviation);
+		m_pointCloud.generatePointCloud(POINT_CLOUD_NUM, cloudParticleNum, pMean, pDeviation);
 		m_pointCloud.createSBOObuffers();
+		m_drawVersion++;
 	}
 
-	void ParticleSystem::setPointCloud(
-		int pointCloudNum,
-		std::vector<int> particleNum,
-		std::vector<std::vector<glm::vec4>> pointCloud_position,
-		std::vector<std::vector<glm::vec4>> pointCloud_color)
-	{
+	void ParticleSystem::setPointCloud(PointCloud::IngestBuffer&& ingest) {
 		m_pointCloud.createVertexBuffers();
 		m_pointCloud.createIndexBuffers();
-		m_pointCloud.createIndirectBuffers(pointCloudNum, particleNum);
-		m_pointCloud.setPointCloud(pointCloud_position, pointCloud_color);
-		m_pointCloud.createSBOObuffers();
+#ifdef POINT_CLOUD_PAGING
+		// The chunks are copied to host memory, so the staging region is released once they are built
+		PointCloud::IngestBuffer released = std::move(ingest);
+		buildPagedPointCloud(released.getData(), released.getParticleCount(), released.getPointFormat(), released.getCompactPushConstants());
+#else
+		m_pointCloud.endIngest(std::move(ingest));
+#endif
+		m_drawVersion++;
+	}
+
+	void ParticleSystem::setPointCloud(std::unique_ptr<PointCloudCache> cache) {
+		const PointCloudCache::Header& header = cache->getHeader();
+		const PointCloud::PointFormat format = static_cast<PointCloud::PointFormat>(header.pointFormat);
+		if (header.pointSize != PointCloud::getPointSize(format)) {
+			throw std::runtime_error("failed to load point cloud cache! Point size does not match the point format");
+		}
+#ifdef POINT_CLOUD_PAGING
+		// Chunked and paged in straight from the mapped file, without a staging region or a host copy of the cloud
+		PointCloud::CompactPushConstantData compactPushConstants{};
+		compactPushConstants.boundsMin = glm::vec4(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2], 0.f);
+		compactPushConstants.boundsScale = glm::vec4(header.boundsScale[0], header.boundsScale[1], header.boundsScale[2], 0.f);
+		m_pointCloud.createVertexBuffers();
+		m_pointCloud.createIndexBuffers();
+		m_pagedPointCloud = std::make_unique<PagedPointCloud>(m_devices, m_pointCloud.getIndexCount(), getPagingSettings());
+		m_pagedPointCloud->build(std::move(cache), format, compactPushConstants);
+		m_drawVersion++;
+		return;
+#endif
+		PointCloud::IngestBuffer ingest = m_pointCloud.beginIngest(header.pointNum, format);
+		// Straight from the mapped file into the mapped staging region
+		memcpy(ingest.getData(), cache->getPointData(), header.pointSize * header.pointNum);
+		ingest.setParticleNum(cache->getParticleNum());
+		ingest.setQuantization(
+			glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+			glm::vec3(header.boundsScale[0], header.boundsScale[1], header.boundsScale[2])
+		);
+		setPointCloud(std::move(ingest));
+	}
+
+	void ParticleSystem::buildPagedPointCloud(
+		const void* points,
+		size_t pointCount,
+		PointCloud::PointFormat pointFormat,
+		const PointCloud::CompactPushConstantData& compactPushConstants
+	) {
+#ifdef POINT_CLOUD_PAGING
+		m_pagedPointCloud = std::make_unique<PagedPointCloud>(m_devices, m_pointCloud.getIndexCount(), getPagingSettings());
+		m_pagedPointCloud->build(points, pointCount, pointFormat, compactPushConstants);
+#endif
+	}
+
+	void ParticleSystem::sortIntoChunks(PointCloud::IngestBuffer& ingest) const {
+#ifdef POINT_CLOUD_PAGING
+		// Reads the staging region back, which may be write-combined, so only before a cache is written
+		const size_t pointCount = ingest.getParticleCount();
+		PagedPointCloud::sortIntoChunks(ingest.getData(), pointCount, ingest.getPointFormat(), ingest.getCompactPushConstants(), getPagingSettings());
+		ingest.setParticleNum({ static_cast<int>(pointCount) });
+#endif
+	}
+
+	Buffer& ParticleSystem::getSBOObuffer(int frameIndex) {
+		return m_pagedPointCloud != nullptr ? m_pagedPointCloud->getPoolBuffer() : m_pointCloud.getSBOObuffer(frameIndex);
+	}
+
+	Buffer& ParticleSystem::getIndirectCommandsBuffer(int frameIndex) {
+		return m_pagedPointCloud != nullptr ? m_pagedPointCloud->getIndirectCommandsBuffer(frameIndex) : m_pointCloud.getIndirectCommandsBuffer(frameIndex);
 	}
 
 	void ParticleSystem::cleanupParticleSystem() {
+		m_pagedPointCloud = nullptr;
 		m_pointCloud.cleanUpPointCloud();
 		vkDestroyPipeline(m_devices.getLogicalDevice(), m_computePipeline->getComputePipeline(), nullptr);
 		vkDestroyPipelineLayout(m_devices.getLogicalDevice(), m_computePipelineLayout, nullptr);
 		vkDestroyPipeline(m_devices.getLogicalDevice(), m_graphicsPipeline->getGraphicsPipeline(), nullptr);
+		vkDestroyPipeline(m_devices.getLogicalDevice(), m_compactGraphicsPipeline->getGraphicsPipeline(), nullptr);
 		vkDestroyPipelineLayout(m_devices.getLogicalDevice(), m_graphicsPipelineLayout, nullptr);
 	}
 
@@ -67,12 +141,18 @@ namespace AE {
 		// index indicates set number
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalDescriptorSetLayout };
 
+		// Quantization bounds of compact point clouds (unused by the full format shader)
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PointCloud::CompactPushConstantData);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(m_devices.getLogicalDevice(), &pipelineLayoutInfo, nullptr, &m_graphicsPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
@@ -92,9 +172,35 @@ namespace AE {
 		pipelineConfig.pipelineLayout = m_graphicsPipelineLayout;
 		m_graphicsPipeline = std::make_unique<GraphicsPipeline>(m_devices, PARTICLE_GRAPHICS_COMPILER_PATH);
 		m_graphicsPipeline->createGraphicsPipeline(PARTICLE_VERT_SHADER_PATH, PARTICLE_FRAG_SHADER_PATH, pipelineConfig);
+		m_compactGraphicsPipeline = std::make_unique<GraphicsPipeline>(m_devices, PARTICLE_COMPACT_GRAPHICS_COMPILER_PATH);
+		m_compactGraphicsPipeline->createGraphicsPipeline(PARTICLE_COMPACT_VERT_SHADER_PATH, PARTICLE_FRAG_SHADER_PATH, pipelineConfig);
+		m_drawVersion++;
+	}
+
+	void ParticleSystem::updatePointCloud(FrameInfo& frameInfo, FrameScheduler& frameScheduler) {
+		if (m_pagedPointCloud != nullptr) {
+			m_pagedPointCloud->update(frameInfo, frameScheduler);
+		}
+	}
+
+	bool ParticleSystem::hasComputePass() const {
+		// Paged clouds are static too
+		return m_pagedPointCloud == nullptr && !m_pointCloud.isStatic();
 	}
 
 	void ParticleSystem::dispatch(FrameInfo& frameInfo) {
+		if (!hasComputePass()) {
+			// Nothing moves: the graphics pass reads the one SSBO and indirect buffer the upload wrote
+			return;
+		}
+		// The input is the output of the previous frame's dispatch
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(frameInfo.m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// Compact clouds are static (see PointCloud::isStatic), only the full layout gets here
 		m_computePipeline->bind(frameInfo.m_commandBuffer);
 		vkCmdBindDescriptorSets(
 			frameInfo.m_commandBuffer,
@@ -103,15 +209,38 @@ namespace AE {
 			0, 
 			2,
 			&frameInfo.m_descriptorSets[0],
-			0, 
-			nullptr
+			static_cast<uint32_t>(frameInfo.m_dynamicOffsets.size()),
+			frameInfo.m_dynamicOffsets.data()
 		);
 		
-		vkCmdDispatch(frameInfo.m_commandBuffer, POINT_CLOUD_NUM * PARTICLE_NUM / 200, 1, 1);
+		// One invocation per point, the shader skips the ones past the end of the last group. maxComputeWorkGroupCount[0]
+		// is only guaranteed to be 65535 (13M points), so bigger clouds are split into rows of y.
+		const uint32_t groupCount = (m_pointCloud.getParticleCount() + 199) / 200;
+		const uint32_t groupCountX = std::min(groupCount, m_devices.getPhysicalDeviceProperties().limits.maxComputeWorkGroupCount[0]);
+		const uint32_t groupCountY = groupCountX > 0 ? (groupCount + groupCountX - 1) / groupCountX : 0;
+		vkCmdDispatch(frameInfo.m_commandBuffer, groupCountX, groupCountY, 1);
+#ifndef ASYNC_COMPUTE
+		// Recorded into the graphics command buffer, the draws of the render pass read what it wrote
+		// (with ASYNC_COMPUTE the graphics submission waits for the compute finished semaphore instead)
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			frameInfo.m_commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr
+		);
+#endif
 	}
 
 	void ParticleSystem::renderPointCloud(FrameInfo& frameInfo) {
-		m_graphicsPipeline->bind(frameInfo.m_commandBuffer);
+		const PointCloud::PointFormat pointFormat = m_pagedPointCloud != nullptr ? m_pagedPointCloud->getPointFormat() : m_pointCloud.getPointFormat();
+		const bool compact = pointFormat == PointCloud::PointFormat::Compact;
+		if (compact) {
+			m_compactGraphicsPipeline->bind(frameInfo.m_commandBuffer);
+		}
+		else {
+			m_graphicsPipeline->bind(frameInfo.m_commandBuffer);
+		}
 
 		// Bind the descriptor set to the pipeline
 		// Since this is called outside the for loop below, 
@@ -126,11 +255,42 @@ namespace AE {
 			   // This is why frequently shared sets should occupy the earlier set numbers.
 			1, // descriptor set count
 			&frameInfo.m_descriptorSets[0],
-			0, // can be used for specifying dynamic offsets
-			nullptr // can be used for specifying dynamic offsets
+			static_cast<uint32_t>(frameInfo.m_dynamicOffsets.size()), // dynamic offsets of the uniform buffers in set 0
+			frameInfo.m_dynamicOffsets.data()
 		);
+		if (compact) {
+			vkCmdPushConstants(
+				frameInfo.m_commandBuffer,
+				m_graphicsPipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				0,
+				sizeof(PointCloud::CompactPushConstantData),
+				m_pagedPointCloud != nullptr ? &m_pagedPointCloud->getCompactPushConstants() : &m_pointCloud.getCompactPushConstants()
+			);
+		}
+		// The particle quad
 		m_pointCloud.bind(frameInfo);
-		m_pointCloud.draw(frameInfo);
+		if (m_pagedPointCloud != nullptr) {
+			m_pagedPointCloud->draw(frameInfo);
+		}
+		else {
+			m_pointCloud.draw(frameInfo);
+		}
+	}
+
+	void ParticleSystem::renderPointCloud(FrameInfo& frameInfo, ParallelCommandRecorder& recorder) {
+		ParallelCommandRecorder::RecordFunction record = [this](FrameInfo& jobFrameInfo, int, int) {
+			renderPointCloud(jobFrameInfo);
+		};
+#ifdef CACHE_POINT_CLOUD_COMMANDS
+		// The draws of a paged cloud depend on the chunks resident this frame. Otherwise they only depend on the frame
+		// index (the SSBO and indirect buffer the compute pass writes), so they are recorded once per frame index.
+		if (m_pagedPointCloud == nullptr) {
+			recorder.addCached(this, m_drawVersion, frameInfo, std::move(record));
+			return;
+		}
+#endif
+		recorder.add(frameInfo, std::move(record));
 	}
 
 } // namespace AE
\ No newline at end of file
@@ -7,12 +7,14 @@
 #include "../Utils/AREngineDefines.h"
 
 #include "PointCloud.h"
+#include "PagedPointCloud.h"
 #include "ComputePipeline.h"
 #include "../Devices.h"
 #include "../GameObject.h"
 #include "../Camera.h"
 #include "../FrameInfo.h"
 #include "../RenderSystem/GraphicsPipeline.h"
+#include "../Renderer/ParallelCommandRecorder.h"
 
 namespace AE {
 
@@ -26,30 +28,55 @@ namespace AE {
 		ParticleSystem(ParticleSystem&&) = delete;
 		ParticleSystem& operator=(ParticleSystem&&) = delete;
 
-		void loadPointCloud();
-		void setPointCloud(
-			int pointCloudNum, 
-			std::vector<int> particleNum,
-			std::vector<std::vector<glm::vec4>> pointCloud_position,
-			std::vector<std::vector<glm::vec4>> pointCloud_color
-		);
+		// Generated gaussian clouds of pointNum points in total (0: the default size)
+		void loadPointCloud(int pointNum = 0);
+		// Takes the points a producer wrote into m_pointCloud.beginIngest() and uploads them
+		void setPointCloud(PointCloud::IngestBuffer&& ingest);
+		// A paged cloud (POINT_CLOUD_PAGING) keeps the file mapped, otherwise it is closed once the points are uploaded
+		void setPointCloud(std::unique_ptr<PointCloudCache> cache);
+		// With POINT_CLOUD_PAGING, puts the points in the chunk order of the paged cloud (merging the clouds into one),
+		// so that a cache written from them is paged straight from the file. Does nothing otherwise.
+		void sortIntoChunks(PointCloud::IngestBuffer& ingest) const;
 		void createComputePipelineLayout(std::vector<VkDescriptorSetLayout> computeDescriptorSetLayouts);
 		void createComputePipeline(VkRenderPass renderPass);
 		void createGraphicsPipelineLayout(VkDescriptorSetLayout globalDescriptorSetLayout);
 		void createGraphicsPipeline(VkRenderPass renderPass);
+		// Pages chunks in for the camera, before the frame is submitted. Nothing to do unless the cloud is paged (POINT_CLOUD_PAGING).
+		void updatePointCloud(FrameInfo& frameInfo, FrameScheduler& frameScheduler);
+		// False when the cloud is static or paged, then there is nothing to dispatch
+		bool hasComputePass() const;
+		// Records the compute pass into frameInfo.m_commandBuffer (Renderer::beginCompute())
 		void dispatch(FrameInfo& frameInfo);
 		void renderPointCloud(FrameInfo& frameInfo);
+		// Queues the draw to the recorder, cached across frames with CACHE_POINT_CLOUD_COMMANDS unless the cloud is paged
+		void renderPointCloud(FrameInfo& frameInfo, ParallelCommandRecorder& recorder);
 		void cleanupParticleSystem();
 
 		PointCloud& getPointCloud() { return m_pointCloud; }
+		// nullptr unless the cloud is paged
+		PagedPointCloud* getPagedPointCloud() { return m_pagedPointCloud.get(); }
+		// The buffers the particle shaders read, from the paged cloud when there is one
+		Buffer& getSBOObuffer(int frameIndex);
+		Buffer& getIndirectCommandsBuffer(int frameIndex);
 
 	private:
+		void buildPagedPointCloud(
+			const void* points,
+			size_t pointCount,
+			PointCloud::PointFormat pointFormat,
+			const PointCloud::CompactPushConstantData& compactPushConstants
+		);
+
 		Devices& m_devices;
 		VkPipelineLayout m_computePipelineLayout;
 		std::unique_ptr<ComputePipeline> m_computePipeline;
 		VkPipelineLayout m_graphicsPipelineLayout;
 		std::unique_ptr<GraphicsPipeline> m_graphicsPipeline;
+		std::unique_ptr<GraphicsPipeline> m_compactGraphicsPipeline;
 		PointCloud m_pointCloud{ m_devices };
+		std::unique_ptr<PagedPointCloud> m_pagedPointCloud;
+		// Bumped whenever what renderPointCloud() records changes (the cloud or the pipelines)
+		uint64_t m_drawVersion = 0;
 	};
 
 } // namespace AE
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include <random>
+#include <algorithm>
+#include <cstring>
 
 #include "../Utils/AREngineDefines.h"
 #include "PointCloud.h"
+#include "../UploadManager.h"
 
 namespace AE {
 
@@ -25,15 +28,118 @@ namespace AE {
         }
     }
 
-    void PointCloud::setPointCloud(
-        std::vector<std::vector<glm::vec4>> pointCloud_position,
-        std::vector<std::vector<glm::vec4>> pointCloud_color)
-    {
-        for (int i = 0; i < pointCloud_position.size(); ++i) {
-            for (int j = 0; j < pointCloud_position[i].size(); ++j) {
-                m_particles.emplace_back(pointCloud_position[i][j], pointCloud_color[i][j]);
+    size_t PointCloud::IngestBuffer::getParticleCount() const {
+        size_t count = 0;
+        for (int num : m_particleNum) {
+            count += static_cast<size_t>(num);
+        }
+        return count;
+    }
+
+    static_assert(static_cast<uint32_t>(PointCloud::PointFormat::Compact) + 1 == PointCloudCache::POINT_FORMAT_COUNT,
+        "PointCloudCache::open() checks the point format against POINT_FORMAT_COUNT");
+
+    void PointCloud::IngestBuffer::writeCache(const std::string& cachePath, uint64_t inputHash) const {
+        const float boundsMin[4] = {
+            m_compactPushConstants.boundsMin.x, m_compactPushConstants.boundsMin.y, m_compactPushConstants.boundsMin.z, 0.f
+        };
+        const float boundsScale[4] = {
+            m_compactPushConstants.boundsScale.x, m_compactPushConstants.boundsScale.y, m_compactPushConstants.boundsScale.z, 0.f
+        };
+        PointCloudCache::write(
+            cachePath,
+            inputHash,
+            static_cast<uint32_t>(m_pointFormat),
+            getPointSize(m_pointFormat),
+            m_particleNum,
+            getData(),
+            boundsMin,
+            boundsScale
+        );
+    }
+
+    PointCloud::IngestBuffer PointCloud::beginIngest(size_t capacity, PointFormat format) {
+        const uint32_t pointSize = getPointSize(format);
+        // A zero sized VkBuffer is not allowed
+        const uint32_t instanceCount = static_cast<uint32_t>(std::max<size_t>(capacity, 1));
+
+        if (m_ingestStaging != nullptr) {
+            // The previous ingest may still be copied from
+            m_devices.getUploadManager().flush();
+        }
+
+        IngestBuffer ingest;
+        ingest.m_pointFormat = format;
+        ingest.m_capacity = capacity;
+        if (m_ingestStaging != nullptr && m_ingestStaging->getBufferSize() >= static_cast<VkDeviceSize>(pointSize) * instanceCount) {
+            ingest.m_staging = std::move(m_ingestStaging);
+        }
+        else {
+            // Release the old region first so that both are never alive at once
+            m_ingestStaging = nullptr;
+            ingest.m_staging = std::make_unique<Buffer>(
+                m_devices,
+                pointSize,
+                instanceCount,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            // Stays mapped until the buffer is destroyed. The memory is coherent, so the producer's writes need no flush.
+            ingest.m_staging->map();
+        }
+        return ingest;
+    }
+
+    void PointCloud::endIngest(IngestBuffer&& ingest) {
+        if (!ingest.isValid()) {
+            throw std::runtime_error("failed to upload point cloud! The ingest buffer was not handed out by beginIngest()");
+        }
+        const size_t particleCount = ingest.getParticleCount();
+        if (particleCount > ingest.getCapacity()) {
+            throw std::runtime_error("failed to upload point cloud! More points than the ingest buffer holds");
+        }
+
+        // The format decides how many SSBOs the budget has to hold
+        m_pointFormat = ingest.m_pointFormat;
+        const uint32_t pointSize = getPointSize(m_pointFormat);
+        const uint32_t stride = getBudgetStride(pointSize, particleCount);
+        size_t keptCount = particleCount;
+        if (stride > 1) {
+            // Thin out every cloud in place. The region is mapped and may be write-combined, which makes this slow,
+            // but it only happens for clouds that would not fit otherwise.
+            char* points = static_cast<char*>(ingest.getData());
+            size_t cloudBegin = 0;
+            keptCount = 0;
+            for (int& num : ingest.m_particleNum) {
+                const size_t cloudCount = static_cast<size_t>(num);
+                size_t kept = 0;
+                for (size_t j = 0; j < cloudCount; j += stride) {
+                    memcpy(points + (keptCount + kept) * pointSize, points + (cloudBegin + j) * pointSize, pointSize);
+                    kept++;
+                }
+                cloudBegin += cloudCount;
+                keptCount += kept;
+                num = static_cast<int>(kept);
             }
+            printf("Point cloud thinned out to every %u. point to fit the device memory budget: %zu -> %zu points\n",
+                stride, particleCount, keptCount);
         }
+
+        m_particles.clear();
+        m_compactPushConstants = ingest.m_compactPushConstants;
+        m_particleCount = static_cast<uint32_t>(keptCount);
+        createIndirectBuffers(static_cast<int>(ingest.m_particleNum.size()), ingest.m_particleNum);
+        const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(pointSize) * m_particleCount;
+        for (Buffer* sbooBuffer : allocateSBOObuffers(pointSize)) {
+            if (bufferSize > 0) {
+                // Straight from the ingest region, which is kept (and not rewritten) until the next beginIngest().
+                // A GPU copy even when the SSBOs are host visible: it runs asynchronously, a memcpy would not.
+                m_devices.getUploadManager().copyBuffer(ingest.m_staging->getBuffer(), sbooBuffer->getBuffer(), bufferSize);
+            }
+        }
+
+        m_ingestStaging = std::move(ingest.m_staging);
+        ingest = IngestBuffer{};
     }
 
     void PointCloud::createParticleModel() {
@@ -57,28 +163,15 @@ namespace AE {
         VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertexCount;
         uint32_t vertexSize = sizeof(m_vertices[0]);
 
-        Buffer stagingBuffer{
-            m_devices,
-            vertexSize,
-            m_vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        // create a region of host(cpu) memory mapped to device memory and set data to point to the beginning of the mapped memory range
-        stagingBuffer.map();
-        // As we specified VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data will automatically be flushed to update device memory after memcpy
-        stagingBuffer.writeToBuffer((void*)m_vertices.data());
-
         m_vertexBuffer = std::make_unique<Buffer>(
             m_devices,
             vertexSize,
             m_vertexCount,
             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            m_devices.getDeviceLocalMemoryProperties()
         );
 
-        m_devices.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+        m_devices.getUploadManager().uploadBuffer(*m_vertexBuffer, m_vertices.data(), bufferSize);
     }
 
     void PointCloud::createIndexBuffers() {
@@ -89,66 +182,89 @@ namespace AE {
         VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
         uint32_t indexSize = sizeof(indices[0]);
 
-        Buffer stagingBuffer{
-            m_devices,
-            indexSize,
-            m_indexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)indices.data());
-
         m_indexBuffer = std::make_unique<Buffer>(
             m_devices,
             indexSize,
             m_indexCount,
             VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            m_devices.getDeviceLocalMemoryProperties()
         );
 
-        m_devices.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+        m_devices.getUploadManager().uploadBuffer(*m_indexBuffer, indices.data(), bufferSize);
     }
 
     void PointCloud::createSBOObuffers() {
+        m_pointFormat = PointFormat::Full;
         m_particleCount = static_cast<uint32_t>(m_particles.size());
 
-        VkDeviceSize bufferSize = sizeof(m_particles[0]) * m_particleCount;
         uint32_t vertexSize = sizeof(m_particles[0]);
-        Buffer stagingBuffer{
-            m_devices,
-            vertexSize,
-            m_particleCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
+        if (getBudgetStride(vertexSize, m_particleCount) > 1) {
+            // The indirect draws of the generated clouds already exist, so there is nothing to thin out here
+            throw std::runtime_error("failed to create point cloud! The generated points exceed the device memory budget, lower PARTICLE_NUM");
+        }
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(vertexSize) * m_particleCount;
+        m_devices.getUploadManager().uploadBuffer(allocateSBOObuffers(vertexSize), m_particles.data(), bufferSize);
+    }
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)m_particles.data());
+    uint32_t PointCloud::getBudgetStride(uint32_t pointSize, size_t particleCount) const {
+        const VkDeviceSize required = static_cast<VkDeviceSize>(pointSize) * particleCount * getFrameBufferCount();
+        // The current SSBOs are released when the new ones are created
+        VkDeviceSize available = m_devices.getMemoryAllocator().getAvailableBytes(m_devices.getDeviceLocalMemoryProperties());
+        for (const std::unique_ptr<Buffer>& sbooBuffer : m_sbooBuffer) {
+            available += sbooBuffer->getBufferSize();
+        }
+        if (required <= available) {
+            return 1;
+        }
+#ifdef POINT_CLOUD_OVER_BUDGET_DOWNSAMPLE
+        const VkDeviceSize minimum = static_cast<VkDeviceSize>(pointSize) * getFrameBufferCount();
+        if (available >= minimum) {
+            return static_cast<uint32_t>(std::min<VkDeviceSize>((required + available - 1) / available, UINT32_MAX));
+        }
+#endif
+        printf("Point cloud needs %.1f MB of SSBOs, %.1f MB left in the device memory budget\n",
+            required / (1024.0 * 1024.0), available / (1024.0 * 1024.0));
+        throw std::runtime_error("failed to upload point cloud! It exceeds the device memory budget");
+    }
+
+    bool PointCloud::isStatic() const {
+        // Compact points have no velocity
+        return !m_simulated || m_pointFormat == PointFormat::Compact;
+    }
 
-        m_sbooBuffer.resize(MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    uint32_t PointCloud::getFrameBufferCount() const {
+        return isStatic() ? 1 : MAX_FRAMES_IN_FLIGHT;
+    }
+
+    std::vector<Buffer*> PointCloud::allocateSBOObuffers(uint32_t pointSize) {
+        const uint32_t bufferCount = getFrameBufferCount();
+        std::vector<Buffer*> buffers(bufferCount);
+        m_sbooBuffer.resize(bufferCount);
+        for (uint32_t i = 0; i < bufferCount; i++) {
             m_sbooBuffer[i] = std::make_unique<Buffer>(
                 m_devices,
-                vertexSize,
-                m_particleCount,
+                pointSize,
+                std::max(m_particleCount, 1u),
                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT 
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                m_devices.getDeviceLocalMemoryProperties()
             );
-
-            m_devices.copyBuffer(stagingBuffer.getBuffer(), m_sbooBuffer[i]->getBuffer(), bufferSize);
+            buffers[i] = m_sbooBuffer[i].get();
         }
+        printf("Point cloud: %u x %.1f MB SSBO (%s)\n", bufferCount,
+            static_cast<double>(pointSize) * m_particleCount / (1024.0 * 1024.0), isStatic() ? "static" : "simulated");
+        return buffers;
     }
 
-    void PointCloud::createIndirectBuffers(int pointCloudNum, std::vector<int> particleNum) {
+    void PointCloud::createIndirectBuffers(int pointCloudNum, const std::vector<int>& particleNum) {
         m_indirectCommands.clear();
 
-        //int instanceNum = POINT_CLOUD_NUM * PARTICLE_NUM;
+        // The clouds are stored back to back in the SSBO, so each draw starts where the previous one ended
+        uint32_t firstInstance = 0;
         for (int i=0; i < pointCloudNum; i++) {
             VkDrawIndexedIndirectCommand indirectCmd{};
             indirectCmd.instanceCount = particleNum[i];
-            indirectCmd.firstInstance = i * particleNum[i];
+            indirectCmd.firstInstance = firstInstance;
+            firstInstance += particleNum[i];
             indirectCmd.firstIndex = 0;
             indirectCmd.indexCount = m_indexCount;
 
@@ -159,28 +275,21 @@ namespace AE {
         VkDeviceSize bufferSize = sizeof(m_indirectCommands[0]) * m_indirectDrawCount;
         uint32_t elementSize = sizeof(m_indirectCommands[0]);
 
-        Buffer stagingBuffer{
-            m_devices,
-            elementSize,
-            m_indirectDrawCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)m_indirectCommands.data());
-
-        m_indirectCommandsBuffer.resize(MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        // Only the compute shader writes the draws, so static clouds need just one copy
+        const uint32_t bufferCount = getFrameBufferCount();
+        std::vector<Buffer*> buffers(bufferCount);
+        m_indirectCommandsBuffer.resize(bufferCount);
+        for (uint32_t i = 0; i < bufferCount; i++) {
             m_indirectCommandsBuffer[i] = std::make_unique<Buffer>(
                 m_devices,
                 elementSize,
                 m_indirectDrawCount,
                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                m_devices.getDeviceLocalMemoryProperties()
             );
-            m_devices.copyBuffer(stagingBuffer.getBuffer(), m_indirectCommandsBuffer[i]->getBuffer(), bufferSize);
+            buffers[i] = m_indirectCommandsBuffer[i].get();
         }
+        m_devices.getUploadManager().uploadBuffer(buffers, m_indirectCommands.data(), bufferSize);
     }
 
     // Record to command buffer to bind one vertex buffer starting at binding zero
@@ -201,7 +310,7 @@ namespace AE {
         if (m_devices.getDeviceFeatures().multiDrawIndirect) {
             vkCmdDrawIndexedIndirect(
                 frameInfo.m_commandBuffer,
-                m_indirectCommandsBuffer[frameInfo.m_frameIndex]->getBuffer(),
+                getIndirectCommandsBuffer(frameInfo.m_frameIndex).getBuffer(),
                 0,
                 m_indirectDrawCount,
                 sizeof(VkDrawIndexedIndirectCommand)
@@ -213,7 +322,7 @@ namespace AE {
             {
                 vkCmdDrawIndexedIndirect(
                     frameInfo.m_commandBuffer,
-                    m_indirectCommandsBuffer[frameInfo.m_frameIndex]->getBuffer(),
+                    getIndirectCommandsBuffer(frameInfo.m_frameIndex).getBuffer(),
                     j * sizeof(VkDrawIndexedIndirectCommand),
                     1,
                     sizeof(VkDrawIndexedIndirectCommand)
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cassert>
+
 #include "../Utils/AREngineIncludes.h"
 #include "../Devices.h"
 #include "../Buffer.h"
 #include "../Model.h"
 #include "../FrameInfo.h"
+#include "ParticleInstance.h"
+#include "../3Dvision/RGBD/PointCloudCache.h"
 
 #define INSTANCING_INDIRECT_DRAW
 
@@ -12,6 +16,12 @@ namespace AE {
 
     class PointCloud {
     public:
+        // Layout of the particle SSBO. Picked per cloud in beginIngest().
+        enum class PointFormat {
+            Full,   // ParticleInstance, 48 bytes per point
+            Compact // CompactParticleInstance, 12 bytes per point, static points only (no velocity)
+        };
+
         struct ParticleVertex {
             ParticleVertex() {};
             ParticleVertex(float px, float py, float pz) : position{ px, py, pz } {}
@@ -22,34 +32,64 @@ namespace AE {
             glm::vec3 position;
         };
 
-        struct ParticleInstance {
-            ParticleInstance() {};
-            ParticleInstance(
-                float px, float py, float pz,
-                float cx = 1.f, float cy = 1.f, float cz = 1.f, float ca = 1.0f,
-                float vx = 0.f, float vy = 0.f, float vz = 1.f
-            )
-                : position{ px, py, pz, 1.0f }
-                , color{ cx, cy, cz, ca }
-                , velocity{ vx, vy, vz, 0.0f }
-            {}
-
-            ParticleInstance(
-                glm::vec4 pos, 
-                glm::vec4 color,
-                float vx = 0.f, float vy = 0.f, float vz = 1.f
-            )
-                : position{ pos }
-                , color{ color }
-                , velocity{ vx, vy, vz, 0.0f }
-            {}
-
-            // static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-            // static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
-            glm::vec4 position;
-            glm::vec4 color;
-            glm::vec4 velocity;
+        // Point layouts, see ParticleInstance.h
+        using ParticleInstance = AE::ParticleInstance;
+        using CompactParticleInstance = AE::CompactParticleInstance;
+
+        // must match the push constant block of particle_shader_compact.vert
+        struct CompactPushConstantData {
+            glm::vec4 boundsMin{ 0.f };   // w unused
+            glm::vec4 boundsScale{ 0.f }; // (max - min) / 65535, w unused
+        };
+
+        // Persistently mapped staging region handed out by beginIngest(). The producer writes its points
+        // in the SSBO layout straight into it and gives it back with endIngest(), which uploads it without another CPU copy.
+        // Move-only: whoever holds it owns the staging memory.
+        class IngestBuffer {
+        public:
+            IngestBuffer() = default;
+            IngestBuffer(IngestBuffer&&) = default;
+            IngestBuffer& operator=(IngestBuffer&&) = default;
+            IngestBuffer(const IngestBuffer&) = delete;
+            IngestBuffer& operator=(const IngestBuffer&) = delete;
+
+            bool isValid() const { return m_staging != nullptr; }
+            PointFormat getPointFormat() const { return m_pointFormat; }
+            // Points that fit into the region
+            size_t getCapacity() const { return m_capacity; }
+            void* getData() const { return m_staging ? m_staging->getMappedMemory() : nullptr; }
+            ParticleInstance* getParticles() const {
+                assert(m_pointFormat == PointFormat::Full && "Ingest buffer does not hold full format points");
+                return static_cast<ParticleInstance*>(getData());
+            }
+            CompactParticleInstance* getCompactParticles() const {
+                assert(m_pointFormat == PointFormat::Compact && "Ingest buffer does not hold compact points");
+                return static_cast<CompactParticleInstance*>(getData());
+            }
+
+            // Points per cloud (one indirect draw each), stored back to back. The sum must not exceed the capacity.
+            void setParticleNum(std::vector<int> particleNum) { m_particleNum = std::move(particleNum); }
+            const std::vector<int>& getParticleNum() const { return m_particleNum; }
+            const CompactPushConstantData& getCompactPushConstants() const { return m_compactPushConstants; }
+            size_t getParticleCount() const;
+            // Bounds the compact points were encoded with
+            void setQuantizer(const PointQuantizer& quantizer) { setQuantization(quantizer.getBoundsMin(), quantizer.getScale()); }
+            void setQuantization(const glm::vec3& boundsMin, const glm::vec3& scale) {
+                m_compactPushConstants.boundsMin = glm::vec4(boundsMin, 0.f);
+                m_compactPushConstants.boundsScale = glm::vec4(scale, 0.f);
+            }
+            // Stores the region as a .aepc cache file. Reads back the mapped memory, which may be write-combined (slow to read),
+            // so only call it when the cache actually has to be rebuilt.
+            void writeCache(const std::string& cachePath, uint64_t inputHash) const;
+
+        private:
+            friend class PointCloud;
+
+            std::unique_ptr<Buffer> m_staging;
+            PointFormat m_pointFormat = PointFormat::Full;
+            size_t m_capacity = 0;
+            std::vector<int> m_particleNum;
+            CompactPushConstantData m_compactPushConstants{};
         };
 
         PointCloud(Devices& devices) : m_devices{ devices } {};
@@ -57,6 +97,7 @@ namespace AE {
             m_indirectCommands.clear();
             m_sbooBuffer.clear();
             m_particles.clear();
+            m_ingestStaging = nullptr;
             m_particleModel = nullptr;
             m_vertexBuffer = nullptr;
             m_indexBuffer = nullptr;
@@ -67,22 +108,45 @@ namespace AE {
         PointCloud& operator=(const PointCloud& pointCloud) = delete;
 
         void generatePointCloud(int pointCloudNum, int particleNum, float mean, float deviation);
-        void setPointCloud(
-            std::vector<std::vector<glm::vec4>> pointCloud_position,
-            std::vector<std::vector<glm::vec4>> pointCloud_color
-        );
+        // Hands out a mapped staging region for capacity points. The region of the previous ingest is reused when it is big enough.
+        IngestBuffer beginIngest(size_t capacity, PointFormat format);
+        // Uploads the points of the region to the SSBOs and creates one indirect draw per cloud.
+        // Keeps the region mapped for the next beginIngest().
+        void endIngest(IngestBuffer&& ingest);
         void createVertexBuffers();
         void createIndexBuffers();
         void createParticleModel();
         void createSBOObuffers();
-        void createIndirectBuffers(int pointCloudNum, std::vector<int> particleNum);
+        void createIndirectBuffers(int pointCloudNum, const std::vector<int>& particleNum);
         void bind(FrameInfo& frameInfo);
         void draw(FrameInfo& frameInfo);
 
-        std::vector<std::unique_ptr<Buffer>>& getSBOObuffers() { return m_sbooBuffer; };
-        std::vector<std::unique_ptr<Buffer>>& getIndirectCommandsBuffers() { return m_indirectCommandsBuffer; };
+        // Static clouds have one buffer for all frames, simulated ones one per frame in flight
+        Buffer& getSBOObuffer(int frameIndex) { return *m_sbooBuffer[frameIndex % m_sbooBuffer.size()]; }
+        Buffer& getIndirectCommandsBuffer(int frameIndex) { return *m_indirectCommandsBuffer[frameIndex % m_indirectCommandsBuffer.size()]; }
+        // Static clouds are never written by the compute shader, see SIMULATE_POINT_CLOUD
+        bool isStatic() const;
+        // Before the SSBOs are created, overrides SIMULATE_POINT_CLOUD
+        void setSimulated(bool simulated) { m_simulated = simulated; }
+        PointFormat getPointFormat() const { return m_pointFormat; }
+        const CompactPushConstantData& getCompactPushConstants() const { return m_compactPushConstants; }
+        uint32_t getParticleCount() const { return m_particleCount; }
+        // Of the particle quad bound by bind()
+        uint32_t getIndexCount() const { return m_indexCount; }
+        static uint32_t getPointSize(PointFormat format) {
+            return format == PointFormat::Compact ? sizeof(CompactParticleInstance) : sizeof(ParticleInstance);
+        }
 
     private:
+        // Creates the SSBOs for m_particleCount points of pointSize bytes
+        std::vector<Buffer*> allocateSBOObuffers(uint32_t pointSize);
+        // 1 for static clouds, MAX_FRAMES_IN_FLIGHT otherwise
+        uint32_t getFrameBufferCount() const;
+        // 1 when the SSBOs of particleCount points fit into the device memory budget, otherwise the n of
+        // "keep every n-th point" that makes them fit. Throws when even that is impossible, or when
+        // POINT_CLOUD_OVER_BUDGET_DOWNSAMPLE is off.
+        uint32_t getBudgetStride(uint32_t pointSize, size_t particleCount) const;
+
         Devices& m_devices;
         std::vector<std::unique_ptr<Buffer>> m_sbooBuffer;
         std::unique_ptr<Buffer> m_vertexBuffer;
@@ -95,7 +159,15 @@ namespace AE {
         std::vector<ParticleVertex> m_vertices;
         uint32_t m_vertexCount;
         std::vector<ParticleInstance> m_particles;
-        uint32_t m_particleCount;
+        std::unique_ptr<Buffer> m_ingestStaging;
+        PointFormat m_pointFormat = PointFormat::Full;
+        CompactPushConstantData m_compactPushConstants{};
+        uint32_t m_particleCount = 0;
+#ifdef SIMULATE_POINT_CLOUD
+        bool m_simulated = true;
+#else
+        bool m_simulated = false;
+#endif
         std::unique_ptr<Model> m_particleModel;
     };
 
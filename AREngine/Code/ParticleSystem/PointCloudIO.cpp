@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "PointCloudIO.h"
+
+namespace AE {
+
+	namespace {
+
+		// Records decoded per chunk. 64K points of a typical 15-30 byte PLY record keeps a chunk at a few MB.
+		constexpr size_t CHUNK_POINT_NUM = 1 << 16;
+		constexpr int DECODE_GRAIN = 4096;
+
+		template <typename T>
+		inline T load(const char* src) {
+			T value;
+			memcpy(&value, src, sizeof(T));
+			return value;
+		}
+
+		std::string toLower(std::string text) {
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return text;
+		}
+
+		uint8_t toByte(float value) {
+			return static_cast<uint8_t>(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+		}
+
+	} // namespace
+
+	PointCloudIO::FileFormat PointCloudIO::getFileFormat(const std::string& path) {
+		size_t dot = path.rfind('.');
+		std::string extension = dot == std::string::npos ? "" : toLower(path.substr(dot));
+		if (extension == ".ply") {
+			return FileFormat::PLY;
+		}
+		if (extension == ".pcd") {
+			return FileFormat::PCD;
+		}
+		throw std::runtime_error("failed to detect the point cloud format of " + path + "! Expected .ply or .pcd");
+	}
+
+	PointCloudIO::RecordLayout PointCloudIO::parsePLYHeader(std::istream& file, const std::string& path) {
+		RecordLayout layout{};
+		std::string line;
+		if (!std::getline(file, line) || line.compare(0, 3, "ply") != 0) {
+			throw std::runtime_error("failed to read " + path + "! Not a PLY file");
+		}
+
+		bool inVertexElement = false;
+		bool vertexElementDone = false;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			std::istringstream lineStream(line);
+			std::string keyword;
+			lineStream >> keyword;
+			if (keyword == "end_header") {
+				break;
+			}
+			if (keyword == "format") {
+				std::string format;
+				lineStream >> format;
+				if (format != "binary_little_endian") {
+					throw std::runtime_error("failed to read " + path + "! Only binary_little_endian PLY files are supported");
+				}
+			}
+			else if (keyword == "element") {
+				std::string name;
+				size_t count = 0;
+				lineStream >> name >> count;
+				if (inVertexElement) {
+					vertexElementDone = true;
+				}
+				inVertexElement = name == "vertex";
+				if (inVertexElement) {
+					if (vertexElementDone || layout.stride != 0) {
+						throw std::runtime_error("failed to read " + path + "! The vertex element must be the first element");
+					}
+					layout.pointNum = count;
+				}
+				else if (!vertexElementDone && count != 0) {
+					throw std::runtime_error("failed to read " + path + "! The vertex element must be the first element");
+				}
+			}
+			else if (keyword == "property" && inVertexElement) {
+				std::string typeName, name;
+				lineStream >> typeName;
+				if (typeName == "list") {
+					throw std::runtime_error("failed to read " + path + "! List properties on vertices are not supported");
+				}
+				lineStream >> name;
+
+				ValueType type;
+				size_t size;
+				if (typeName == "char" || typeName == "int8") { type = ValueType::Int8; size = 1; }
+				else if (typeName == "uchar" || typeName == "uint8") { type = ValueType::UInt8; size = 1; }
+				else if (typeName == "short" || typeName == "int16") { type = ValueType::Int16; size = 2; }
+				else if (typeName == "ushort" || typeName == "uint16") { type = ValueType::UInt16; size = 2; }
+				else if (typeName == "int" || typeName == "int32") { type = ValueType::Int32; size = 4; }
+				else if (typeName == "uint" || typeName == "uint32") { type = ValueType::UInt32; size = 4; }
+				else if (typeName == "float" || typeName == "float32") { type = ValueType::Float32; size = 4; }
+				else if (typeName == "double" || typeName == "float64") { type = ValueType::Float64; size = 8; }
+				else {
+					throw std::runtime_error("failed to read " + path + "! Unknown PLY property type " + typeName);
+				}
+
+				Field field{ static_cast<int>(layout.stride), type };
+				if (name == "x") layout.position[0] = field;
+				else if (name == "y") layout.position[1] = field;
+				else if (name == "z") layout.position[2] = field;
+				else if (name == "red" || name == "r") layout.color[0] = field;
+				else if (name == "green" || name == "g") layout.color[1] = field;
+				else if (name == "blue" || name == "b") layout.color[2] = field;
+				else if (name == "alpha" || name == "a") layout.color[3] = field;
+				layout.stride += size;
+			}
+		}
+		if (!file) {
+			throw std::runtime_error("failed to read " + path + "! Missing end_header");
+		}
+		for (const Field& field : layout.position) {
+			if (field.offset < 0) {
+				throw std::runtime_error("failed to read " + path + "! The vertices have no x, y, z");
+			}
+		}
+		layout.dataOffset = static_cast<size_t>(file.tellg());
+		return layout;
+	}
+
+	PointCloudIO::RecordLayout PointCloudIO::parsePCDHeader(std::istream& file, const std::string& path) {
+		RecordLayout layout{};
+		std::vector<std::string> fields;
+		std::vector<size_t> sizes;
+		std::vector<char> types;
+		std::vector<size_t> counts;
+
+		std::string line;
+		bool hasData = false;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+			std::istringstream lineStream(line);
+			std::string keyword;
+			lineStream >> keyword;
+			if (keyword == "FIELDS") {
+				std::string name;
+				while (lineStream >> name) fields.push_back(name);
+			}
+			else if (keyword == "SIZE") {
+				size_t size;
+				while (lineStream >> size) sizes.push_back(size);
+			}
+			else if (keyword == "TYPE") {
+				char type;
+				while (lineStream >> type) types.push_back(type);
+			}
+			else if (keyword == "COUNT") {
+				size_t count;
+				while (lineStream >> count) counts.push_back(count);
+			}
+			else if (keyword == "POINTS") {
+				lineStream >> layout.pointNum;
+			}
+			else if (keyword == "DATA") {
+				std::string format;
+				lineStream >> format;
+				if (format != "binary") {
+					throw std::runtime_error("failed to read " + path + "! Only DATA binary PCD files are supported");
+				}
+				hasData = true;
+				break;
+			}
+		}
+		if (!hasData) {
+			throw std::runtime_error("failed to read " + path + "! Missing DATA line");
+		}
+		if (counts.empty()) {
+			counts.assign(fields.size(), 1);
+		}
+		if (sizes.size() != fields.size() || types.size() != fields.size() || counts.size() != fields.size()) {
+			throw std::runtime_error("failed to read " + path + "! FIELDS, SIZE, TYPE and COUNT do not match");
+		}
+
+		for (size_t i = 0; i < fields.size(); i++) {
+			ValueType type;
+			switch (types[i]) {
+			case 'F': type = sizes[i] == 8 ? ValueType::Float64 : ValueType::Float32; break;
+			case 'U': type = sizes[i] == 1 ? ValueType::UInt8 : sizes[i] == 2 ? ValueType::UInt16 : ValueType::UInt32; break;
+			case 'I': type = sizes[i] == 1 ? ValueType::Int8 : sizes[i] == 2 ? ValueType::Int16 : ValueType::Int32; break;
+			default: throw std::runtime_error("failed to read " + path + "! Unknown PCD field type");
+			}
+
+			Field field{ static_cast<int>(layout.stride), type };
+			if (fields[i] == "x") layout.position[0] = field;
+			else if (fields[i] == "y") layout.position[1] = field;
+			else if (fields[i] == "z") layout.position[2] = field;
+			else if ((fields[i] == "rgb" || fields[i] == "rgba") && sizes[i] == 4) {
+				layout.packedColor = field;
+				layout.packedAlpha = fields[i] == "rgba";
+			}
+			layout.stride += sizes[i] * counts[i];
+		}
+		for (const Field& field : layout.position) {
+			if (field.offset < 0 || (field.type != ValueType::Float32 && field.type != ValueType::Float64)) {
+				throw std::runtime_error("failed to read " + path + "! The points have no floating point x, y, z");
+			}
+		}
+		layout.dataOffset = static_cast<size_t>(file.tellg());
+		return layout;
+	}
+
+	void PointCloudIO::decodeRecords(const RecordLayout& layout, const char* records, size_t recordNum, ParticleInstance* particles) {
+		// Positions are read as is, integer colors are normalized to [0, 1]
+		auto readValue = [](const char* src, ValueType type, bool normalize) -> float {
+			switch (type) {
+			case ValueType::Int8: return normalize ? load<int8_t>(src) / 127.f : load<int8_t>(src);
+			case ValueType::UInt8: return normalize ? load<uint8_t>(src) / 255.f : load<uint8_t>(src);
+			case ValueType::Int16: return normalize ? load<int16_t>(src) / 32767.f : load<int16_t>(src);
+			case ValueType::UInt16: return normalize ? load<uint16_t>(src) / 65535.f : load<uint16_t>(src);
+			case ValueType::Int32: return static_cast<float>(load<int32_t>(src));
+			case ValueType::UInt32: return static_cast<float>(load<uint32_t>(src));
+			case ValueType::Float32: return load<float>(src);
+			case ValueType::Float64: return static_cast<float>(load<double>(src));
+			}
+			return 0.f;
+		};
+
+		for (size_t i = 0; i < recordNum; i++) {
+			const char* record = records + i * layout.stride;
+			ParticleInstance& particle = particles[i];
+			particle.position = glm::vec4(
+				readValue(record + layout.position[0].offset, layout.position[0].type, false),
+				readValue(record + layout.position[1].offset, layout.position[1].type, false),
+				readValue(record + layout.position[2].offset, layout.position[2].type, false),
+				1.f
+			);
+			particle.color = glm::vec4(1.f);
+			if (layout.packedColor.offset >= 0) {
+				// PCL packs 0xAARRGGBB into the 4 bytes of the field
+				const uint32_t packed = load<uint32_t>(record + layout.packedColor.offset);
+				particle.color = glm::vec4(
+					((packed >> 16) & 0xFF) / 255.f,
+					((packed >> 8) & 0xFF) / 255.f,
+					(packed & 0xFF) / 255.f,
+					layout.packedAlpha ? (packed >> 24) / 255.f : 1.f
+				);
+			}
+			else {
+				for (int c = 0; c < 4; c++) {
+					if (layout.color[c].offset >= 0) {
+						particle.color[c] = readValue(record + layout.color[c].offset, layout.color[c].type, true);
+					}
+				}
+			}
+			particle.velocity = glm::vec4(0.f, 0.f, 1.f, 0.f);
+		}
+	}
+
+	size_t PointCloudIO::read(const std::string& path, std::vector<ParticleInstance>& particles) {
+		return read(path, [&particles](size_t pointNum) {
+			particles.clear();
+			particles.resize(pointNum);
+			return particles.data();
+		});
+	}
+
+	size_t PointCloudIO::read(const std::string& path, const std::function<ParticleInstance*(size_t)>& allocate) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+		const FileFormat format = getFileFormat(path);
+		const RecordLayout layout = format == FileFormat::PLY ? parsePLYHeader(file, path) : parsePCDHeader(file, path);
+
+		ParticleInstance* particles = allocate(layout.pointNum);
+
+		// The next chunk is read by the pool while it decodes the current one
+		std::vector<char> chunks[2];
+		chunks[0].resize(std::min(layout.pointNum, CHUNK_POINT_NUM) * layout.stride);
+		chunks[1].resize(chunks[0].size());
+		auto readChunk = [&](std::vector<char>& chunk, size_t recordNum) {
+			file.read(chunk.data(), static_cast<std::streamsize>(recordNum * layout.stride));
+			if (static_cast<size_t>(file.gcount()) != recordNum * layout.stride) {
+				throw std::runtime_error("failed to read " + path + "! The file is shorter than its header says");
+			}
+		};
+
+		size_t firstRecord = 0;
+		size_t recordNum = std::min(layout.pointNum, CHUNK_POINT_NUM);
+		readChunk(chunks[0], recordNum);
+		for (int current = 0; recordNum > 0; current ^= 1) {
+			const size_t nextFirstRecord = firstRecord + recordNum;
+			const size_t nextRecordNum = std::min(layout.pointNum - nextFirstRecord, CHUNK_POINT_NUM);
+
+			const char* records = chunks[current].data();
+			ParticleInstance* dst = particles + firstRecord;
+			// Task 0 reads the next chunk (claimed first, so it starts right away), the others decode DECODE_GRAIN records each.
+			// parallelFor waits for all of them and rethrows a read error, so no thread outlives a throw.
+			const int decodeTaskNum = static_cast<int>((recordNum + DECODE_GRAIN - 1) / DECODE_GRAIN);
+			const int next = current ^ 1;
+			m_threadPool.parallelFor(nextRecordNum > 0 ? 0 : 1, decodeTaskNum + 1, 1, [&](int task, int) {
+				if (task == 0) {
+					readChunk(chunks[next], nextRecordNum);
+					return;
+				}
+				const size_t begin = static_cast<size_t>(task - 1) * DECODE_GRAIN;
+				const size_t end = std::min(recordNum, begin + DECODE_GRAIN);
+				decodeRecords(layout, records + begin * layout.stride, end - begin, dst + begin);
+			});
+
+			firstRecord = nextFirstRecord;
+			recordNum = nextRecordNum;
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		m_lastStats.pointNum = layout.pointNum;
+		m_lastStats.fileBytes = layout.dataOffset + layout.pointNum * layout.stride;
+		m_lastStats.ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		m_lastStats.megaBytesPerSecond = m_lastStats.ms > 0.0 ? m_lastStats.fileBytes / (1024.0 * 1024.0) / (m_lastStats.ms / 1000.0) : 0.0;
+		return layout.pointNum;
+	}
+
+	size_t PointCloudIO::write(const std::string& path, const ParticleInstance* particles, size_t particleNum) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		const FileFormat format = getFileFormat(path);
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+
+		std::string header;
+		if (format == FileFormat::PLY) {
+			header =
+				"ply\n"
+				"format binary_little_endian 1.0\n"
+				"comment AR Engine point cloud\n"
+				"element vertex " + std::to_string(particleNum) + "\n"
+				"property float x\n"
+				"property float y\n"
+				"property float z\n"
+				"property uchar red\n"
+				"property uchar green\n"
+				"property uchar blue\n"
+				"property uchar alpha\n"
+				"end_header\n";
+		}
+		else {
+			header =
+				"# .PCD v0.7 - AR Engine point cloud\n"
+				"VERSION 0.7\n"
+				"FIELDS x y z rgba\n"
+				"SIZE 4 4 4 4\n"
+				"TYPE F F F U\n"
+				"COUNT 1 1 1 1\n"
+				"WIDTH " + std::to_string(particleNum) + "\n"
+				"HEIGHT 1\n"
+				"VIEWPOINT 0 0 0 1 0 0 0\n"
+				"POINTS " + std::to_string(particleNum) + "\n"
+				"DATA binary\n";
+		}
+		file.write(header.data(), header.size());
+
+		// Both formats use 16 byte records: 3 floats + 4 color bytes (PLY: r, g, b, a / PCD: 0xAARRGGBB)
+		const size_t recordSize = 3 * sizeof(float) + 4;
+		std::vector<char> chunk(std::min(particleNum, CHUNK_POINT_NUM) * recordSize);
+		for (size_t first = 0; first < particleNum; first += CHUNK_POINT_NUM) {
+			const size_t recordNum = std::min(particleNum - first, CHUNK_POINT_NUM);
+			m_threadPool.parallelFor(0, static_cast<int>(recordNum), DECODE_GRAIN, [&](int begin, int end) {
+				char* dst = chunk.data() + begin * recordSize;
+				for (int i = begin; i < end; i++) {
+					const ParticleInstance& particle = particles[first + i];
+					memcpy(dst, &particle.position, 3 * sizeof(float));
+					const uint8_t r = toByte(particle.color.x);
+					const uint8_t g = toByte(particle.color.y);
+					const uint8_t b = toByte(particle.color.z);
+					const uint8_t a = toByte(particle.color.w);
+					if (format == FileFormat::PLY) {
+						const uint8_t rgba[4] = { r, g, b, a };
+						memcpy(dst + 3 * sizeof(float), rgba, 4);
+					}
+					else {
+						const uint32_t packed = (uint32_t(a) << 24) | (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+						memcpy(dst + 3 * sizeof(float), &packed, 4);
+					}
+					dst += recordSize;
+				}
+			});
+			file.write(chunk.data(), static_cast<std::streamsize>(recordNum * recordSize));
+		}
+		if (!file) {
+			throw std::runtime_error("failed to write " + path + "!");
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const size_t bytesWritten = header.size() + particleNum * recordSize;
+		m_lastStats.pointNum = particleNum;
+		m_lastStats.fileBytes = bytesWritten;
+		m_lastStats.ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		m_lastStats.megaBytesPerSecond = m_lastStats.ms > 0.0 ? bytesWritten / (1024.0 * 1024.0) / (m_lastStats.ms / 1000.0) : 0.0;
+		return bytesWritten;
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../Utils/ThreadPool.h"
+#include "ParticleInstance.h"
+
+namespace AE {
+
+	// Binary PLY (binary_little_endian) and PCD (DATA binary) point cloud files <-> ParticleInstance arrays.
+	// The file body is read in chunks and every chunk is decoded in parallel straight into the output array,
+	// writing packs chunks in parallel the same way. The file format is picked from the extension (.ply / .pcd).
+	//
+	// Readers take x, y, z (float or double) and, when present, red/green/blue/alpha (PLY: uchar, ushort or float)
+	// or rgb/rgba (PCD: packed into one 4 byte field). Other properties are skipped, missing colors become white.
+	class PointCloudIO {
+	public:
+		enum class FileFormat {
+			PLY,
+			PCD
+		};
+
+		struct Stats {
+			size_t pointNum = 0;
+			size_t fileBytes = 0;
+			double ms = 0.0;
+			double megaBytesPerSecond = 0.0;
+		};
+
+		PointCloudIO(ThreadPool& threadPool) : m_threadPool{ threadPool } {}
+
+		// Not copyable or movable
+		PointCloudIO(const PointCloudIO&) = delete;
+		PointCloudIO& operator=(const PointCloudIO&) = delete;
+		PointCloudIO(PointCloudIO&&) = delete;
+		PointCloudIO& operator=(PointCloudIO&&) = delete;
+
+		// Once the header is parsed, allocate(pointNum) is asked for the destination and the points are decoded straight into it
+		// (e.g. a PointCloud::IngestBuffer). Returns the number of points read.
+		size_t read(const std::string& path, const std::function<ParticleInstance*(size_t)>& allocate);
+		// Replaces the contents of particles
+		size_t read(const std::string& path, std::vector<ParticleInstance>& particles);
+		// PLY: float x, y, z + uchar red, green, blue, alpha. PCD: FIELDS x y z rgba. Returns the number of bytes written.
+		size_t write(const std::string& path, const ParticleInstance* particles, size_t particleNum);
+
+		static FileFormat getFileFormat(const std::string& path);
+		const Stats& getLastStats() const { return m_lastStats; }
+
+	private:
+		// Where one attribute lives inside a point record
+		enum class ValueType {
+			Int8,
+			UInt8,
+			Int16,
+			UInt16,
+			Int32,
+			UInt32,
+			Float32,
+			Float64
+		};
+		struct Field {
+			int offset = -1; // -1: not in the file
+			ValueType type = ValueType::Float32;
+		};
+		struct RecordLayout {
+			size_t pointNum = 0;
+			size_t stride = 0;
+			size_t dataOffset = 0; // start of the binary body in the file
+			Field position[3];
+			Field color[4];        // PLY red, green, blue, alpha
+			Field packedColor;     // PCD rgb / rgba
+			bool packedAlpha = false;
+		};
+
+		static RecordLayout parsePLYHeader(std::istream& file, const std::string& path);
+		static RecordLayout parsePCDHeader(std::istream& file, const std::string& path);
+		static void decodeRecords(const RecordLayout& layout, const char* records, size_t recordNum, ParticleInstance* particles);
+
+		ThreadPool& m_threadPool;
+		Stats m_lastStats{};
+	};
+
+} // namespace AE
\ No newline at end of file
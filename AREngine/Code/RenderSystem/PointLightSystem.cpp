@@ -108,8 +108,8 @@ namespace AE {
 			   // This is why frequently shared sets should occupy the earlier set numbers.
 			1, // descriptor set count
 			&frameInfo.m_descriptorSets[0],
-			0, // can be used for specifying dynamic offsets
-			nullptr // can be used for specifying dynamic offsets
+			static_cast<uint32_t>(frameInfo.m_dynamicOffsets.size()), // dynamic offsets of the uniform buffers in set 0
+			frameInfo.m_dynamicOffsets.data()
 		);
 
 		// iterate through sorted lights in reverse order
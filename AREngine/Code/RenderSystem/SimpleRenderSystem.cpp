@@ -84,69 +84,76 @@ namespace AE {
 		m_graphicsPipelineWithTexture->createGraphicsPipeline(SIMPLE_VERT_TEX_SHADER_PATH, SIMPLE_FRAG_TEX_SHADER_PATH, pipelineConfig);
 	}
 
-	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-		m_graphicsPipeline->bind(frameInfo.m_commandBuffer);
-
-		// Bind the descriptor set to the pipeline
-		// Since this is called outside the for loop below, 
-		// all game objects can refer to the global UBO struct values without rebinding
-		vkCmdBindDescriptorSets(
-			frameInfo.m_commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			m_pipelineLayout,
-			0, // first set number. 
-			   // If we want to bind a new set and it can be added to the end,
-			   // existing sets would not be rebinded by setting the last index here. 
-			   // This is why frequently shared sets should occupy the earlier set numbers.
-			1, // descriptor set count
-			&frameInfo.m_descriptorSets[0],
-			0, // can be used for specifying dynamic offsets
-			nullptr // can be used for specifying dynamic offsets
-		);
-
-		for (auto& kv : frameInfo.m_gameObjects) {
+	void SimpleRenderSystem::collectGameObjects(GameObject::Map& gameObjects, std::vector<GameObject*>& objects, std::vector<GameObject*>& texturedObjects) {
+		for (auto& kv : gameObjects) {
 			GameObject& obj = kv.second;
-			if (obj.m_model == nullptr || obj.m_model->m_texture != nullptr) {
+			if (obj.m_model == nullptr) {
 				continue;
 			}
+			if (obj.m_model->m_texture == nullptr) {
+				objects.push_back(&obj);
+			}
+			else {
+				texturedObjects.push_back(&obj);
+			}
+		}
+	}
 
-			SimplePushConstantData push{};
-			push.modelMatrix = obj.m_transformMat.mat4();
-			push.normalMatrix = obj.m_transformMat.normalMatrix();
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+		std::vector<GameObject*> objects;
+		std::vector<GameObject*> texturedObjects;
+		collectGameObjects(frameInfo.m_gameObjects, objects, texturedObjects);
+		recordGameObjects(frameInfo, objects.data(), objects.size(), false);
+		// Render Game Objects which have texture
+		recordGameObjects(frameInfo, texturedObjects.data(), texturedObjects.size(), true);
+	}
 
-			vkCmdPushConstants(
-				frameInfo.m_commandBuffer,
-				m_pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&push
-			);
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, ParallelCommandRecorder& recorder) {
+		// The jobs run in ParallelCommandRecorder::execute(), after this returned
+		std::shared_ptr<std::vector<GameObject*>> objects = std::make_shared<std::vector<GameObject*>>();
+		std::shared_ptr<std::vector<GameObject*>> texturedObjects = std::make_shared<std::vector<GameObject*>>();
+		collectGameObjects(frameInfo.m_gameObjects, *objects, *texturedObjects);
+		recorder.addRange(frameInfo, static_cast<int>(objects->size()), PARALLEL_RECORDING_OBJECTS_PER_JOB,
+			[this, objects](FrameInfo& jobFrameInfo, int begin, int end) {
+				recordGameObjects(jobFrameInfo, objects->data() + begin, end - begin, false);
+			});
+		recorder.addRange(frameInfo, static_cast<int>(texturedObjects->size()), PARALLEL_RECORDING_OBJECTS_PER_JOB,
+			[this, texturedObjects](FrameInfo& jobFrameInfo, int begin, int end) {
+				recordGameObjects(jobFrameInfo, texturedObjects->data() + begin, end - begin, true);
+			});
+	}
 
-			obj.m_model->bind(frameInfo.m_commandBuffer);
-			obj.m_model->draw(frameInfo.m_commandBuffer);
+	void SimpleRenderSystem::recordGameObjects(FrameInfo& frameInfo, GameObject* const* objects, size_t count, bool textured) {
+		if (count == 0) {
+			return;
+		}
+		VkPipelineLayout pipelineLayout = textured ? m_pipelineLayoutWithTexture : m_pipelineLayout;
+		if (textured) {
+			m_graphicsPipelineWithTexture->bind(frameInfo.m_commandBuffer);
+		}
+		else {
+			m_graphicsPipeline->bind(frameInfo.m_commandBuffer);
 		}
 
-		// Render Game Objects which have texture
-		m_graphicsPipelineWithTexture->bind(frameInfo.m_commandBuffer);
+		// Bind the descriptor set to the pipeline
+		// Since this is called outside the for loop below, 
+		// all game objects can refer to the global UBO struct values without rebinding
 		vkCmdBindDescriptorSets(
 			frameInfo.m_commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			m_pipelineLayoutWithTexture,
+			pipelineLayout,
 			0, // first set number. 
 			   // If we want to bind a new set and it can be added to the end,
 			   // existing sets would not be rebinded by setting the last index here. 
 			   // This is why frequently shared sets should occupy the earlier set numbers.
-			3, // descriptor set count
+			textured ? 3 : 1, // descriptor set count (the textured pipeline also uses the indirect and texture sets)
 			&frameInfo.m_descriptorSets[0],
-			0, // can be used for specifying dynamic offsets
-			nullptr // can be used for specifying dynamic offsets
+			static_cast<uint32_t>(frameInfo.m_dynamicOffsets.size()), // dynamic offsets of the uniform buffers in set 0
+			frameInfo.m_dynamicOffsets.data()
 		);
-		for (auto& kv : frameInfo.m_gameObjects) {
-			GameObject& obj = kv.second;
-			if (obj.m_model == nullptr || obj.m_model->m_texture == nullptr) {
-				continue;
-			}
+
+		for (size_t i = 0; i < count; i++) {
+			GameObject& obj = *objects[i];
 
 			SimplePushConstantData push{};
 			push.modelMatrix = obj.m_transformMat.mat4();
@@ -154,7 +161,7 @@ namespace AE {
 
 			vkCmdPushConstants(
 				frameInfo.m_commandBuffer,
-				m_pipelineLayoutWithTexture,
+				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				0,
 				sizeof(SimplePushConstantData),
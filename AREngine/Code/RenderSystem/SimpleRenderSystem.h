@@ -11,6 +11,7 @@
 #include "../Camera.h"
 #include "../FrameInfo.h"
 #include "GraphicsPipeline.h"
+#include "../Renderer/ParallelCommandRecorder.h"
 
 namespace AE {
 
@@ -29,9 +30,14 @@ namespace AE {
 		void createPipelineLayoutWithTexture(std::vector<VkDescriptorSetLayout> descriptorSetLayouts);
 		void createGraphicsPipelineWithTexture(VkRenderPass renderPass);
 		void renderGameObjects(FrameInfo& frameInfo);
+		// Queues the objects to the recorder, split into jobs of at least PARALLEL_RECORDING_OBJECTS_PER_JOB
+		void renderGameObjects(FrameInfo& frameInfo, ParallelCommandRecorder& recorder);
 		void cleanupGraphicsPipeline();
 
 	private:
+		void collectGameObjects(GameObject::Map& gameObjects, std::vector<GameObject*>& objects, std::vector<GameObject*>& texturedObjects);
+		void recordGameObjects(FrameInfo& frameInfo, GameObject* const* objects, size_t count, bool textured);
+
 		Devices& m_devices;
 		VkPipelineLayout m_pipelineLayout;
 		std::unique_ptr<GraphicsPipeline> m_graphicsPipeline;
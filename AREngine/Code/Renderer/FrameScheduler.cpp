@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+
+#include "FrameScheduler.h"
+#include "../Devices.h"
+
+namespace AE {
+
+	FrameScheduler::FrameScheduler(Devices& devices, uint32_t framesInFlight)
+		: m_devices{ devices }, m_fences(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE), m_fenceSerials(MAX_FRAMES_IN_FLIGHT, 0) {
+		setFramesInFlight(framesInFlight);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (VkFence& fence : m_fences) {
+			if (vkCreateFence(m_devices.getLogicalDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create frame fence!");
+			}
+		}
+	}
+
+	FrameScheduler::~FrameScheduler() {
+		for (VkFence fence : m_fences) {
+			vkDestroyFence(m_devices.getLogicalDevice(), fence, nullptr);
+		}
+	}
+
+	void FrameScheduler::beginFrame() {
+		m_frameSerial = m_submittedSerial + 1;
+		if (m_frameSerial <= m_framesInFlight) {
+			return;
+		}
+		const uint64_t waitSerial = m_frameSerial - m_framesInFlight;
+		if (getCompletedSerial() >= waitSerial) {
+			return;
+		}
+		std::chrono::steady_clock::time_point waitStartTime = std::chrono::steady_clock::now();
+		waitForSerial(waitSerial);
+		m_stats.waitCount++;
+		m_stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStartTime).count();
+	}
+
+	VkFence FrameScheduler::getSubmitFence() {
+		// framesInFlight <= MAX_FRAMES_IN_FLIGHT, so beginFrame() waited for the frame that used this fence before
+		VkFence fence = m_fences[getFrameIndex()];
+		vkResetFences(m_devices.getLogicalDevice(), 1, &fence);
+		return fence;
+	}
+
+	void FrameScheduler::endFrame() {
+		m_fenceSerials[getFrameIndex()] = m_frameSerial;
+		m_submittedSerial = m_frameSerial;
+		m_stats.frameCount++;
+	}
+
+	uint64_t FrameScheduler::getCompletedSerial() {
+		// Frames finish in submission order, the first one still running ends the scan
+		while (m_completedSerial < m_submittedSerial) {
+			const uint64_t serial = m_completedSerial + 1;
+			VkFence fence = m_fences[serial % MAX_FRAMES_IN_FLIGHT];
+			if (vkGetFenceStatus(m_devices.getLogicalDevice(), fence) != VK_SUCCESS) {
+				break;
+			}
+			m_completedSerial = serial;
+		}
+		return m_completedSerial;
+	}
+
+	void FrameScheduler::waitForSerial(uint64_t serial) {
+		serial = std::min(serial, m_submittedSerial);
+		if (serial <= m_completedSerial) {
+			return;
+		}
+		// Not completed yet, so its fence was not reused
+		assert(m_fenceSerials[serial % MAX_FRAMES_IN_FLIGHT] == serial);
+		VkFence fence = m_fences[serial % MAX_FRAMES_IN_FLIGHT];
+		if (vkWaitForFences(m_devices.getLogicalDevice(), 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait for frame fence!");
+		}
+		// Everything submitted to the queue before it has finished as well
+		m_completedSerial = serial;
+	}
+
+	void FrameScheduler::setFramesInFlight(uint32_t framesInFlight) {
+		m_framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+	}
+
+	void FrameScheduler::printStats(const char* label) const {
+		printf("%s: %u frames in flight, blocked in %llu of %llu frames for %.3f ms per frame on average\n",
+			label,
+			m_framesInFlight,
+			static_cast<unsigned long long>(m_stats.waitCount),
+			static_cast<unsigned long long>(m_stats.frameCount),
+			m_stats.frameCount > 0 ? m_stats.waitMs / m_stats.frameCount : 0.0);
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "../Utils/AREngineIncludes.h"
+#include "../Utils/AREngineDefines.h"
+
+namespace AE {
+
+	class Devices;
+
+	// Frame timeline: every frame gets a serial (1, 2, 3, ...) and the fence of its last submission, so "has frame N
+	// finished" is one comparison against getCompletedSerial() instead of a fence per subsystem.
+	// The compute submission of a frame is covered by the same fence because the graphics submission waits for it,
+	// and deferred deletions are stamped with the serial (ResourceRecycler).
+	// MAX_FRAMES_IN_FLIGHT is the number of per-frame resources (command buffers, descriptor sets, SSBOs, ...),
+	// the frame of serial N uses the ones of index N % MAX_FRAMES_IN_FLIGHT. framesInFlight, which can be changed
+	// at any time, is how many frames the CPU may run ahead of the GPU: beginFrame() waits for the frame
+	// framesInFlight before it. 1 trades throughput for latency.
+	class FrameScheduler {
+	public:
+		struct Stats {
+			uint64_t frameCount = 0;
+			uint64_t waitCount = 0;   // beginFrame() calls that had to block
+			double waitMs = 0.0;      // CPU time spent blocked in them
+		};
+
+		FrameScheduler(Devices& devices, uint32_t framesInFlight);
+		// The device must be idle
+		~FrameScheduler();
+
+		// Not copyable or movable
+		FrameScheduler(const FrameScheduler&) = delete;
+		FrameScheduler& operator=(const FrameScheduler&) = delete;
+		FrameScheduler(FrameScheduler&&) = delete;
+		FrameScheduler& operator=(FrameScheduler&&) = delete;
+
+		// Waits until the frame framesInFlight before the next one has finished. A frame that is begun but never
+		// submitted (e.g. the swap chain was out of date) keeps its serial for the next beginFrame().
+		void beginFrame();
+		// Fence for the last submission of the current frame, reset and ready to be passed to vkQueueSubmit
+		VkFence getSubmitFence();
+		// The submission with getSubmitFence() was made
+		void endFrame();
+
+		// Serial of the frame being recorded
+		uint64_t getFrameSerial() const { return m_frameSerial; }
+		uint32_t getFrameIndex() const { return static_cast<uint32_t>(m_frameSerial % MAX_FRAMES_IN_FLIGHT); }
+		uint64_t getSubmittedSerial() const { return m_submittedSerial; }
+		// Polls the fences, never blocks
+		uint64_t getCompletedSerial();
+		void waitForSerial(uint64_t serial);
+
+		// Clamped to [1, MAX_FRAMES_IN_FLIGHT]
+		void setFramesInFlight(uint32_t framesInFlight);
+		uint32_t getFramesInFlight() const { return m_framesInFlight; }
+
+		const Stats& getStats() const { return m_stats; }
+		void printStats(const char* label) const;
+
+	private:
+		Devices& m_devices;
+		uint32_t m_framesInFlight;
+		std::vector<VkFence> m_fences;       // per frame index
+		std::vector<uint64_t> m_fenceSerials; // the serial last submitted with the fence, 0 for none
+		uint64_t m_frameSerial = 1;
+		uint64_t m_submittedSerial = 0;
+		uint64_t m_completedSerial = 0;
+		Stats m_stats{};
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "ParallelCommandRecorder.h"
+#include "../Devices.h"
+
+namespace AE {
+
+	ParallelCommandRecorder::ParallelCommandRecorder(Devices& devices, ThreadPool& threadPool)
+		: m_devices{ devices }, m_threadPool{ threadPool } {
+	}
+
+	ParallelCommandRecorder::~ParallelCommandRecorder() {
+		for (std::vector<Slot>& slots : m_slots) {
+			for (Slot& slot : slots) {
+				// Frees its command buffer as well
+				vkDestroyCommandPool(m_devices.getLogicalDevice(), slot.commandPool, nullptr);
+			}
+		}
+		for (auto& [key, cached] : m_cachedCommands) {
+			vkDestroyCommandPool(m_devices.getLogicalDevice(), cached.slot.commandPool, nullptr);
+		}
+	}
+
+	void ParallelCommandRecorder::beginFrame(int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent) {
+		m_frameIndex = frameIndex;
+		// The frame that recorded them has finished
+		for (uint32_t i = 0; i < m_usedSlotCounts[m_frameIndex]; i++) {
+			vkResetCommandPool(m_devices.getLogicalDevice(), m_slots[m_frameIndex][i].commandPool, 0);
+		}
+		m_usedSlotCounts[m_frameIndex] = 0;
+
+		m_inheritanceInfo = {};
+		m_inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		m_inheritanceInfo.renderPass = renderPass;
+		m_inheritanceInfo.subpass = 0;
+		// Optional, but lets the driver specialize the secondary command buffers for it
+		m_inheritanceInfo.framebuffer = framebuffer;
+		m_cachedInheritanceInfo = m_inheritanceInfo;
+		m_cachedInheritanceInfo.framebuffer = VK_NULL_HANDLE;
+		m_extent = extent;
+		m_jobs.clear();
+	}
+
+	void ParallelCommandRecorder::add(const FrameInfo& frameInfo, RecordFunction record) {
+		m_jobs.push_back({ frameInfo, std::move(record), 0, 1 });
+	}
+
+	uint32_t ParallelCommandRecorder::getThreadCount() const {
+		// The calling thread records too
+		const uint32_t poolThreadCount = m_threadPool.getThreadCount() + 1;
+		return m_threadCount == 0 ? poolThreadCount : std::min(m_threadCount, poolThreadCount);
+	}
+
+	void ParallelCommandRecorder::addRange(const FrameInfo& frameInfo, int count, int minPerJob, RecordFunction record) {
+		if (count <= 0) {
+			return;
+		}
+		const int maxJobCount = static_cast<int>(getThreadCount());
+		minPerJob = std::max(minPerJob, 1);
+		const int jobCount = std::clamp((count + minPerJob - 1) / minPerJob, 1, maxJobCount);
+		const int perJob = (count + jobCount - 1) / jobCount;
+		for (int begin = 0; begin < count; begin += perJob) {
+			m_jobs.push_back({ frameInfo, record, begin, std::min(begin + perJob, count) });
+		}
+	}
+
+	void ParallelCommandRecorder::addCached(const void* owner, uint64_t version, const FrameInfo& frameInfo, RecordFunction record) {
+		// Pools are only created here and in execute(), on the calling thread
+		auto [it, inserted] = m_cachedCommands.try_emplace(std::make_pair(owner, m_frameIndex));
+		CachedCommands& cached = it->second;
+		if (inserted) {
+			cached.slot = createSlot();
+		}
+
+		Job job{ frameInfo, std::move(record), 0, 1 };
+		job.cached = &cached;
+		job.recordCached = !cached.valid
+			|| cached.version != version
+			|| cached.descriptorSets != frameInfo.m_descriptorSets
+			|| cached.dynamicOffsets != frameInfo.m_dynamicOffsets;
+		if (job.recordCached) {
+			// The frame that executed it last has finished, like the one of the pools of beginFrame()
+			vkResetCommandPool(m_devices.getLogicalDevice(), cached.slot.commandPool, 0);
+			cached.valid = true;
+			cached.version = version;
+			cached.descriptorSets = frameInfo.m_descriptorSets;
+			cached.dynamicOffsets = frameInfo.m_dynamicOffsets;
+		}
+		m_jobs.push_back(std::move(job));
+	}
+
+	void ParallelCommandRecorder::invalidateCachedCommands() {
+		for (auto& [key, cached] : m_cachedCommands) {
+			cached.valid = false;
+		}
+	}
+
+	ParallelCommandRecorder::Slot ParallelCommandRecorder::createSlot() {
+		Slot slot{};
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = m_devices.getGraphicsQueueFamily();
+		if (vkCreateCommandPool(m_devices.getLogicalDevice(), &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create secondary command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = slot.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_devices.getLogicalDevice(), &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		return slot;
+	}
+
+	void ParallelCommandRecorder::recordJob(Job& job) {
+		VkCommandBuffer commandBuffer = job.commandBuffer;
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// RENDER_PASS_CONTINUE: executed entirely inside the render pass of the inheritance info
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		if (job.cached == nullptr) {
+			beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = &m_inheritanceInfo;
+		}
+		else {
+			// Executed again in later frames, with whichever framebuffer the swap chain image has then
+			beginInfo.pInheritanceInfo = &m_cachedInheritanceInfo;
+		}
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		// Dynamic state is not inherited from the primary command buffer
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(m_extent.width);
+		viewport.height = static_cast<float>(m_extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{ {0, 0}, m_extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		job.frameInfo.m_commandBuffer = commandBuffer;
+		job.record(job.frameInfo, job.begin, job.end);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+	}
+
+	void ParallelCommandRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+		m_stats.frameCount++;
+		if (m_jobs.empty()) {
+			return;
+		}
+		std::chrono::steady_clock::time_point recordStartTime = std::chrono::steady_clock::now();
+
+		// Pools are only created here and in addCached(), on the calling thread
+		std::vector<Slot>& slots = m_slots[m_frameIndex];
+		uint32_t slotCount = 0;
+		m_commandBuffers.clear();
+		for (Job& job : m_jobs) {
+			if (job.cached != nullptr) {
+				job.commandBuffer = job.cached->slot.commandBuffer;
+				if (job.recordCached) {
+					m_stats.cachedRecordCount++;
+				}
+				else {
+					m_stats.cachedReuseCount++;
+				}
+			}
+			else {
+				if (slots.size() <= slotCount) {
+					slots.push_back(createSlot());
+				}
+				job.commandBuffer = slots[slotCount++].commandBuffer;
+			}
+			m_commandBuffers.push_back(job.commandBuffer);
+		}
+		m_usedSlotCounts[m_frameIndex] = slotCount;
+
+		// One task per thread, each records a contiguous run of jobs
+		const int jobCount = static_cast<int>(m_jobs.size());
+		const int taskCount = std::min(jobCount, static_cast<int>(getThreadCount()));
+		m_threadPool.parallelFor(0, taskCount, 1, [&](int task, int) {
+			for (int i = task * jobCount / taskCount; i < (task + 1) * jobCount / taskCount; i++) {
+				if (m_jobs[i].cached == nullptr || m_jobs[i].recordCached) {
+					recordJob(m_jobs[i]);
+				}
+			}
+		});
+
+		vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+
+		m_stats.commandBufferCount += m_jobs.size();
+		m_stats.recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStartTime).count();
+		m_jobs.clear();
+	}
+
+	void ParallelCommandRecorder::printStats(const char* label) const {
+		if (m_stats.frameCount == 0) {
+			return;
+		}
+		printf("%s: %.3f ms per frame for %.1f secondary command buffers on %u threads\n",
+			label,
+			m_stats.recordMs / m_stats.frameCount,
+			static_cast<double>(m_stats.commandBufferCount) / m_stats.frameCount,
+			getThreadCount());
+		if (m_stats.cachedReuseCount + m_stats.cachedRecordCount > 0) {
+			printf("%s: %llu cached command buffers executed as recorded, %llu recorded again\n",
+				label,
+				static_cast<unsigned long long>(m_stats.cachedReuseCount),
+				static_cast<unsigned long long>(m_stats.cachedRecordCount));
+		}
+	}
+
+} // namespace AE
\ No newline at end of file
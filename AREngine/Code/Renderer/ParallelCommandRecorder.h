@@ -0,0 +1,116 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "../Utils/AREngineIncludes.h"
+#include "../Utils/AREngineDefines.h"
+#include "../Utils/ThreadPool.h"
+#include "../FrameInfo.h"
+
+namespace AE {
+
+	class Devices;
+
+	// Records the contents of the swap chain render pass on the thread pool.
+	// Every job queued with add() / addRange() records into its own secondary command buffer, and execute() runs
+	// them in the order they were queued. Job i of a frame index always uses command pool i of that frame index,
+	// so no two threads ever share a pool and a frame resets its pools with one vkResetCommandPool each
+	// (FrameScheduler guarantees the frame that used them before has finished).
+	// Jobs queued with addCached() keep their secondary command buffer (one per frame index) and are only recorded
+	// again when what they were recorded with changes, every other frame only vkCmdExecuteCommands runs.
+	class ParallelCommandRecorder {
+	public:
+		// Gets a copy of the queued FrameInfo whose m_commandBuffer is the secondary command buffer, with viewport and
+		// scissor set. [begin, end) is the part of the range of addRange() the job records.
+		using RecordFunction = std::function<void(FrameInfo& frameInfo, int begin, int end)>;
+
+		struct Stats {
+			uint64_t frameCount = 0;
+			uint64_t commandBufferCount = 0;
+			uint64_t cachedReuseCount = 0;   // addCached() jobs executed without recording
+			uint64_t cachedRecordCount = 0;  // addCached() jobs that had to be recorded (again)
+			double recordMs = 0.0;  // wall time of execute(), i.e. of the parallel recording
+		};
+
+		ParallelCommandRecorder(Devices& devices, ThreadPool& threadPool);
+		// The device must be idle
+		~ParallelCommandRecorder();
+
+		// Not copyable or movable
+		ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+		ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+		ParallelCommandRecorder(ParallelCommandRecorder&&) = delete;
+		ParallelCommandRecorder& operator=(ParallelCommandRecorder&&) = delete;
+
+		// Records on at most threadCount threads, the calling thread included (0: every pool thread and the calling one).
+		// 1 records every job on the calling thread, the baseline for the scaling of the frame time with threads.
+		void setThreadCount(uint32_t threadCount) { m_threadCount = threadCount; }
+		uint32_t getThreadCount() const;
+
+		// Renderer::beginSwapChainRenderPass() calls it when the render pass contents are secondary command buffers
+		void beginFrame(int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+		// One job (e.g. a whole render system), called with begin = 0, end = 1
+		void add(const FrameInfo& frameInfo, RecordFunction record);
+		// Splits [0, count) into at most one job per thread, each with at least minPerJob elements
+		void addRange(const FrameInfo& frameInfo, int count, int minPerJob, RecordFunction record);
+		// One job whose commands only depend on the frame index, owner and version. It is recorded again when version or
+		// the descriptor sets or dynamic offsets of frameInfo differ from the last recording of this owner and frame
+		// index, or after invalidateCachedCommands(). Bump version whenever anything else it records changes
+		// (pipelines, buffers, draw counts). The framebuffer is not inherited, so it serves every swap chain image.
+		void addCached(const void* owner, uint64_t version, const FrameInfo& frameInfo, RecordFunction record);
+		// The extent changed (swap chain recreation). Each cached command buffer is recorded again the next time its frame
+		// index comes around, when the frame that executed it last has finished.
+		void invalidateCachedCommands();
+		// Records the queued jobs in parallel and executes them into primaryCommandBuffer.
+		// Renderer::endSwapChainRenderPass() calls it.
+		void execute(VkCommandBuffer primaryCommandBuffer);
+
+		const Stats& getStats() const { return m_stats; }
+		void printStats(const char* label) const;
+
+	private:
+		struct Slot {
+			VkCommandPool commandPool;
+			VkCommandBuffer commandBuffer;
+		};
+
+		struct CachedCommands {
+			Slot slot;  // its own pool, it may be recorded on any thread
+			bool valid = false;
+			uint64_t version = 0;
+			std::vector<VkDescriptorSet> descriptorSets;
+			std::vector<uint32_t> dynamicOffsets;
+		};
+
+		struct Job {
+			FrameInfo frameInfo;
+			RecordFunction record;
+			int begin;
+			int end;
+			CachedCommands* cached = nullptr;
+			bool recordCached = false;  // cached only: the cached commands are out of date
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		};
+
+		Slot createSlot();
+		void recordJob(Job& job);
+
+		Devices& m_devices;
+		ThreadPool& m_threadPool;
+		std::vector<Slot> m_slots[MAX_FRAMES_IN_FLIGHT];
+		uint32_t m_usedSlotCounts[MAX_FRAMES_IN_FLIGHT] = {};
+		std::map<std::pair<const void*, int>, CachedCommands> m_cachedCommands; // by owner and frame index
+		int m_frameIndex = 0;
+		VkCommandBufferInheritanceInfo m_inheritanceInfo{};
+		VkCommandBufferInheritanceInfo m_cachedInheritanceInfo{};  // without the framebuffer
+		VkExtent2D m_extent{};
+		std::vector<Job> m_jobs;
+		std::vector<VkCommandBuffer> m_commandBuffers;
+		uint32_t m_threadCount = 0;
+		Stats m_stats{};
+	};
+
+} // namespace AE
\ No newline at end of file
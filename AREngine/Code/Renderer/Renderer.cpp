@@ -3,6 +3,7 @@
 #include <array>
 
 #include "Renderer.h"
+#include "../ResourceRecycler.h"
 
 namespace AE {
 
@@ -21,6 +22,14 @@ namespace AE {
 		if (vkAllocateCommandBuffers(m_devices.getLogicalDevice(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
+#ifdef ASYNC_COMPUTE
+		// The compute queue is of the graphics family, so they come from the same pool
+		m_computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.commandBufferCount = static_cast<uint32_t>(m_computeCommandBuffers.size());
+		if (vkAllocateCommandBuffers(m_devices.getLogicalDevice(), &allocInfo, m_computeCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute command buffers!");
+		}
+#endif
 	}
 
 	void Renderer::freeCommandBuffers() {
@@ -31,6 +40,15 @@ namespace AE {
 			m_commandBuffers.data()
 		);
 		m_commandBuffers.clear();
+		if (!m_computeCommandBuffers.empty()) {
+			vkFreeCommandBuffers(
+				m_devices.getLogicalDevice(),
+				m_devices.getCommandPool(),
+				static_cast<uint32_t>(m_computeCommandBuffers.size()),
+				m_computeCommandBuffers.data()
+			);
+			m_computeCommandBuffers.clear();
+		}
 	}
 
 	void Renderer::recreateSwapChain() {
@@ -39,9 +57,16 @@ namespace AE {
 			extent = m_winApp.getExtent();
 			glfwWaitEvents();
 		}
-		vkDeviceWaitIdle(m_devices.getLogicalDevice());
+		// No vkDeviceWaitIdle: the frames in flight finish with the old swap chain, which is retired through the
+		// ResourceRecycler, while the next frames already render to the new one
+		if (m_commandRecorder != nullptr) {
+			// Recorded for the extent of the old swap chain
+			m_commandRecorder->invalidateCachedCommands();
+		}
 
 		if (m_swapChain == nullptr) {
+			m_frameScheduler = std::make_unique<FrameScheduler>(m_devices, m_framesInFlight);
+			m_devices.getUploadManager().setFrameScheduler(m_frameScheduler.get());
 			m_swapChain = std::make_unique<SwapChain>(m_devices);
 			m_swapChain->createSwapChain(m_winApp);
 			m_swapChain->createImageViews();
@@ -54,7 +79,11 @@ namespace AE {
 			m_swapChain->createSyncObjects();
 		}
 		else {
-			cleanupSwapChain();
+			// Checked before anything is created, so that a throw leaves the old swap chain complete. Otherwise the new
+			// one takes over its render pass, which the pipelines were built for.
+			if (!m_swapChain->matchesSurfaceFormats()) {
+				throw std::runtime_error("Swap chain image(or depth) format has changed!");
+			}
 			std::shared_ptr<SwapChain> oldSwapChain = std::move(m_swapChain);
 			m_swapChain = std::make_unique<SwapChain>(m_devices, oldSwapChain);
 			m_swapChain->createSwapChain(m_winApp);
@@ -66,11 +95,30 @@ namespace AE {
 			m_swapChain->createRenderPass();
 			m_swapChain->createFrameBuffers();
 			m_swapChain->createSyncObjects();
-			// check the compatibility between the current swapchain and the previous swapchain
-			if (!oldSwapChain->compareSwapFormats(*m_swapChain.get())) {
-				throw std::runtime_error("Swap chain image(or depth) format has changed!");
-			}
+			retireSwapChain(*oldSwapChain);
+		}
+	}
+
+	void Renderer::retireSwapChain(SwapChain& swapChain) {
+		// The frames in flight may still render into and present its images. The render pass and the semaphores
+		// went to the new swap chain.
+		ResourceRecycler& recycler = m_devices.getResourceRecycler();
+		for (VkFramebuffer framebuffer : swapChain.getFrameBuffers()) {
+			recycler.destroyFramebuffer(framebuffer);
+		}
+		for (size_t i = 0; i < swapChain.getDepthImages().size(); i++) {
+			recycler.destroyImage(swapChain.getDepthImages()[i], swapChain.getDepthImageViews()[i], VK_NULL_HANDLE, swapChain.getDepthImageMemorys()[i]);
+		}
+#ifdef ENABLE_MSAA
+		for (size_t i = 0; i < swapChain.getMSAAImages().size(); i++) {
+			recycler.destroyImage(swapChain.getMSAAImages()[i], swapChain.getMSAAImageViews()[i], VK_NULL_HANDLE, swapChain.getMSAAImageMemorys()[i]);
+		}
+#endif
+		for (VkImageView imageView : swapChain.getImageViews()) {
+			// The images belong to the swap chain
+			recycler.destroyImage(VK_NULL_HANDLE, imageView, VK_NULL_HANDLE, {});
 		}
+		recycler.destroySwapChain(swapChain.getSwapChain());
 	}
 
 	void Renderer::cleanupSwapChain() {
@@ -78,8 +126,6 @@ namespace AE {
 			vkDestroySemaphore(m_devices.getLogicalDevice(), m_swapChain->getImageAvailableSemaphores()[i], nullptr);
 			vkDestroySemaphore(m_devices.getLogicalDevice(), m_swapChain->getRenderFinishedSemaphores()[i], nullptr);
 			vkDestroySemaphore(m_devices.getLogicalDevice(), m_swapChain->getComputeFinishedSemaphores()[i], nullptr);
-			vkDestroyFence(m_devices.getLogicalDevice(), m_swapChain->getInFlightFences()[i], nullptr);
-			vkDestroyFence(m_devices.getLogicalDevice(), m_swapChain->getComputeInFlight()[i], nullptr);
 		}
 		for (auto framebuffer : m_swapChain->getFrameBuffers()) {
 			vkDestroyFramebuffer(m_devices.getLogicalDevice(), framebuffer, nullptr);
@@ -88,13 +134,13 @@ namespace AE {
 		for (int i = 0; i < m_swapChain->getDepthImages().size(); i++) {
 			vkDestroyImageView(m_devices.getLogicalDevice(), m_swapChain->getDepthImageViews()[i], nullptr);
 			vkDestroyImage(m_devices.getLogicalDevice(), m_swapChain->getDepthImages()[i], nullptr);
-			vkFreeMemory(m_devices.getLogicalDevice(), m_swapChain->getDepthImageMemorys()[i], nullptr);
+			m_devices.freeMemory(m_swapChain->getDepthImageMemorys()[i]);
 		}
 #ifdef ENABLE_MSAA
 		for (int i = 0; i < m_swapChain->getDepthImages().size(); i++) {
 			vkDestroyImageView(m_devices.getLogicalDevice(), m_swapChain->getMSAAImageViews()[i], nullptr);
 			vkDestroyImage(m_devices.getLogicalDevice(), m_swapChain->getMSAAImages()[i], nullptr);
-			vkFreeMemory(m_devices.getLogicalDevice(), m_swapChain->getMSAAImageMemorys()[i], nullptr);
+			m_devices.freeMemory(m_swapChain->getMSAAImageMemorys()[i]);
 		}
 #endif
 		for (VkImageView imageView : m_swapChain->getImageViews()) {
@@ -103,9 +149,32 @@ namespace AE {
 		vkDestroySwapchainKHR(m_devices.getLogicalDevice(), m_swapChain->getSwapChain(), nullptr);
 	}
 
+	void Renderer::destroyFrameScheduler() {
+		m_devices.getUploadManager().setFrameScheduler(nullptr);
+		m_frameScheduler = nullptr;
+	}
+
+	void Renderer::createCommandRecorder(ThreadPool& threadPool) {
+		m_commandRecorder = std::make_unique<ParallelCommandRecorder>(m_devices, threadPool);
+	}
+
+	void Renderer::destroyCommandRecorder() {
+		m_commandRecorder = nullptr;
+	}
+
+	void Renderer::setFramesInFlight(uint32_t framesInFlight) {
+		m_framesInFlight = framesInFlight;
+		if (m_frameScheduler != nullptr) {
+			m_frameScheduler->setFramesInFlight(framesInFlight);
+		}
+	}
+
 	VkCommandBuffer Renderer::beginFrame() {
 		assert(!m_isFrameStarted && "Can't call beginFrame while already in progress");
 
+		// Waits until the command buffers and other per-frame resources of this frame index are no longer in use
+		m_frameScheduler->beginFrame();
+		m_currentFrameIndex = m_frameScheduler->getFrameIndex();
 		VkResult result = m_swapChain->acquireNextImage(&m_currentImageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
@@ -116,6 +185,7 @@ namespace AE {
 		}
 
 		m_isFrameStarted = true;
+		m_devices.getResourceRecycler().beginFrame(m_frameScheduler->getFrameSerial(), m_frameScheduler->getCompletedSerial());
 		VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -129,12 +199,14 @@ namespace AE {
 
 	void Renderer::endFrame() {
 		assert(m_isFrameStarted && "Can't call endFrame while frame is not in progress");
+		assert(!m_isComputeStarted && "Can't call endFrame while compute is in progress");
 		VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
-		VkResult result = m_swapChain->submitGraphicsCommandBuffers(&commandBuffer, &m_currentImageIndex);
+		VkResult result = m_swapChain->submitGraphicsCommandBuffers(&commandBuffer, &m_currentImageIndex, m_frameScheduler->getSubmitFence());
+		m_frameScheduler->endFrame();
 		// VK_SUBOPTIMAL_KHR : swapchain no longer matches the surface properties exactly, but can still be used to present to the surface successfully.
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_winApp.wasWindowResized()) {
 			m_winApp.resetWindowResizedFlag();
@@ -145,10 +217,41 @@ namespace AE {
 		}
 
 		m_isFrameStarted = false;
-		m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+	VkCommandBuffer Renderer::beginCompute() {
+		assert(m_isFrameStarted && "Can't call beginCompute if frame is not in progress");
+		assert(!m_isComputeStarted && "Can't call beginCompute while already in progress");
+		m_isComputeStarted = true;
+#ifdef ASYNC_COMPUTE
+		// The graphics submission of the frame that used it before waited for it, and beginFrame() waited for that one
+		VkCommandBuffer commandBuffer = m_computeCommandBuffers[m_currentFrameIndex];
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording compute command buffer!");
+		}
+		return commandBuffer;
+#else
+		return getCurrentCommandBuffer();
+#endif
+	}
+
+	void Renderer::endCompute() {
+		assert(m_isComputeStarted && "Can't call endCompute while compute is not in progress");
+		m_isComputeStarted = false;
+#ifdef ASYNC_COMPUTE
+		VkCommandBuffer commandBuffer = m_computeCommandBuffers[m_currentFrameIndex];
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record compute command buffer!");
+		}
+		// Submitted before the graphics command buffer is even recorded, so it can run while the previous frame renders
+		m_swapChain->submitComputeCommandBuffers(&commandBuffer, &m_currentImageIndex);
+#endif
+	}
+
+	void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 		assert(m_isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 		assert(
 			commandBuffer == getCurrentCommandBuffer() &&
@@ -168,7 +271,14 @@ namespace AE {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 		// All of the functions that record commands can be recognized by their vkCmd prefix.
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		m_isSecondaryRenderPass = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+		if (m_isSecondaryRenderPass) {
+			// vkCmdExecuteCommands is the only command allowed in the render pass now, the secondary command buffers
+			// set the viewport and scissor themselves
+			m_commandRecorder->beginFrame(m_currentFrameIndex, renderPassInfo.renderPass, renderPassInfo.framebuffer, renderPassInfo.renderArea.extent);
+			return;
+		}
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -188,6 +298,10 @@ namespace AE {
 			commandBuffer == getCurrentCommandBuffer() &&
 			"Can't end render pass on command buffer from a different frame"
 		);
+		if (m_isSecondaryRenderPass) {
+			m_commandRecorder->execute(commandBuffer);
+			m_isSecondaryRenderPass = false;
+		}
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
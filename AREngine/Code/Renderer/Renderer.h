@@ -8,6 +8,8 @@
 #include "../Devices.h"
 #include "WinApplication.h"
 #include "SwapChain.h"
+#include "FrameScheduler.h"
+#include "ParallelCommandRecorder.h"
 
 namespace AE {
 
@@ -32,28 +34,57 @@ namespace AE {
 			assert(m_isFrameStarted && "Cannot get frame index when frame not in progress");
 			return m_currentFrameIndex;
 		}
+		// How many frames the CPU may run ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT. Can be changed at any time.
+		void setFramesInFlight(uint32_t framesInFlight);
+		// Created with the swap chain
+		FrameScheduler& getFrameScheduler() { return *m_frameScheduler; }
+		// Jobs may only be queued between beginSwapChainRenderPass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) and
+		// endSwapChainRenderPass()
+		ParallelCommandRecorder& getCommandRecorder() { return *m_commandRecorder; }
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// Command buffer for the compute work of the frame, between beginFrame() and endFrame().
+		// With ASYNC_COMPUTE it is a separate one that endCompute() submits right away, without it is the graphics
+		// command buffer and the compute work has to be recorded before the render pass.
+		VkCommandBuffer beginCompute();
+		void endCompute();
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS everything inside the render pass is queued to
+		// getCommandRecorder(), and endSwapChainRenderPass() records and executes it
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// Without waiting for the device, the old swap chain is destroyed once the frames in flight have finished
 		void recreateSwapChain();
+		// After vkDeviceWaitIdle
 		void cleanupSwapChain();
+		// After vkDeviceWaitIdle, before the device is destroyed
+		void destroyFrameScheduler();
+		void createCommandRecorder(ThreadPool& threadPool);
+		// After vkDeviceWaitIdle, before the device is destroyed
+		void destroyCommandRecorder();
 		void createCommandBuffers();
 
 	private:
 		void recordCommandBuffer(int imageIndex);
 		void freeCommandBuffers();
+		// Hands what the new swap chain did not take over to the ResourceRecycler
+		void retireSwapChain(SwapChain& swapChain);
 
 		WinApplication& m_winApp;
 		Devices& m_devices;
 		std::unique_ptr<SwapChain> m_swapChain;
+		std::unique_ptr<FrameScheduler> m_frameScheduler;
+		std::unique_ptr<ParallelCommandRecorder> m_commandRecorder;
+		uint32_t m_framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
 		std::vector<VkCommandBuffer> m_commandBuffers;
+		std::vector<VkCommandBuffer> m_computeCommandBuffers; // ASYNC_COMPUTE only
 
 		uint32_t m_currentImageIndex;
 		int m_currentFrameIndex;
 		bool m_isFrameStarted{ false };
+		bool m_isComputeStarted{ false };
+		bool m_isSecondaryRenderPass{ false };
 	};
 
 } // namespace AE
\ No newline at end of file
@@ -12,7 +12,6 @@ namespace AE {
 	
 	SwapChain::SwapChain(Devices& devices, std::shared_ptr<SwapChain> previous) : m_devices{ devices }, m_oldSwapChain{ previous } 
 	{
-		m_oldSwapChain = nullptr;
 	}
 
 	VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -274,8 +273,21 @@ namespace AE {
 			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 	}
 
+	bool SwapChain::matchesSurfaceFormats() {
+		SwapChainSupportDetails swapChainSupport = m_devices.querySwapChainSupport(m_devices.getPhysicalDevice(), m_devices.getSurface());
+		return chooseSwapSurfaceFormat(swapChainSupport.formats).format == m_swapChainImageFormat
+			&& findDepthFormat() == m_swapChainDepthFormat;
+	}
+
 	// Render Pass is kind of a blueprint for a graphics pipeline to know what layout to expect for the output frame buffers.
 	void SwapChain::createRenderPass() {
+		if (m_oldSwapChain != nullptr && compareSwapFormats(*m_oldSwapChain)) {
+			// Same attachments, so the frames in flight and the pipelines can keep using it
+			m_renderPass = m_oldSwapChain->m_renderPass;
+			m_oldSwapChain->m_renderPass = VK_NULL_HANDLE;
+			return;
+		}
+
 		// Use Render Target as color buffer
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = m_swapChainImageFormat;
@@ -403,46 +415,44 @@ namespace AE {
 	}
 
 	void SwapChain::createSyncObjects() {
-		m_computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		if (m_oldSwapChain != nullptr) {
+			// The frames in flight wait on and signal them, so they are kept along with the frame they are at.
+			// No compute submission is pending, recreation happens before the compute pass or after the present.
+			m_computeFinishedSemaphores = std::move(m_oldSwapChain->m_computeFinishedSemaphores);
+			m_imageAvailableSemaphores = std::move(m_oldSwapChain->m_imageAvailableSemaphores);
+			m_renderFinishedSemaphores = std::move(m_oldSwapChain->m_renderFinishedSemaphores);
+			m_computeSubmitted = std::move(m_oldSwapChain->m_computeSubmitted);
+			m_currentFrame = m_oldSwapChain->m_currentFrame;
+			// The last step of the creation, nothing else is taken over
+			m_oldSwapChain = nullptr;
+			return;
+		}
+
+		// The fences are the FrameScheduler's, they outlive the swap chain
 		m_computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		m_imagesInFlight.resize(m_swapChainImages.size(), VK_NULL_HANDLE);
+		m_computeSubmitted.assign(MAX_FRAMES_IN_FLIGHT, false);
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo = {};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Initialize as 1 (signal state) for the first frame
-
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			if (vkCreateSemaphore(m_devices.getLogicalDevice(), &semaphoreInfo, nullptr, &m_computeFinishedSemaphores[i]) !=
-				VK_SUCCESS ||
-				vkCreateFence(m_devices.getLogicalDevice(), &fenceInfo, nullptr, &m_computeInFlightFences[i])
-				!= VK_SUCCESS) {
+				VK_SUCCESS) {
 				throw std::runtime_error("failed to create compute synchronization objects for a frame!");
 			}
 			if (vkCreateSemaphore(m_devices.getLogicalDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) !=
 				VK_SUCCESS ||
 				vkCreateSemaphore(m_devices.getLogicalDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) !=
-				VK_SUCCESS ||
-				vkCreateFence(m_devices.getLogicalDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS) {
+				VK_SUCCESS) {
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 			}
 		}
 	}
 
 	VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
-		vkWaitForFences(
-			m_devices.getLogicalDevice(),
-			1,
-			&m_inFlightFences[m_currentFrame],
-			VK_TRUE,
-			std::numeric_limits<uint64_t>::max()
-		);
-
+		// FrameScheduler::beginFrame() waited for the frame that used the semaphores of m_currentFrame before
 		VkResult result = vkAcquireNextImageKHR(
 			m_devices.getLogicalDevice(),
 			m_swapChain,
@@ -457,15 +467,9 @@ namespace AE {
 	}
 
 	void SwapChain::submitComputeCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-		vkWaitForFences(m_devices.getLogicalDevice(), 1, &m_computeInFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
-
-		vkResetFences(m_devices.getLogicalDevice(), 1, &m_computeInFlightFences[m_currentFrame]);
-
-		//vkResetCommandBuffer(buffers[m_currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-
-		// The first three parameters specify which semaphores to wait on before execution begins and in which stage(s) of the pipeline to wait. 
-		// We want to wait with writing colors to the image until it's available, so we're specifying the stage of the graphics pipeline that writes to the color attachment. That means that theoretically the implementation can already start executing our vertex shader and such while the image is not yet available. 
-		// Each entry in the waitStages array corresponds to the semaphore with the same index in pWaitSemaphores.
+		// No wait semaphores: the SSBO and indirect buffer this frame writes were last read by the graphics of the
+		// previous use of this frame in flight, which FrameScheduler::beginFrame() waited for.
+		// No fence either, the graphics submission of the frame waits for this one, so its fence covers both.
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo.commandBufferCount = 1;
@@ -474,26 +478,30 @@ namespace AE {
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		// The last parameter references an optional fence that will be signaled when the command buffers finish execution. This allows us to know when it is safe for the command buffer to be reused, thus we want to give it inFlightFence. Now on the next frame, the CPU will wait for this command buffer to finish executing before it records new commands into it.
-		if (vkQueueSubmit(m_devices.getGraphicsComandQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
+		if (vkQueueSubmit(m_devices.getComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit compute command buffer!");
 		}
+		m_computeSubmitted[m_currentFrame] = true;
 	}
 
-	VkResult SwapChain::submitGraphicsCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-		if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(m_devices.getLogicalDevice(), 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-		}
-		m_imagesInFlight[*imageIndex] = m_inFlightFences[m_currentFrame];
+	VkResult SwapChain::submitGraphicsCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkFence fence) {
+		// No wait for the frame that rendered into this image before: it was presented, and the image is only handed
+		// out again (imageAvailable signaled) once the presentation, which waited for that rendering, is done with it.
 
 		// The first three parameters specify which semaphores to wait on before execution begins and in which stage(s) of the pipeline to wait. 
 		// We want to wait with writing colors to the image until it's available, so we're specifying the stage of the graphics pipeline that writes to the color attachment. That means that theoretically the implementation can already start executing our vertex shader and such while the image is not yet available. 
 		// Each entry in the waitStages array corresponds to the semaphore with the same index in pWaitSemaphores.
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
+		// The particle draws wait for the compute pass of this frame, if one was submitted. The indirect commands are read
+		// before vertex input, so that stage waits too.
+		VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame], m_computeFinishedSemaphores[m_currentFrame] };
+		VkPipelineStageFlags waitStages[] = {
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+		};
+		submitInfo.waitSemaphoreCount = m_computeSubmitted[m_currentFrame] ? 2 : 1;
+		m_computeSubmitted[m_currentFrame] = false;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 		submitInfo.commandBufferCount = 1;
@@ -502,10 +510,8 @@ namespace AE {
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		vkResetFences(m_devices.getLogicalDevice(), 1, &m_inFlightFences[m_currentFrame]);
-
-		// The last parameter references an optional fence that will be signaled when the command buffers finish execution. This allows us to know when it is safe for the command buffer to be reused, thus we want to give it inFlightFence. Now on the next frame, the CPU will wait for this command buffer to finish executing before it records new commands into it.
-		if (vkQueueSubmit(m_devices.getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
+		// The last parameter references an optional fence that will be signaled when the command buffers finish execution. This allows us to know when it is safe for the command buffer to be reused. Now on a later frame, the CPU will wait for this command buffer to finish executing before it records new commands into it.
+		if (vkQueueSubmit(m_devices.getGraphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
 			throw std::runtime_error("failed to submit draw command buffer!");
 		}
 
@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "../Utils/AREngineIncludes.h"
+#include "../MemoryAllocator.h"
 
 namespace AE {
 
@@ -12,6 +13,8 @@ namespace AE {
 	class SwapChain {
 	public:
 		SwapChain(Devices& devices) : m_devices{ devices } {}
+		// Created with previous as oldSwapchain. createRenderPass() takes over its render pass when the formats are the
+		// same and createSyncObjects() its semaphores, the rest of it is Renderer's to retire.
 		SwapChain(Devices& devices, std::shared_ptr<SwapChain> previous);
 
 		// Not copyable or movable
@@ -21,8 +24,11 @@ namespace AE {
 		SwapChain& operator=(SwapChain&&) = delete;
 		
 		VkResult acquireNextImage(uint32_t* imageIndex);
+		// Submits to the compute queue and signals the compute finished semaphore of the frame, which the next
+		// submitGraphicsCommandBuffers() waits for. Call between acquireNextImage() and submitGraphicsCommandBuffers().
 		void submitComputeCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
-		VkResult submitGraphicsCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		// fence: FrameScheduler::getSubmitFence()
+		VkResult submitGraphicsCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkFence fence);
 
 		void createSwapChain(AE::WinApplication& winApp);
 		void createImageViews();
@@ -33,6 +39,9 @@ namespace AE {
 		void createSyncObjects();
 
 		VkFormat findDepthFormat();
+		// Whether a swap chain created now for the surface gets the image and depth formats of this one, i.e. whether
+		// its render pass, and the pipelines built for it, can be kept
+		bool matchesSurfaceFormats();
 		bool compareSwapFormats(const SwapChain& swapChain) const {
 			return swapChain.m_swapChainDepthFormat == m_swapChainDepthFormat
 				&& swapChain.m_swapChainImageFormat == m_swapChainImageFormat;
@@ -48,18 +57,15 @@ namespace AE {
 		const std::vector<VkImageView>& getImageViews() const { return m_swapChainImageViews;  }
 		const std::vector<VkImage>& getDepthImages() const { return m_depthImages; }
 		const std::vector<VkImageView>& getDepthImageViews() const { return m_depthImageViews; }
-		const std::vector<VkDeviceMemory>& getDepthImageMemorys() const { return m_depthImageMemorys; }
+		const std::vector<MemoryAllocation>& getDepthImageMemorys() const { return m_depthImageMemorys; }
 		const std::vector<VkImage>& getMSAAImages() const { return m_msaaImages; }
 		const std::vector<VkImageView>& getMSAAImageViews() const { return m_msaaImageViews; }
-		const std::vector<VkDeviceMemory>& getMSAAImageMemorys() const { return m_msaaImageMemorys; }
+		const std::vector<MemoryAllocation>& getMSAAImageMemorys() const { return m_msaaImageMemorys; }
 		const std::vector<VkFramebuffer>& getFrameBuffers() const { return m_framebuffers; }
 		const VkRenderPass& getRenderPass() const { return m_renderPass; }
 		const std::vector<VkSemaphore>& getImageAvailableSemaphores() const { return m_imageAvailableSemaphores; }
 		const std::vector<VkSemaphore>& getRenderFinishedSemaphores() const { return m_renderFinishedSemaphores; }
 		const std::vector<VkSemaphore>& getComputeFinishedSemaphores() const { return m_computeFinishedSemaphores; }
-		const std::vector<VkFence>& getInFlightFences() const { return m_inFlightFences; }
-		const std::vector<VkFence>& getImagesInFlight() const { return m_imagesInFlight; }
-		const std::vector<VkFence>& getComputeInFlight() const { return m_computeInFlightFences; }
 		size_t imageCount() { return m_swapChainImages.size(); }
 
 	private:
@@ -70,9 +76,7 @@ namespace AE {
 		std::vector<VkSemaphore> m_computeFinishedSemaphores;
 		std::vector<VkSemaphore> m_imageAvailableSemaphores;
 		std::vector<VkSemaphore> m_renderFinishedSemaphores;
-		std::vector<VkFence> m_computeInFlightFences;
-		std::vector<VkFence> m_inFlightFences;
-		std::vector<VkFence> m_imagesInFlight;
+		std::vector<bool> m_computeSubmitted; // the graphics submission of the frame waits for its compute semaphore
 		size_t m_currentFrame = 0;
 
 		Devices& m_devices;
@@ -85,10 +89,10 @@ namespace AE {
 		std::vector<VkImageView> m_swapChainImageViews; // can be used as color targets
 		std::vector<VkImage> m_depthImages;
 		std::vector<VkImageView> m_depthImageViews;
-		std::vector<VkDeviceMemory> m_depthImageMemorys;
+		std::vector<MemoryAllocation> m_depthImageMemorys;
 		std::vector<VkImage> m_msaaImages;
 		std::vector<VkImageView> m_msaaImageViews;
-		std::vector<VkDeviceMemory> m_msaaImageMemorys;
+		std::vector<MemoryAllocation> m_msaaImageMemorys;
 		VkRenderPass m_renderPass;
 		std::vector<VkFramebuffer> m_framebuffers;
 	};
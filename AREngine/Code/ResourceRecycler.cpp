@@ -0,0 +1,160 @@
+#include <cstdio>
+
+#include "ResourceRecycler.h"
+
+namespace AE {
+
+	ResourceRecycler::ResourceRecycler(Devices& devices, VkDeviceSize maxPooledBytes)
+		: m_devices{ devices }, m_maxPooledBytes{ maxPooledBytes } {
+	}
+
+	ResourceRecycler::~ResourceRecycler() {
+		// Nothing can be pooled anymore
+		m_maxPooledBytes = 0;
+		flush();
+		while (!m_pool.empty()) {
+			destroyPooledBuffer(m_pool.size() - 1);
+		}
+	}
+
+	VkDeviceSize ResourceRecycler::getPooledSize(VkDeviceSize size, VkBufferUsageFlags usage) {
+		if (usage != VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+			// Descriptors with VK_WHOLE_SIZE and length() in shaders see the size of the VkBuffer, so it has to stay exact
+			return size;
+		}
+		VkDeviceSize pooledSize = MIN_STAGING_SIZE;
+		while (pooledSize < size) {
+			pooledSize *= 2;
+		}
+		return pooledSize;
+	}
+
+	void ResourceRecycler::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
+		const BufferKind kind{ getPooledSize(size, usage), usage, properties };
+		m_stats.bufferRequests++;
+		// The most recently pooled one first, its memory is the most likely to be cached
+		for (size_t i = m_pool.size(); i-- > 0;) {
+			if (m_pool[i].kind == kind) {
+				buffer = m_pool[i].buffer;
+				bufferMemory = m_pool[i].memory;
+				m_pool.erase(m_pool.begin() + i);
+				m_stats.pooledBuffers--;
+				m_stats.pooledBytes -= kind.size;
+				m_stats.reusedBuffers++;
+				return;
+			}
+		}
+		m_devices.createBuffer(kind.size, usage, properties, buffer, bufferMemory);
+	}
+
+	void ResourceRecycler::destroyBuffer(VkBuffer buffer, const MemoryAllocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+		Released released{};
+		released.frame = m_frame;
+		released.bufferKind = { getPooledSize(size, usage), usage, properties };
+		released.buffer = buffer;
+		released.memory = bufferMemory;
+		m_released.push_back(released);
+		m_stats.deferredCount++;
+	}
+
+	void ResourceRecycler::destroyImage(VkImage image, VkImageView imageView, VkSampler sampler, const MemoryAllocation& imageMemory) {
+		Released released{};
+		released.frame = m_frame;
+		released.image = image;
+		released.imageView = imageView;
+		released.sampler = sampler;
+		released.memory = imageMemory;
+		m_released.push_back(released);
+		m_stats.deferredCount++;
+	}
+
+	void ResourceRecycler::destroyFramebuffer(VkFramebuffer framebuffer) {
+		Released released{};
+		released.frame = m_frame;
+		released.framebuffer = framebuffer;
+		m_released.push_back(released);
+		m_stats.deferredCount++;
+	}
+
+	void ResourceRecycler::destroySwapChain(VkSwapchainKHR swapChain) {
+		Released released{};
+		released.frame = m_frame;
+		released.swapChain = swapChain;
+		m_released.push_back(released);
+		m_stats.deferredCount++;
+	}
+
+	void ResourceRecycler::beginFrame(uint64_t frame, uint64_t completedFrame) {
+		m_frame = frame;
+		while (!m_released.empty() && m_released.front().frame <= completedFrame) {
+			release(m_released.front());
+			m_released.pop_front();
+		}
+		while (!m_pool.empty() && m_pool.front().frame + POOL_IDLE_FRAMES < m_frame) {
+			destroyPooledBuffer(0);
+		}
+	}
+
+	void ResourceRecycler::flush() {
+		while (!m_released.empty()) {
+			release(m_released.front());
+			m_released.pop_front();
+		}
+	}
+
+	void ResourceRecycler::release(Released& released) {
+		VkDevice device = m_devices.getLogicalDevice();
+		if (released.buffer != VK_NULL_HANDLE) {
+			// Big buffers would push everything else out of the pool
+			if (released.bufferKind.size <= m_maxPooledBytes / 4) {
+				m_pool.push_back({ m_frame, released.bufferKind, released.buffer, released.memory });
+				m_stats.pooledBuffers++;
+				m_stats.pooledBytes += released.bufferKind.size;
+				while (m_stats.pooledBytes > m_maxPooledBytes) {
+					destroyPooledBuffer(0);
+				}
+				return;
+			}
+			vkDestroyBuffer(device, released.buffer, nullptr);
+		}
+		if (released.framebuffer != VK_NULL_HANDLE) {
+			vkDestroyFramebuffer(device, released.framebuffer, nullptr);
+		}
+		if (released.imageView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device, released.imageView, nullptr);
+		}
+		if (released.image != VK_NULL_HANDLE) {
+			vkDestroyImage(device, released.image, nullptr);
+		}
+		if (released.sampler != VK_NULL_HANDLE) {
+			vkDestroySampler(device, released.sampler, nullptr);
+		}
+		if (released.swapChain != VK_NULL_HANDLE) {
+			vkDestroySwapchainKHR(device, released.swapChain, nullptr);
+		}
+		m_devices.freeMemory(released.memory);
+		m_stats.destroyedCount++;
+	}
+
+	void ResourceRecycler::destroyPooledBuffer(size_t index) {
+		PooledBuffer& pooled = m_pool[index];
+		vkDestroyBuffer(m_devices.getLogicalDevice(), pooled.buffer, nullptr);
+		m_devices.freeMemory(pooled.memory);
+		m_stats.pooledBuffers--;
+		m_stats.pooledBytes -= pooled.kind.size;
+		m_stats.destroyedCount++;
+		m_pool.erase(m_pool.begin() + index);
+	}
+
+	void ResourceRecycler::printStats(const char* label) const {
+		printf("%s: %llu of %llu buffers reused from the pool, %llu releases deferred, %llu destroyed, %u buffers (%.2f MB) pooled\n",
+			label,
+			static_cast<unsigned long long>(m_stats.reusedBuffers),
+			static_cast<unsigned long long>(m_stats.bufferRequests),
+			static_cast<unsigned long long>(m_stats.deferredCount),
+			static_cast<unsigned long long>(m_stats.destroyedCount),
+			m_stats.pooledBuffers,
+			m_stats.pooledBytes / (1024.0 * 1024.0));
+	}
+
+} // namespace AE
\ No newline at end of file
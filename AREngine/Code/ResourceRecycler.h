@@ -0,0 +1,106 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "Devices.h"
+
+namespace AE {
+
+	// Deferred destruction and reuse of buffers and images, and deferred destruction of retired swap chains.
+	// Released resources are stamped with the serial of the frame being recorded (FrameScheduler) and kept until that
+	// frame has finished, so a buffer or texture can be dropped in the middle of a session, e.g. when streaming assets,
+	// without vkDeviceWaitIdle. Renderer::beginFrame() passes the serials to beginFrame().
+	// Buffers then go to a pool instead of being destroyed, and createBuffer() hands them out again for a buffer with the
+	// same size, usage and memory properties. Staging buffers (only VK_BUFFER_USAGE_TRANSFER_SRC_BIT) are created with
+	// their size rounded up to a power of two, so that staging buffers of similar sizes share the pooled ones.
+	// The pool holds at most maxPooledBytes, the least recently released buffers go first, and buffers that were not
+	// reused for POOL_IDLE_FRAMES frames are destroyed. Buffers bigger than a quarter of it are never pooled.
+	// Everything submitted before the next frame fence (e.g. UploadManager batches) is covered as well.
+	class ResourceRecycler {
+	public:
+		static constexpr VkDeviceSize DEFAULT_MAX_POOLED_BYTES = 128ull * 1024 * 1024;
+		static constexpr VkDeviceSize MIN_STAGING_SIZE = 64 * 1024;
+		static constexpr uint64_t POOL_IDLE_FRAMES = 300;
+
+		struct Stats {
+			uint64_t bufferRequests = 0;   // createBuffer() calls
+			uint64_t reusedBuffers = 0;    // served from the pool
+			uint64_t deferredCount = 0;    // buffers and images released while a frame could still use them
+			uint64_t destroyedCount = 0;
+			uint32_t pooledBuffers = 0;
+			VkDeviceSize pooledBytes = 0;
+		};
+
+		ResourceRecycler(Devices& devices, VkDeviceSize maxPooledBytes = DEFAULT_MAX_POOLED_BYTES);
+		// Destroys everything still queued or pooled, the device must be idle
+		~ResourceRecycler();
+
+		// Not copyable or movable
+		ResourceRecycler(const ResourceRecycler&) = delete;
+		ResourceRecycler& operator=(const ResourceRecycler&) = delete;
+		ResourceRecycler(ResourceRecycler&&) = delete;
+		ResourceRecycler& operator=(ResourceRecycler&&) = delete;
+
+		// Devices::createBuffer(), or a pooled buffer of the same kind
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+		// Pass what createBuffer() was called with
+		void destroyBuffer(VkBuffer buffer, const MemoryAllocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		// Any of the handles may be VK_NULL_HANDLE
+		void destroyImage(VkImage image, VkImageView imageView, VkSampler sampler, const MemoryAllocation& imageMemory);
+		void destroyFramebuffer(VkFramebuffer framebuffer);
+		// A swap chain that was passed as oldSwapchain, after the views and framebuffers of its images
+		void destroySwapChain(VkSwapchainKHR swapChain);
+
+		// The frame of serial frame begins and every frame up to completedFrame has finished
+		void beginFrame(uint64_t frame, uint64_t completedFrame);
+		// Releases everything queued right away, e.g. after vkDeviceWaitIdle. The pool is kept.
+		void flush();
+
+		const Stats& getStats() const { return m_stats; }
+		void printStats(const char* label) const;
+
+	private:
+		struct BufferKind {
+			VkDeviceSize size;
+			VkBufferUsageFlags usage;
+			VkMemoryPropertyFlags properties;
+
+			bool operator==(const BufferKind& other) const {
+				return size == other.size && usage == other.usage && properties == other.properties;
+			}
+		};
+
+		struct Released {
+			uint64_t frame;               // serial of the frame that was recorded when it was released
+			BufferKind bufferKind{};
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			VkSampler sampler = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+			MemoryAllocation memory{};
+		};
+
+		struct PooledBuffer {
+			uint64_t frame;               // serial of the frame it was pooled in
+			BufferKind kind;
+			VkBuffer buffer;
+			MemoryAllocation memory;
+		};
+
+		// The size the buffer is actually created with
+		static VkDeviceSize getPooledSize(VkDeviceSize size, VkBufferUsageFlags usage);
+		void release(Released& released);
+		void destroyPooledBuffer(size_t index);
+
+		Devices& m_devices;
+		VkDeviceSize m_maxPooledBytes;
+		uint64_t m_frame = 0;
+		std::deque<Released> m_released;     // in release order, so also in frame order
+		std::vector<PooledBuffer> m_pool;    // least recently pooled first
+		Stats m_stats{};
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,60 @@
+#version 450
+
+layout (location = 0) in vec3 inPosition;
+
+layout (location = 0) out vec4 fragColor;
+layout (location = 1) out vec2 fragOffset;
+
+struct PointLight {
+	vec4 position; // ignore w
+	vec4 color; // w is intensity
+};
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	PointLight pointLights[10];
+	int numLights;
+} ubo;
+
+// PointCloud::CompactParticleInstance (12 bytes)
+struct CompactParticle {
+	uint positionXY; // x | y << 16
+	uint positionZ;  // z, upper 16 bits unused
+	uint color;      // RGBA8
+};
+
+layout (std430, set = 0, binding = 3) readonly buffer ParticleSSBOin {
+	CompactParticle particlesIn[ ];
+} PointCloud;
+
+// PointCloud::CompactPushConstantData
+layout (push_constant) uniform Push {
+	vec4 boundsMin;
+	vec4 boundsScale; // (max - min) / 65535
+} push;
+
+const float RADIUS = 0.01;
+
+void main() {
+	CompactParticle particle = PointCloud.particlesIn[gl_InstanceIndex];
+	vec3 quantized = vec3(
+		float(particle.positionXY & 0xFFFFu),
+		float(particle.positionXY >> 16),
+		float(particle.positionZ & 0xFFFFu)
+	);
+	vec3 position = push.boundsMin.xyz + quantized * push.boundsScale.xyz;
+
+	fragColor = unpackUnorm4x8(particle.color);
+
+	fragOffset = inPosition.xy;
+	vec3 cameraRightWorld = { ubo.view[0][0], ubo.view[1][0], ubo.view[2][0] };
+	vec3 cameraUpWorld = { ubo.view[0][1], ubo.view[1][1], ubo.view[2][1] };
+
+	vec3 positionWorld = position
+		+ RADIUS * inPosition.x * cameraRightWorld
+		+ RADIUS * inPosition.y * cameraUpWorld;
+	gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "VoxelGridFilterTest.h"
+#include "../3Dvision/Filter/VoxelGridFilter.h"
+
+namespace AE {
+
+	namespace {
+
+		constexpr int GRID_SIZE = 96;        // voxels per axis
+		constexpr int POINTS_PER_VOXEL = 3;
+		constexpr float VOXEL_SIZE = 0.01f;
+		// Linear probing at a load factor of at most 1/2 needs about 1.5 probes per lookup with a well spread hash
+		constexpr double MAX_AVERAGE_PROBE_LENGTH = 2.0;
+		constexpr uint32_t MAX_PROBE_LENGTH = 64;
+		constexpr float EPSILON = 1e-6f;
+
+		bool check(bool condition, const char* message) {
+			if (!condition) {
+				printf("FAILED: %s\n", message);
+			}
+			return condition;
+		}
+
+		bool nearlyEqual(const glm::vec4& a, const glm::vec4& b) {
+			for (int i = 0; i < 4; i++) {
+				if (std::abs(a[i] - b[i]) > EPSILON) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	} // namespace
+
+	int runVoxelGridFilterTest() {
+		// Every voxel of the grid gets POINTS_PER_VOXEL points around its center, split over two clouds like two views
+		std::vector<std::vector<glm::vec4>> positions(2), colors(2);
+		uint32_t random = 1;
+		for (int z = 0; z < GRID_SIZE; z++) {
+			for (int y = 0; y < GRID_SIZE; y++) {
+				for (int x = 0; x < GRID_SIZE; x++) {
+					for (int p = 0; p < POINTS_PER_VOXEL; p++) {
+						glm::vec4 jitter{ 0.f };
+						for (int axis = 0; axis < 3; axis++) {
+							random = random * 1664525u + 1013904223u;
+							jitter[axis] = (static_cast<float>(random >> 8) / 16777216.f - 0.5f) * 0.6f;
+						}
+						// Centered on the origin, so negative voxel coordinates are covered too
+						glm::vec4 position{
+							(x - GRID_SIZE / 2 + 0.5f + jitter.x) * VOXEL_SIZE,
+							(y - GRID_SIZE / 2 + 0.5f + jitter.y) * VOXEL_SIZE,
+							(z - GRID_SIZE / 2 + 0.5f + jitter.z) * VOXEL_SIZE,
+							1.f
+						};
+						positions[p % 2].push_back(position);
+						colors[p % 2].push_back(glm::vec4{ x / float(GRID_SIZE), y / float(GRID_SIZE), z / float(GRID_SIZE), 1.f });
+					}
+				}
+			}
+		}
+
+		ThreadPool threadPool{};
+		VoxelGridFilter filter{ threadPool };
+		VoxelGridFilter::Settings settings{};
+		settings.voxelSize = VOXEL_SIZE;
+		filter.setSettings(settings);
+		std::vector<glm::vec4> outPositions, outColors;
+		filter.filter(positions, colors, outPositions, outColors);
+		const VoxelGridFilter::Stats& stats = filter.getLastStats();
+		printf("Voxel grid filter test: %zu points -> %zu points in %.2f ms, %.3f probes per point on average, at most %u\n",
+			stats.pointsIn, stats.pointsOut, stats.filterMs, stats.averageProbeLength, stats.maxProbeLength);
+
+		bool passed = true;
+		passed &= check(stats.pointsOut == static_cast<size_t>(GRID_SIZE) * GRID_SIZE * GRID_SIZE, "one output point per occupied voxel");
+		passed &= check(outPositions.size() == stats.pointsOut && outColors.size() == stats.pointsOut, "output sizes");
+		passed &= check(stats.averageProbeLength <= MAX_AVERAGE_PROBE_LENGTH, "average probe length");
+		passed &= check(stats.maxProbeLength <= MAX_PROBE_LENGTH, "longest probe");
+
+		// Known points inside the voxel (2, -3, 1), away from its faces, split over both clouds.
+		// The output point must be their mean position and mean color.
+		positions = {
+			{ { 0.0225f, -0.0275f, 0.0125f, 1.f }, { 0.0275f, -0.0225f, 0.0175f, 1.f } },
+			{ { 0.0250f, -0.0250f, 0.0150f, 1.f }, { 0.0210f, -0.0290f, 0.0110f, 1.f } }
+		};
+		colors = {
+			{ { 1.0f, 0.0f, 0.2f, 1.f }, { 0.0f, 1.0f, 0.4f, 1.f } },
+			{ { 0.5f, 0.5f, 0.6f, 1.f }, { 0.1f, 0.3f, 0.8f, 1.f } }
+		};
+		const glm::vec4 expectedPosition{ 0.0240f, -0.0260f, 0.0140f, 1.f };
+		const glm::vec4 expectedColor{ 0.4f, 0.45f, 0.5f, 1.f };
+		filter.filter(positions, colors, outPositions, outColors);
+		passed &= check(outPositions.size() == 1 && outColors.size() == 1, "one output point for a single voxel");
+		if (outPositions.size() == 1 && outColors.size() == 1) {
+			passed &= check(nearlyEqual(outPositions[0], expectedPosition), "averaged position");
+			passed &= check(nearlyEqual(outColors[0], expectedColor), "averaged color");
+		}
+		printf("Voxel grid filter test %s\n", passed ? "passed" : "failed");
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+} // namespace AE
\ No newline at end of file
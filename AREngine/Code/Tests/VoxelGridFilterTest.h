@@ -0,0 +1,9 @@
+#pragma once
+
+namespace AE {
+
+	// Runs VoxelGridFilter on a dense synthetic cloud and checks the output and the hash map probe lengths.
+	// Returns EXIT_SUCCESS or EXIT_FAILURE, main.cpp runs it for --test-voxel-filter.
+	int runVoxelGridFilterTest();
+
+} // namespace AE
\ No newline at end of file
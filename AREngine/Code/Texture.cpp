@@ -1,14 +1,14 @@
 #include "Utils/AREngineIncludes.h"
 
 #include "Texture.h"
+#include "UploadManager.h"
+#include "ResourceRecycler.h"
 
 namespace AE {
 
     Texture::~Texture() {
-        vkDestroyImage(m_devices.getLogicalDevice(), m_image, nullptr);
-        vkFreeMemory(m_devices.getLogicalDevice(), m_imageMemory, nullptr);
-        vkDestroyImageView(m_devices.getLogicalDevice(), m_imageView, nullptr);
-        vkDestroySampler(m_devices.getLogicalDevice(), m_sampler, nullptr);
+        // Destroyed once no frame in flight can use it anymore
+        m_devices.getResourceRecycler().destroyImage(m_image, m_imageView, m_sampler, m_imageMemory);
     }
 
     void Texture::createTextureImage(const char* filePath) {
@@ -25,19 +25,6 @@ namespace AE {
         m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_texWidth, m_texHeight)))) + 1;
 #endif
 
-        Buffer stagingBuffer{
-            m_devices,
-            bytes_per_pixel,
-            static_cast<uint32_t>(m_texWidth * m_texHeight),
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        // create a region of host(cpu) memory mapped to device memory and set data to point to the beginning of the mapped memory range
-        stagingBuffer.map();
-        // As we specified VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data will automatically be flushed to update device memory after memcpy
-        stagingBuffer.writeToBuffer(img.data);
-
         if (m_texChannels == 3) {
             m_imageFormat = VK_FORMAT_R8G8B8_SRGB;
         }
@@ -70,15 +57,20 @@ namespace AE {
 
         // Allocate memory
         m_devices.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_imageMemory);
-        // change layout from UNDEFINED to TRANSFER
-        transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        // copy from buffer to image
-        m_devices.copyBufferToImage(
-            stagingBuffer.getBuffer(),
+        // copy from the upload ring to image. The upload also changes the layout from UNDEFINED to TRANSFER
+        // (on the transfer queue when there is one), the mipmap blits and the last transition follow it on the
+        // graphics queue. All of it runs with the next UploadManager::submit()/flush().
+        m_devices.getUploadManager().uploadImage(
             m_image,
+            img.data,
+            bytes_per_pixel * m_texWidth * m_texHeight,
             static_cast<uint>(m_texWidth),
             static_cast<uint>(m_texHeight),
+#ifdef ENABLE_MIPMAP
+            m_mipLevels
+#else
             1
+#endif
         );
 #ifdef ENABLE_MIPMAP
         generateMipmaps();
@@ -139,7 +131,7 @@ namespace AE {
     }
 
     void Texture::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout) {
-        VkCommandBuffer commandBuffer = m_devices.beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = m_devices.getUploadManager().getGraphicsCommandBuffer();
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -191,8 +183,6 @@ namespace AE {
             1, 
             &barrier
         );
-
-        m_devices.endSingleTimeCommands(commandBuffer);
     }
 
 #ifdef ENABLE_MIPMAP
@@ -204,7 +194,7 @@ namespace AE {
             throw std::runtime_error("texture image format does not support linear blitting!");
         }
 
-        VkCommandBuffer commandBuffer = m_devices.beginSingleTimeCommands();
+        VkCommandBuffer commandBuffer = m_devices.getUploadManager().getGraphicsCommandBuffer();
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -304,8 +294,6 @@ namespace AE {
             1, 
             &barrier
         );
-
-        m_devices.endSingleTimeCommands(commandBuffer);
     }
 #endif
 
@@ -37,7 +37,7 @@ namespace AE {
 #endif
         Devices& m_devices;
         VkImage m_image;
-        VkDeviceMemory m_imageMemory;
+        MemoryAllocation m_imageMemory{};
         VkImageView m_imageView;
         VkSampler m_sampler;
         VkFormat m_imageFormat;
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "UniformAllocator.h"
+
+namespace AE {
+
+	UniformAllocator::UniformAllocator(Devices& devices, uint32_t frameCount, VkDeviceSize frameCapacity) : m_frameCapacity{ frameCapacity } {
+		const VkPhysicalDeviceLimits& limits = devices.getPhysicalDeviceProperties().limits;
+		m_alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+		m_maxRange = limits.maxUniformBufferRange;
+
+		m_frameBuffers.resize(frameCount);
+		for (std::unique_ptr<Buffer>& buffer : m_frameBuffers) {
+			buffer = std::make_unique<Buffer>(
+				devices,
+				m_frameCapacity,
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+			if (buffer->map() != VK_SUCCESS) {
+				throw std::runtime_error("failed to map uniform buffer!");
+			}
+		}
+	}
+
+	void UniformAllocator::beginFrame(uint32_t frameIndex) {
+		m_frameIndex = frameIndex;
+		m_head = 0;
+	}
+
+	uint32_t UniformAllocator::allocate(VkDeviceSize size, void*& mapped) {
+		if (size > m_maxRange) {
+			throw std::runtime_error("failed to allocate uniform memory! The block is bigger than maxUniformBufferRange");
+		}
+		VkDeviceSize offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+		if (offset + size > m_frameCapacity) {
+			throw std::runtime_error("failed to allocate uniform memory! Raise the frame capacity of the UniformAllocator");
+		}
+		m_head = offset + size;
+		m_frameBuffers[m_frameIndex]->markDirty(size, offset);
+		mapped = static_cast<char*>(m_frameBuffers[m_frameIndex]->getMappedMemory()) + offset;
+		return static_cast<uint32_t>(offset);
+	}
+
+	void UniformAllocator::flush() {
+		// Only the blocks allocated since the last flush, the alignment gaps between them are skipped unless they share an atom
+		if (m_frameBuffers[m_frameIndex]->flushDirty() != VK_SUCCESS) {
+			throw std::runtime_error("failed to flush uniform buffer!");
+		}
+	}
+
+	VkDescriptorBufferInfo UniformAllocator::descriptorInfo(uint32_t frameIndex, VkDeviceSize range) const {
+		return m_frameBuffers[frameIndex]->descriptorInfo(range, 0);
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Devices.h"
+#include "Buffer.h"
+
+namespace AE {
+
+	// Linear allocator for per frame uniform data.
+	// Every frame in flight owns one persistently mapped buffer. Uniform blocks are bump allocated from it at
+	// minUniformBufferOffsetAlignment and bound as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, so one descriptor per
+	// binding serves every allocation and a new uniform consumer needs no buffers or descriptor sets of its own.
+	// beginFrame() rewinds the buffer of a frame, the caller must have waited for the frame that used it last
+	// (Renderer::beginFrame() does). flush() only flushes the blocks written since the last flush (Buffer::flushDirty()).
+	class UniformAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_FRAME_CAPACITY = 256 * 1024;
+
+		UniformAllocator(Devices& devices, uint32_t frameCount, VkDeviceSize frameCapacity = DEFAULT_FRAME_CAPACITY);
+
+		// Not copyable or movable
+		UniformAllocator(const UniformAllocator&) = delete;
+		UniformAllocator& operator=(const UniformAllocator&) = delete;
+		UniformAllocator(UniformAllocator&&) = delete;
+		UniformAllocator& operator=(UniformAllocator&&) = delete;
+
+		void beginFrame(uint32_t frameIndex);
+		// Reserves size bytes in the current frame. Returns the dynamic offset, mapped points to the reserved bytes.
+		uint32_t allocate(VkDeviceSize size, void*& mapped);
+		template<typename T>
+		uint32_t push(const T& data) {
+			void* mapped;
+			uint32_t offset = allocate(sizeof(T), mapped);
+			memcpy(mapped, &data, sizeof(T));
+			return offset;
+		}
+		// Makes everything allocated since beginFrame() visible to the device
+		void flush();
+
+		// For the descriptor set of a frame. range is the size of the uniform block, the dynamic offset selects it.
+		VkDescriptorBufferInfo descriptorInfo(uint32_t frameIndex, VkDeviceSize range) const;
+		VkDeviceSize getUsedBytes() const { return m_head; }
+		VkDeviceSize getFrameCapacity() const { return m_frameCapacity; }
+
+	private:
+		std::vector<std::unique_ptr<Buffer>> m_frameBuffers;
+		VkDeviceSize m_frameCapacity;
+		VkDeviceSize m_alignment;
+		VkDeviceSize m_maxRange;
+		uint32_t m_frameIndex = 0;
+		VkDeviceSize m_head = 0; // next free byte of the current frame
+	};
+
+} // namespace AE
\ No newline at end of file
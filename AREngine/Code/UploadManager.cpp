@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "Utils/AREngineDefines.h"
+#include "UploadManager.h"
+
+namespace AE {
+
+	UploadManager::UploadManager(Devices& devices, VkDeviceSize ringSize)
+		: m_devices{ devices }, m_ringSize{ ringSize }, m_dedicatedTransferQueue{ devices.hasDedicatedTransferQueue() } {
+		m_ring = std::make_unique<Buffer>(
+			m_devices,
+			m_ringSize,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		);
+		m_ring->map();
+	}
+
+	UploadManager::~UploadManager() {
+		flush();
+		VkDevice device = m_devices.getLogicalDevice();
+		if (!m_freeGraphicsCommandBuffers.empty()) {
+			vkFreeCommandBuffers(device, m_devices.getCommandPool(), static_cast<uint32_t>(m_freeGraphicsCommandBuffers.size()), m_freeGraphicsCommandBuffers.data());
+		}
+		if (!m_freeTransferCommandBuffers.empty()) {
+			vkFreeCommandBuffers(device, m_devices.getTransferCommandPool(), static_cast<uint32_t>(m_freeTransferCommandBuffers.size()), m_freeTransferCommandBuffers.data());
+		}
+		for (VkFence fence : m_freeFences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
+		for (VkSemaphore semaphore : m_freeSemaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+	}
+
+	VkCommandBuffer UploadManager::beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers) {
+		VkCommandBuffer commandBuffer;
+		if (!freeCommandBuffers.empty()) {
+			commandBuffer = freeCommandBuffers.back();
+			freeCommandBuffers.pop_back();
+		}
+		else {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(m_devices.getLogicalDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate upload command buffer!");
+			}
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording upload command buffer!");
+		}
+		return commandBuffer;
+	}
+
+	VkCommandBuffer UploadManager::getGraphicsCommandBuffer() {
+		if (m_current.graphicsCommandBuffer == VK_NULL_HANDLE) {
+			m_current.graphicsCommandBuffer = beginCommandBuffer(m_devices.getCommandPool(), m_freeGraphicsCommandBuffers);
+		}
+		return m_current.graphicsCommandBuffer;
+	}
+
+	VkCommandBuffer UploadManager::getTransferCommandBuffer() {
+		if (!m_dedicatedTransferQueue) {
+			return getGraphicsCommandBuffer();
+		}
+		if (m_current.transferCommandBuffer == VK_NULL_HANDLE) {
+			m_current.transferCommandBuffer = beginCommandBuffer(m_devices.getTransferCommandPool(), m_freeTransferCommandBuffers);
+		}
+		return m_current.transferCommandBuffer;
+	}
+
+	bool UploadManager::tryAllocateRing(VkDeviceSize size, VkDeviceSize& offset) {
+		if (m_usedBytes == 0) {
+			// Start over at 0, so that the whole ring is one contiguous range again
+			m_head = 0;
+			m_tail = 0;
+		}
+		else if (m_head == m_tail) {
+			return false; // full
+		}
+
+		VkDeviceSize aligned = (m_head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		VkDeviceSize consumed;
+		if (m_head >= m_tail) {
+			// Free: [head, ringSize) and [0, tail)
+			if (aligned + size <= m_ringSize) {
+				offset = aligned;
+				consumed = aligned + size - m_head;
+			}
+			else if (size <= m_tail) {
+				// Skip the end of the ring, the skipped bytes belong to this batch
+				offset = 0;
+				consumed = m_ringSize - m_head + size;
+			}
+			else {
+				return false;
+			}
+		}
+		else {
+			// Free: [head, tail)
+			if (aligned + size > m_tail) {
+				return false;
+			}
+			offset = aligned;
+			consumed = aligned + size - m_head;
+		}
+
+		m_head = (offset + size) % m_ringSize;
+		m_usedBytes += consumed;
+		m_current.ringBytes += consumed;
+		return true;
+	}
+
+	VkBuffer UploadManager::allocateStaging(VkDeviceSize size, VkDeviceSize& offset, void*& mapped) {
+		if (size > m_ringSize) {
+			std::unique_ptr<Buffer> staging = std::make_unique<Buffer>(
+				m_devices,
+				size,
+				1,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			);
+			staging->map();
+			offset = 0;
+			mapped = staging->getMappedMemory();
+			VkBuffer buffer = staging->getBuffer();
+			m_current.dedicatedStaging.push_back(std::move(staging));
+			m_stats.dedicatedStagingCount++;
+			return buffer;
+		}
+
+		retireCompletedBatches();
+		while (!tryAllocateRing(size, offset)) {
+			// Everything still in the ring belongs to batches in flight or to the current one
+			if (m_inFlight.empty()) {
+				submit();
+			}
+			if (m_inFlight.empty()) {
+				throw std::runtime_error("failed to allocate upload staging memory!");
+			}
+			retireOldestBatch();
+		}
+		mapped = static_cast<char*>(m_ring->getMappedMemory()) + offset;
+		return m_ring->getBuffer();
+	}
+
+	void UploadManager::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+		if (size == 0) {
+			return;
+		}
+		VkDeviceSize stagingOffset;
+		void* mapped;
+		VkBuffer staging = allocateStaging(size, stagingOffset, mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		copyBuffer(staging, dstBuffer, size, stagingOffset, dstOffset);
+		m_stats.uploadedBytes += size;
+	}
+
+	void UploadManager::uploadBuffer(const std::vector<VkBuffer>& dstBuffers, const void* data, VkDeviceSize size) {
+		if (size == 0 || dstBuffers.empty()) {
+			return;
+		}
+		// The copies have to be recorded right away: the staging range belongs to the current batch
+		VkDeviceSize stagingOffset;
+		void* mapped;
+		VkBuffer staging = allocateStaging(size, stagingOffset, mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		for (VkBuffer dstBuffer : dstBuffers) {
+			copyBuffer(staging, dstBuffer, size, stagingOffset, 0);
+		}
+		m_stats.uploadedBytes += size;
+	}
+
+	void UploadManager::writeDirect(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+		if (dstBuffer.getMappedMemory() == nullptr && dstBuffer.map() != VK_SUCCESS) {
+			throw std::runtime_error("failed to map upload destination!");
+		}
+		// The next queue submit makes host writes visible to the device, no barrier needed
+		dstBuffer.writeToBuffer(data, size, dstOffset);
+		if (dstBuffer.flushDirty() != VK_SUCCESS) {
+			throw std::runtime_error("failed to flush upload destination!");
+		}
+		m_stats.directUploadCount++;
+		m_stats.directUploadBytes += size;
+	}
+
+	bool UploadManager::writesInPlace(const Buffer& dstBuffer) const {
+#ifdef USE_DIRECT_UPLOAD
+		return dstBuffer.isHostVisible();
+#else
+		// Host visible device local memory (UMA, lavapipe) is staged like any other, so the two paths can be compared
+		return false;
+#endif
+	}
+
+	void UploadManager::uploadBuffer(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+		if (size == 0) {
+			return;
+		}
+		if (writesInPlace(dstBuffer)) {
+			writeDirect(dstBuffer, data, size, dstOffset);
+			return;
+		}
+		uploadBuffer(dstBuffer.getBuffer(), data, size, dstOffset);
+	}
+
+	void UploadManager::uploadBuffer(const std::vector<Buffer*>& dstBuffers, const void* data, VkDeviceSize size) {
+		if (size == 0) {
+			return;
+		}
+		std::vector<VkBuffer> stagedBuffers;
+		for (Buffer* dstBuffer : dstBuffers) {
+			if (writesInPlace(*dstBuffer)) {
+				writeDirect(*dstBuffer, data, size, 0);
+			}
+			else {
+				stagedBuffers.push_back(dstBuffer->getBuffer());
+			}
+		}
+		uploadBuffer(stagedBuffers, data, size);
+	}
+
+	void UploadManager::uploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels) {
+		VkDeviceSize stagingOffset;
+		void* mapped;
+		VkBuffer staging = allocateStaging(size, stagingOffset, mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { width, height, 1 };
+
+		vkCmdCopyBufferToImage(
+			commandBuffer,
+			staging,
+			image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&region
+		);
+		m_stats.copyCount++;
+		m_stats.uploadedBytes += size;
+
+		if (m_dedicatedTransferQueue) {
+			// Release right away: the caller records its blits after the acquire in the graphics command buffer
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = m_devices.getTransferQueueFamily();
+			barrier.dstQueueFamilyIndex = m_devices.getGraphicsQueueFamily();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			m_stats.ownershipTransferCount++;
+		}
+	}
+
+	void UploadManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(getTransferCommandBuffer(), srcBuffer, dstBuffer, 1, &copyRegion);
+		m_current.dstRanges.push_back({ dstBuffer, dstOffset, size });
+		m_stats.copyCount++;
+	}
+
+	// Makes the copies of the current batch visible to everything the graphics queue runs after it
+	void UploadManager::recordOwnershipTransfers() {
+		if (!m_dedicatedTransferQueue) {
+			// One queue: a global barrier covers every destination
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(m_current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			return;
+		}
+		if (m_current.dstRanges.empty()) {
+			return;
+		}
+
+		// A buffer may be the destination of several copies (e.g. an SSBO filled piecewise), touching ranges are handed over at once
+		std::vector<BufferRange>& dstRanges = m_current.dstRanges;
+		std::sort(dstRanges.begin(), dstRanges.end(), [](const BufferRange& a, const BufferRange& b) {
+			return a.buffer != b.buffer ? a.buffer < b.buffer : a.offset < b.offset;
+		});
+		std::vector<VkBufferMemoryBarrier> barriers;
+		for (const BufferRange& range : dstRanges) {
+			if (!barriers.empty() && barriers.back().buffer == range.buffer && range.offset <= barriers.back().offset + barriers.back().size) {
+				barriers.back().size = std::max(barriers.back().size, range.offset + range.size - barriers.back().offset);
+				continue;
+			}
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = m_devices.getTransferQueueFamily();
+			barrier.dstQueueFamilyIndex = m_devices.getGraphicsQueueFamily();
+			barrier.buffer = range.buffer;
+			barrier.offset = range.offset;
+			barrier.size = range.size;
+			barriers.push_back(barrier);
+		}
+		vkCmdPipelineBarrier(m_current.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+		// The matching acquire, the same barriers apart from the access masks
+		for (VkBufferMemoryBarrier& barrier : barriers) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+		vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+		m_stats.ownershipTransferCount += static_cast<uint32_t>(barriers.size());
+	}
+
+	VkFence UploadManager::acquireFence() {
+		if (!m_freeFences.empty()) {
+			VkFence fence = m_freeFences.back();
+			m_freeFences.pop_back();
+			return fence;
+		}
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		if (vkCreateFence(m_devices.getLogicalDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+		return fence;
+	}
+
+	VkSemaphore UploadManager::acquireSemaphore() {
+		if (!m_freeSemaphores.empty()) {
+			VkSemaphore semaphore = m_freeSemaphores.back();
+			m_freeSemaphores.pop_back();
+			return semaphore;
+		}
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(m_devices.getLogicalDevice(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore!");
+		}
+		return semaphore;
+	}
+
+	void UploadManager::submit() {
+		if (m_current.transferCommandBuffer == VK_NULL_HANDLE && m_current.graphicsCommandBuffer == VK_NULL_HANDLE) {
+			return;
+		}
+		recordOwnershipTransfers();
+		for (VkCommandBuffer commandBuffer : { m_current.transferCommandBuffer, m_current.graphicsCommandBuffer }) {
+			if (commandBuffer != VK_NULL_HANDLE && vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record upload command buffer!");
+			}
+		}
+		if (m_frameScheduler == nullptr) {
+			m_current.fence = acquireFence();
+		}
+		else {
+			// The next frame submitted to the graphics queue, its fence covers this batch
+			m_current.frame = m_frameScheduler->getSubmittedSerial() + 1;
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (m_current.transferCommandBuffer != VK_NULL_HANDLE) {
+			// Every transfer command buffer releases something, so there always is a graphics one to acquire it
+			m_current.transferFinished = acquireSemaphore();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &m_current.transferCommandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &m_current.transferFinished;
+			if (vkQueueSubmit(m_devices.getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit upload command buffer!");
+			}
+			m_stats.submitCount++;
+		}
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		submitInfo = VkSubmitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (m_current.transferFinished != VK_NULL_HANDLE) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &m_current.transferFinished;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_current.graphicsCommandBuffer;
+		if (vkQueueSubmit(m_devices.getGraphicsQueue(), 1, &submitInfo, m_current.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+		m_stats.submitCount++;
+
+		m_inFlight.push_back(std::move(m_current));
+		m_current = Batch{};
+	}
+
+	void UploadManager::flush() {
+		submit();
+		if (m_inFlight.empty()) {
+			return;
+		}
+
+		std::vector<VkFence> fences;
+		fences.reserve(m_inFlight.size());
+		for (const Batch& batch : m_inFlight) {
+			if (batch.fence != VK_NULL_HANDLE) {
+				fences.push_back(batch.fence);
+			}
+		}
+		if (!fences.empty() && vkWaitForFences(m_devices.getLogicalDevice(), static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait for uploads!");
+		}
+		if (fences.size() < m_inFlight.size()) {
+			// Batches on the frame timeline, the last one may belong to the frame being recorded
+			waitForGraphicsQueue();
+		}
+		else {
+			m_stats.waitCount++;
+		}
+		while (!m_inFlight.empty()) {
+			releaseOldestBatch();
+		}
+	}
+
+	void UploadManager::waitForGraphicsQueue() {
+		// A submission without command buffers: its fence signals once everything submitted before has finished
+		VkFence fence = acquireFence();
+		if (vkQueueSubmit(m_devices.getGraphicsQueue(), 0, nullptr, fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload fence!");
+		}
+		m_stats.submitCount++;
+		if (vkWaitForFences(m_devices.getLogicalDevice(), 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait for uploads!");
+		}
+		m_stats.waitCount++;
+		vkResetFences(m_devices.getLogicalDevice(), 1, &fence);
+		m_freeFences.push_back(fence);
+	}
+
+	void UploadManager::setFrameScheduler(FrameScheduler* frameScheduler) {
+		if (m_frameScheduler != nullptr) {
+			// Batches stamped with its serials would never complete otherwise
+			flush();
+		}
+		m_frameScheduler = frameScheduler;
+	}
+
+	// Waits for the oldest batch and gives its ring space back
+	void UploadManager::retireOldestBatch() {
+		const Batch& batch = m_inFlight.front();
+		if (!isCompleted(batch)) {
+			if (batch.fence != VK_NULL_HANDLE) {
+				if (vkWaitForFences(m_devices.getLogicalDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+					throw std::runtime_error("failed to wait for uploads!");
+				}
+				m_stats.waitCount++;
+			}
+			else if (batch.frame <= m_frameScheduler->getSubmittedSerial()) {
+				m_frameScheduler->waitForSerial(batch.frame);
+				m_stats.waitCount++;
+			}
+			else {
+				// Its frame is still being recorded
+				waitForGraphicsQueue();
+			}
+		}
+		releaseOldestBatch();
+	}
+
+	// The oldest batch has completed
+	void UploadManager::releaseOldestBatch() {
+		Batch& batch = m_inFlight.front();
+		if (batch.fence != VK_NULL_HANDLE) {
+			vkResetFences(m_devices.getLogicalDevice(), 1, &batch.fence);
+			m_freeFences.push_back(batch.fence);
+		}
+		vkResetCommandBuffer(batch.graphicsCommandBuffer, 0);
+		m_freeGraphicsCommandBuffers.push_back(batch.graphicsCommandBuffer);
+		if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+			vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+			m_freeTransferCommandBuffers.push_back(batch.transferCommandBuffer);
+		}
+		if (batch.transferFinished != VK_NULL_HANDLE) {
+			// The graphics submit waited on it, so it is unsignaled again
+			m_freeSemaphores.push_back(batch.transferFinished);
+		}
+		// Batches complete in submission order, so their ring ranges are released in order too
+		m_tail = (m_tail + batch.ringBytes) % m_ringSize;
+		m_usedBytes -= batch.ringBytes;
+		m_inFlight.pop_front();
+	}
+
+	void UploadManager::printStats(const char* label) const {
+		printf("%s: %llu copies, %.2f MB (%llu staged outside the ring) in %u submits, %u waits, %u ownership transfers\n",
+			label,
+			static_cast<unsigned long long>(m_stats.copyCount),
+			m_stats.uploadedBytes / (1024.0 * 1024.0),
+			static_cast<unsigned long long>(m_stats.dedicatedStagingCount),
+			m_stats.submitCount,
+			m_stats.waitCount,
+			m_stats.ownershipTransferCount);
+		if (m_stats.directUploadCount > 0) {
+			printf("    %llu buffers written in place, %.2f MB without staging\n",
+				static_cast<unsigned long long>(m_stats.directUploadCount),
+				m_stats.directUploadBytes / (1024.0 * 1024.0));
+		}
+	}
+
+	bool UploadManager::isCompleted(const Batch& batch) {
+		if (batch.fence == VK_NULL_HANDLE) {
+			return batch.frame <= m_frameScheduler->getCompletedSerial();
+		}
+		return vkGetFenceStatus(m_devices.getLogicalDevice(), batch.fence) == VK_SUCCESS;
+	}
+
+	void UploadManager::retireCompletedBatches() {
+		while (!m_inFlight.empty() && isCompleted(m_inFlight.front())) {
+			releaseOldestBatch();
+		}
+	}
+
+} // namespace AE
\ No newline at end of file
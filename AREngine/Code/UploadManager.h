@@ -0,0 +1,143 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "Devices.h"
+#include "Buffer.h"
+#include "Renderer/FrameScheduler.h"
+
+namespace AE {
+
+	// Batches staging copies to device local buffers and images.
+	// Data is written into one persistently mapped ring buffer and the copies are recorded into a shared command buffer.
+	// submit() hands the batch to the queue and returns, flush() additionally waits for every batch,
+	// so loading a whole scene costs one wait instead of a vkQueueWaitIdle per buffer.
+	// Ring space is only reused once the batch that wrote it has completed. Before the first frame a batch gets a fence
+	// of its own. While the Renderer runs frames (setFrameScheduler()) it is on the frame timeline instead: it is stamped
+	// with the serial of the next frame to be submitted, which goes to the graphics queue after it, and completes with
+	// that frame (FrameScheduler::getCompletedSerial()). Uploads bigger than the ring get their own staging buffer,
+	// which lives until its batch completes.
+	//
+	// With a dedicated transfer queue (Devices::hasDedicatedTransferQueue()) every batch is two command buffers:
+	// the copies run on the transfer queue and release the destinations, and a graphics queue command buffer waits
+	// for them on a semaphore and acquires the destinations. So the GPU orders the uploads before any later graphics
+	// submit, and a submit() without flush() lets big copies (e.g. the point cloud SSBOs) overlap rendering.
+	// Without one, both are the same graphics queue command buffer, which ends with a transfer write barrier.
+	//
+	// Destination ranges must be newly created or no longer used by the GPU. On a dedicated transfer queue only the
+	// ranges written by a batch change queue family, the rest of a buffer stays with the graphics queue and keeps its
+	// contents, so a buffer in use can be updated piecewise (e.g. the slots of PagedPointCloud).
+	// Nothing recorded here may be used by the GPU before it was submitted. Everything uploaded before
+	// the next flush() may be in flight.
+	class UploadManager {
+	public:
+		static constexpr VkDeviceSize DEFAULT_RING_SIZE = 64ull * 1024 * 1024;
+		// Satisfies vkCmdCopyBufferToImage (multiple of the texel size and of 4) for every format used here
+		static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+		struct Stats {
+			uint64_t copyCount = 0;
+			uint64_t uploadedBytes = 0;
+			uint64_t dedicatedStagingCount = 0;  // uploads that did not fit into the ring
+			uint64_t directUploadCount = 0;      // writes straight into host visible device local buffers
+			uint64_t directUploadBytes = 0;      // not part of uploadedBytes
+			uint32_t submitCount = 0;            // vkQueueSubmit calls
+			uint32_t waitCount = 0;              // vkWaitForFences calls, i.e. CPU sync points
+			uint32_t ownershipTransferCount = 0; // buffer ranges and images released by the transfer queue family
+		};
+
+		UploadManager(Devices& devices, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+		~UploadManager();
+
+		// Not copyable or movable
+		UploadManager(const UploadManager&) = delete;
+		UploadManager& operator=(const UploadManager&) = delete;
+		UploadManager(UploadManager&&) = delete;
+		UploadManager& operator=(UploadManager&&) = delete;
+
+		// Copies size bytes of data into staging memory and records the copy to dstBuffer + dstOffset
+		void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		// Same data to the start of several buffers (e.g. one per frame in flight), staged once
+		void uploadBuffer(const std::vector<VkBuffer>& dstBuffers, const void* data, VkDeviceSize size);
+		// As above, but with USE_DIRECT_UPLOAD host visible destinations (see Devices::getDeviceLocalMemoryProperties())
+		// are written in place and flushed, without staging or a copy command
+		void uploadBuffer(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		void uploadBuffer(const std::vector<Buffer*>& dstBuffers, const void* data, VkDeviceSize size);
+		// Copies mip level 0 of a newly created image. All mipLevels are left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+		// and owned by the graphics queue, the following transitions and blits go to getGraphicsCommandBuffer().
+		void uploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels = 1);
+		// True when uploadBuffer(Buffer&) writes dstBuffer in place instead of staging it
+		bool writesInPlace(const Buffer& dstBuffer) const;
+		// Records a copy from a staging buffer the caller owns. It must stay alive and unchanged until the next flush().
+		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+
+		// Graphics queue command buffer of the current batch, for barriers and blits that belong to the uploads.
+		// It executes after every copy recorded into the batch.
+		VkCommandBuffer getGraphicsCommandBuffer();
+		// Submits the current batch without waiting for it
+		void submit();
+		// Submits the current batch and waits for every batch in flight
+		void flush();
+
+		// nullptr before the first and after the last frame. Waits for the batches of the previous one.
+		void setFrameScheduler(FrameScheduler* frameScheduler);
+
+		const Stats& getStats() const { return m_stats; }
+		void printStats(const char* label) const;
+
+	private:
+		struct BufferRange {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct Batch {
+			VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE; // dedicated transfer queue only
+			VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;                         // signaled by the last submit of the batch, none on the frame timeline
+			VkSemaphore transferFinished = VK_NULL_HANDLE;          // transfer submit -> graphics submit
+			uint64_t frame = 0;                                     // serial of the frame submitted after it, 0 for none
+			VkDeviceSize ringBytes = 0; // including alignment padding and the bytes skipped when wrapping
+			std::vector<BufferRange> dstRanges;                     // to hand over to the graphics queue family
+			std::vector<std::unique_ptr<Buffer>> dedicatedStaging;
+		};
+
+		// Copies go here, it is the graphics command buffer without a dedicated transfer queue
+		VkCommandBuffer getTransferCommandBuffer();
+		VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool, std::vector<VkCommandBuffer>& freeCommandBuffers);
+		void recordOwnershipTransfers();
+		VkFence acquireFence();
+		VkSemaphore acquireSemaphore();
+
+		// Returns the staging buffer and the offset to write size bytes to
+		VkBuffer allocateStaging(VkDeviceSize size, VkDeviceSize& offset, void*& mapped);
+		void writeDirect(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset);
+		bool tryAllocateRing(VkDeviceSize size, VkDeviceSize& offset);
+		bool isCompleted(const Batch& batch);
+		// Fence after everything submitted to the graphics queue so far, e.g. batches of the frame being recorded
+		void waitForGraphicsQueue();
+		void retireOldestBatch();
+		void releaseOldestBatch();
+		void retireCompletedBatches();
+
+		Devices& m_devices;
+		FrameScheduler* m_frameScheduler = nullptr;
+		std::unique_ptr<Buffer> m_ring;
+		VkDeviceSize m_ringSize;
+		VkDeviceSize m_head = 0;      // next free byte
+		VkDeviceSize m_tail = 0;      // first byte still used by a batch
+		VkDeviceSize m_usedBytes = 0;
+		Batch m_current{};
+		std::deque<Batch> m_inFlight;
+		bool m_dedicatedTransferQueue;
+		std::vector<VkCommandBuffer> m_freeGraphicsCommandBuffers;
+		std::vector<VkCommandBuffer> m_freeTransferCommandBuffers;
+		std::vector<VkFence> m_freeFences;
+		std::vector<VkSemaphore> m_freeSemaphores;
+		Stats m_stats{};
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -15,6 +15,7 @@
 #define POINT_SHADER_COMPILER_PATH "Shaders\\PointLightShader\\compile_point.bat"
 #define PARTICLE_COMPUTE_COMPILER_PATH "Shaders\\ParticleSystemShader\\compile_particle_compute.bat"
 #define PARTICLE_GRAPHICS_COMPILER_PATH "Shaders\\ParticleSystemShader\\compile_particle_graphics.bat"
+#define PARTICLE_COMPACT_GRAPHICS_COMPILER_PATH "Shaders\\ParticleSystemShader\\compile_particle_compact_graphics.bat"
 
 #define SIMPLE_VERT_SHADER_PATH "Shaders\\SimpleShader\\simple_shader.vert.spv"
 #define SIMPLE_FRAG_SHADER_PATH "Shaders\\SimpleShader\\simple_shader.frag.spv"
@@ -26,9 +27,54 @@
 #define PARTICLE_COMPUTE_SHADER_PATH "Shaders\\ParticleSystemShader\\particle_compute.comp.spv"
 #define PARTICLE_VERT_SHADER_PATH "Shaders\\ParticleSystemShader\\particle_shader.vert.spv"
 #define PARTICLE_FRAG_SHADER_PATH "Shaders\\ParticleSystemShader\\particle_shader.frag.spv"
+#define PARTICLE_COMPACT_VERT_SHADER_PATH "Shaders\\ParticleSystemShader\\particle_shader_compact.vert.spv"
 
-// max number of frames in flight
-#define MAX_FRAMES_IN_FLIGHT 2
+// Stage uploads on a transfer only queue family when the device has one (graphics queue otherwise)
+#define USE_TRANSFER_QUEUE
+
+// Write vertex, index and storage buffers in place when device local memory is host visible (UMA, resizable BAR)
+// instead of staging them. Comment out to always stage, e.g. to compare the load times.
+#define USE_DIRECT_UPLOAD
+
+// Seconds between the device memory budget log lines of the main loop, comment out to disable
+#define MEMORY_BUDGET_LOG_INTERVAL 5.f
+// Point clouds whose SSBOs would exceed the device memory budget are thinned out to fit.
+// Comment out to refuse them instead (endIngest() throws before allocating anything).
+#define POINT_CLOUD_OVER_BUDGET_DOWNSAMPLE
+// Run the particle compute shader every frame, ping-ponging between one SSBO and indirect buffer per frame in flight.
+// Off, the clouds are static: all frames share one read-only SSBO and indirect buffer and the compute pass is skipped.
+// Compact clouds are always static (no velocity). --simulate-point-cloud N renders N generated simulated points instead
+// of the RGBD reconstruction, whatever this is set to.
+//#define SIMULATE_POINT_CLOUD
+// Submit the particle compute pass on its own command buffers (on a second graphics family queue when there is one),
+// so that the compute of one frame overlaps the graphics of the previous one. Comment out to record it into the graphics
+// command buffer in front of the render pass instead, and compare the frame times printed at exit.
+#define ASYNC_COMPUTE
+// Page the loaded point cloud through a device pool of this many MB (PagedPointCloud) instead of uploading it whole,
+// for reconstructions bigger than device memory. Chunks are grid cells of POINT_CLOUD_PAGE_CHUNK_SIZE meters and
+// at most POINT_CLOUD_PAGE_UPLOAD_MB are paged in per frame. With RGBD_POINT_CLOUD_CACHE the cache is written in chunk
+// order and chunks are paged straight from the mapped file, without a host copy of the cloud.
+//#define POINT_CLOUD_PAGING 256
+#define POINT_CLOUD_PAGE_CHUNK_SIZE 0.5f
+#define POINT_CLOUD_PAGE_UPLOAD_MB 8
+
+// Record the render pass contents into secondary command buffers on the thread pool (ParallelCommandRecorder): one per
+// render system, and the game objects in jobs of at least PARALLEL_RECORDING_OBJECTS_PER_JOB. Comment out to record
+// everything into the primary command buffer on the main thread, e.g. to compare the frame times with MANY_MODEL_SCENE_COUNT.
+#define PARALLEL_COMMAND_RECORDING
+#define PARALLEL_RECORDING_OBJECTS_PER_JOB 256
+// Record the point cloud draw once per frame index and execute the same secondary command buffer every frame. It is
+// recorded again only when the swap chain, the pipelines, the descriptor sets or the cloud change. Paged clouds
+// (POINT_CLOUD_PAGING) are recorded every frame, their draws change with the camera. Needs PARALLEL_COMMAND_RECORDING.
+#define CACHE_POINT_CLOUD_COMMANDS
+#ifndef PARALLEL_COMMAND_RECORDING
+#undef CACHE_POINT_CLOUD_COMMANDS
+#endif
+
+// Number of per-frame resources (command buffers, descriptor sets, fences, dynamic SSBOs), i.e. the most frames in
+// flight the runtime setting (--frames-in-flight) can choose. DEFAULT_FRAMES_IN_FLIGHT is used unless it is set.
+#define MAX_FRAMES_IN_FLIGHT 3
+#define DEFAULT_FRAMES_IN_FLIGHT 2
 
 #define TINYOBJLOADER_IMPLEMENTATION
 
@@ -36,4 +82,43 @@
 
 #define ENABLE_MIPMAP
 
-//#define ENABLE_MSAA
\ No newline at end of file
+// Load this many extra vase models, each with its own buffers, to compare the number of buffers/images with the
+// vkAllocateMemory calls the memory allocator needed for them (printed once the scene is loaded)
+//#define MANY_MODEL_SCENE_COUNT 500
+
+//#define ENABLE_MSAA
+
+// Compare the vectorized back-projection against the scalar loop on the first RGBD frame (value: iterations)
+//#define BENCHMARK_BACK_PROJECTION 20
+
+// RGBD sequence (pose.txt, color/, depth/) relative to the working directory
+#define RGBD_DATA_PATH "3Dvision/RGBD/"
+// Decoded RGBD frames kept ahead of back-projection, and the threads decoding them
+#define RGBD_FRAME_RING_SIZE 4
+#define RGBD_IO_THREAD_NUM 2
+// Edge length (meters) of the voxel grid that merges the fused RGBD clouds. Comment out to keep every back-projected point.
+#define VOXEL_GRID_FILTER_SIZE 0.01f
+// Fuse the RGBD frames into a sparse TSDF volume and render its surface instead of accumulating every back-projected point
+//#define RGBD_TSDF_FUSION
+#define TSDF_VOXEL_SIZE 0.01f
+#define TSDF_TRUNCATION 0.04f
+// Render the RGBD reconstruction as a marching cubes mesh through SimpleRenderSystem instead of particle quads (implies RGBD_TSDF_FUSION)
+//#define RGBD_MESH_RENDERING
+#if defined(RGBD_MESH_RENDERING) && !defined(RGBD_TSDF_FUSION)
+#define RGBD_TSDF_FUSION
+#endif
+// Upload the RGBD clouds as 12 byte quantized points (PointCloud::PointFormat::Compact) instead of 48 byte ParticleInstances
+#define RGBD_COMPACT_POINT_FORMAT
+// Reconstructed point cloud cache (.aepc). A launch with unchanged RGBD inputs maps it instead of decoding and reconstructing.
+// Comment out to always reconstruct. Not used for RGBD_MESH_RENDERING, which needs the TSDF volume itself.
+#define RGBD_POINT_CLOUD_CACHE RGBD_DATA_PATH "pointcloud.aepc"
+#ifdef RGBD_MESH_RENDERING
+#undef RGBD_POINT_CLOUD_CACHE
+#endif
+// Render a binary PLY/PCD point cloud instead of reconstructing the RGBD sequence
+//#define POINT_CLOUD_FILE_PATH "scan.ply"
+// Show every RGBD frame in an OpenCV window and wait for a key press before converting it
+//#define SHOW_RGBD_FRAMES
+// Build only the headless RGBD ingest entry point (no Vulkan/GLFW needed, e.g. on Linux build machines).
+// Usually passed on the compiler command line: -DHEADLESS_BUILD
+//#define HEADLESS_BUILD
\ No newline at end of file
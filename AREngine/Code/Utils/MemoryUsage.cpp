@@ -0,0 +1,36 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "MemoryUsage.h"
+
+namespace AE {
+
+	size_t getPeakResidentBytes() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.PeakWorkingSetSize;
+		}
+		return 0;
+#else
+		struct rusage usage {};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) {
+			return 0;
+		}
+		// kilobytes on Linux
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+	}
+
+} // namespace AE
\ No newline at end of file
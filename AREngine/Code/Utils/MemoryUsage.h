@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace AE {
+
+	// Peak resident set size (peak working set on Windows) of this process in bytes, 0 if unknown
+	size_t getPeakResidentBytes();
+
+} // namespace AE
\ No newline at end of file
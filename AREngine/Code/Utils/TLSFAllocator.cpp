@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "TLSFAllocator.h"
+
+namespace AE {
+
+	namespace {
+
+		// Index of the lowest / highest set bit, value must not be 0
+		uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+		}
+
+		uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(63 - __builtin_clzll(value));
+#endif
+		}
+
+		uint64_t alignUp(uint64_t value, uint64_t alignment) {
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+	} // namespace
+
+	TLSFAllocator::TLSFAllocator(uint64_t size) : m_size{ size } {
+		for (uint32_t fl = 0; fl < FL_INDEX_COUNT; fl++) {
+			for (uint32_t sl = 0; sl < SL_INDEX_COUNT; sl++) {
+				m_freeLists[fl][sl] = INVALID_NODE;
+			}
+		}
+		insertFree(createNode(0, size));
+	}
+
+	void TLSFAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+		if (size < SMALL_RANGE_SIZE) {
+			fl = 0;
+			sl = static_cast<uint32_t>(size >> (SMALL_RANGE_SIZE_LOG2 - SL_INDEX_COUNT_LOG2));
+		}
+		else {
+			uint32_t log2 = highestBit(size);
+			fl = log2 - SMALL_RANGE_SIZE_LOG2 + 1;
+			sl = static_cast<uint32_t>(size >> (log2 - SL_INDEX_COUNT_LOG2)) & (SL_INDEX_COUNT - 1);
+		}
+	}
+
+	bool TLSFAllocator::findFreeList(uint64_t size, uint32_t& fl, uint32_t& sl) const {
+		// Round up to the next second level step, so that any range of the list found is big enough
+		uint64_t step = size < SMALL_RANGE_SIZE
+			? SMALL_RANGE_SIZE >> SL_INDEX_COUNT_LOG2
+			: 1ull << (highestBit(size) - SL_INDEX_COUNT_LOG2);
+		if (size > UINT64_MAX - step) {
+			return false;
+		}
+		mapping(size + step - 1, fl, sl);
+
+		uint32_t slBitmap = m_slBitmaps[fl] & (~0u << sl);
+		if (slBitmap == 0) {
+			uint64_t flBitmap = fl + 1 < 64 ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flBitmap == 0) {
+				return false;
+			}
+			fl = lowestBit(flBitmap);
+			slBitmap = m_slBitmaps[fl];
+		}
+		sl = lowestBit(slBitmap);
+		return true;
+	}
+
+	bool TLSFAllocator::allocate(uint64_t size, uint64_t alignment, Allocation& allocation) {
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+		size = std::max<uint64_t>(size, 1);
+
+		uint32_t fl, sl;
+		if (!findFreeList(size, fl, sl)) {
+			return false;
+		}
+		uint32_t node = m_freeLists[fl][sl];
+		if (alignUp(m_nodes[node].offset, alignment) + size > m_nodes[node].offset + m_nodes[node].size) {
+			// Not enough room once aligned, look for a range that fits the worst case padding
+			if (!findFreeList(size + alignment - 1, fl, sl)) {
+				return false;
+			}
+			node = m_freeLists[fl][sl];
+		}
+		removeFree(node);
+
+		uint64_t padding = alignUp(m_nodes[node].offset, alignment) - m_nodes[node].offset;
+		if (padding > 0) {
+			// The previous physical range is in use, otherwise it would have been merged with this one
+			uint32_t front = createNode(m_nodes[node].offset, padding);
+			m_nodes[front].prevPhysical = m_nodes[node].prevPhysical;
+			m_nodes[front].nextPhysical = node;
+			if (m_nodes[node].prevPhysical != INVALID_NODE) {
+				m_nodes[m_nodes[node].prevPhysical].nextPhysical = front;
+			}
+			m_nodes[node].prevPhysical = front;
+			m_nodes[node].offset += padding;
+			m_nodes[node].size -= padding;
+			insertFree(front);
+		}
+		if (m_nodes[node].size > size) {
+			splitBack(node, size);
+		}
+
+		m_nodes[node].isFree = false;
+		m_usedBytes += m_nodes[node].size;
+		m_allocationCount++;
+		allocation.offset = m_nodes[node].offset;
+		allocation.node = node;
+		return true;
+	}
+
+	void TLSFAllocator::free(uint32_t node) {
+		assert(node < m_nodes.size() && !m_nodes[node].isFree && "freeing an unknown TLSF allocation");
+		m_usedBytes -= m_nodes[node].size;
+		m_allocationCount--;
+		m_nodes[node].isFree = true;
+
+		uint32_t prev = m_nodes[node].prevPhysical;
+		if (prev != INVALID_NODE && m_nodes[prev].isFree) {
+			removeFree(prev);
+			m_nodes[prev].size += m_nodes[node].size;
+			m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+			if (m_nodes[node].nextPhysical != INVALID_NODE) {
+				m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+			}
+			releaseNode(node);
+			node = prev;
+		}
+		uint32_t next = m_nodes[node].nextPhysical;
+		if (next != INVALID_NODE && m_nodes[next].isFree) {
+			removeFree(next);
+			m_nodes[node].size += m_nodes[next].size;
+			m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+			if (m_nodes[next].nextPhysical != INVALID_NODE) {
+				m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+			}
+			releaseNode(next);
+		}
+		insertFree(node);
+	}
+
+	uint64_t TLSFAllocator::getLargestFreeRange() const {
+		if (m_flBitmap == 0) {
+			return 0;
+		}
+		uint32_t fl = highestBit(m_flBitmap);
+		uint32_t sl = highestBit(m_slBitmaps[fl]);
+		uint64_t largest = 0;
+		for (uint32_t node = m_freeLists[fl][sl]; node != INVALID_NODE; node = m_nodes[node].nextFree) {
+			largest = std::max(largest, m_nodes[node].size);
+		}
+		return largest;
+	}
+
+	uint32_t TLSFAllocator::createNode(uint64_t offset, uint64_t size) {
+		uint32_t node;
+		if (!m_unusedNodes.empty()) {
+			node = m_unusedNodes.back();
+			m_unusedNodes.pop_back();
+			m_nodes[node] = Node{};
+		}
+		else {
+			node = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.emplace_back();
+		}
+		m_nodes[node].offset = offset;
+		m_nodes[node].size = size;
+		return node;
+	}
+
+	void TLSFAllocator::releaseNode(uint32_t node) {
+		m_unusedNodes.push_back(node);
+	}
+
+	void TLSFAllocator::insertFree(uint32_t node) {
+		uint32_t fl, sl;
+		mapping(m_nodes[node].size, fl, sl);
+		uint32_t head = m_freeLists[fl][sl];
+		m_nodes[node].isFree = true;
+		m_nodes[node].prevFree = INVALID_NODE;
+		m_nodes[node].nextFree = head;
+		if (head != INVALID_NODE) {
+			m_nodes[head].prevFree = node;
+		}
+		m_freeLists[fl][sl] = node;
+		m_slBitmaps[fl] |= 1u << sl;
+		m_flBitmap |= 1ull << fl;
+		m_freeRangeCount++;
+	}
+
+	void TLSFAllocator::removeFree(uint32_t node) {
+		uint32_t fl, sl;
+		mapping(m_nodes[node].size, fl, sl);
+		uint32_t prev = m_nodes[node].prevFree;
+		uint32_t next = m_nodes[node].nextFree;
+		if (prev != INVALID_NODE) {
+			m_nodes[prev].nextFree = next;
+		}
+		else {
+			m_freeLists[fl][sl] = next;
+		}
+		if (next != INVALID_NODE) {
+			m_nodes[next].prevFree = prev;
+		}
+		if (m_freeLists[fl][sl] == INVALID_NODE) {
+			m_slBitmaps[fl] &= ~(1u << sl);
+			if (m_slBitmaps[fl] == 0) {
+				m_flBitmap &= ~(1ull << fl);
+			}
+		}
+		m_nodes[node].prevFree = INVALID_NODE;
+		m_nodes[node].nextFree = INVALID_NODE;
+		m_freeRangeCount--;
+	}
+
+	void TLSFAllocator::splitBack(uint32_t node, uint64_t size) {
+		uint32_t rest = createNode(m_nodes[node].offset + size, m_nodes[node].size - size);
+		m_nodes[rest].prevPhysical = node;
+		m_nodes[rest].nextPhysical = m_nodes[node].nextPhysical;
+		if (m_nodes[node].nextPhysical != INVALID_NODE) {
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = rest;
+		}
+		m_nodes[node].nextPhysical = rest;
+		m_nodes[node].size = size;
+		insertFree(rest);
+	}
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace AE {
+
+	// Two level segregated fit allocator over an abstract [0, size) range. It only does the bookkeeping,
+	// the range itself lives elsewhere (a VkDeviceMemory block for MemoryAllocator).
+	// Free ranges are binned by log2 of their size (first level) and 16 linear steps inside it (second level),
+	// so allocate() and free() are O(1) and neighbouring free ranges are merged immediately.
+	class TLSFAllocator {
+	public:
+		static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+		struct Allocation {
+			uint64_t offset = 0;
+			uint32_t node = INVALID_NODE; // handle for free()
+		};
+
+		explicit TLSFAllocator(uint64_t size);
+
+		// Not copyable or movable
+		TLSFAllocator(const TLSFAllocator&) = delete;
+		TLSFAllocator& operator=(const TLSFAllocator&) = delete;
+		TLSFAllocator(TLSFAllocator&&) = delete;
+		TLSFAllocator& operator=(TLSFAllocator&&) = delete;
+
+		// alignment must be a power of two. Returns false when no free range fits.
+		bool allocate(uint64_t size, uint64_t alignment, Allocation& allocation);
+		void free(uint32_t node);
+
+		uint64_t getSize() const { return m_size; }
+		uint64_t getUsedBytes() const { return m_usedBytes; }
+		uint64_t getFreeBytes() const { return m_size - m_usedBytes; }
+		uint32_t getAllocationCount() const { return m_allocationCount; }
+		uint32_t getFreeRangeCount() const { return m_freeRangeCount; }
+		uint64_t getLargestFreeRange() const;
+		bool isEmpty() const { return m_allocationCount == 0; }
+
+	private:
+		static constexpr uint32_t SL_INDEX_COUNT_LOG2 = 4;
+		static constexpr uint32_t SL_INDEX_COUNT = 1u << SL_INDEX_COUNT_LOG2;
+		// Sizes below SMALL_RANGE_SIZE share first level 0 and are binned linearly
+		static constexpr uint32_t SMALL_RANGE_SIZE_LOG2 = 8;
+		static constexpr uint64_t SMALL_RANGE_SIZE = 1ull << SMALL_RANGE_SIZE_LOG2;
+		static constexpr uint32_t FL_INDEX_COUNT = 64 - SMALL_RANGE_SIZE_LOG2 + 1;
+
+		struct Node {
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint32_t prevPhysical = INVALID_NODE;
+			uint32_t nextPhysical = INVALID_NODE;
+			uint32_t prevFree = INVALID_NODE;
+			uint32_t nextFree = INVALID_NODE;
+			bool isFree = false;
+		};
+
+		static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+		// First free list whose every range is at least size, or false
+		bool findFreeList(uint64_t size, uint32_t& fl, uint32_t& sl) const;
+		uint32_t createNode(uint64_t offset, uint64_t size);
+		void releaseNode(uint32_t node);
+		void insertFree(uint32_t node);
+		void removeFree(uint32_t node);
+		// Cuts [offset + size, end) off node as a new free range
+		void splitBack(uint32_t node, uint64_t size);
+
+		uint64_t m_size;
+		uint64_t m_usedBytes = 0;
+		uint32_t m_allocationCount = 0;
+		uint32_t m_freeRangeCount = 0;
+		uint64_t m_flBitmap = 0;
+		uint32_t m_slBitmaps[FL_INDEX_COUNT] = {};
+		uint32_t m_freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+		std::vector<Node> m_nodes;
+		std::vector<uint32_t> m_unusedNodes;
+	};
+
+} // namespace AE
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace AE {
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		m_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			m_workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_all();
+		for (std::thread& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+				if (m_stop && m_tasks.empty()) {
+					return;
+				}
+				task = std::move(m_tasks.front());
+				m_tasks.pop();
+			}
+			task();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.emplace(std::move(task));
+		}
+		m_condition.notify_one();
+	}
+
+	void ThreadPool::parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& task) {
+		if (end <= begin) {
+			return;
+		}
+		grainSize = std::max(1, grainSize);
+		const int chunkCount = (end - begin + grainSize - 1) / grainSize;
+		if (chunkCount == 1) {
+			task(begin, end);
+			return;
+		}
+
+		// Helpers may still be dequeued after this call returned, so the shared state outlives the call.
+		// "task" is only dereferenced after a chunk has been claimed, and every claimed chunk finishes before we return.
+		struct ForState {
+			std::atomic<int> nextChunk{ 0 };
+			std::atomic<int> doneChunks{ 0 };
+			std::mutex mutex;
+			std::condition_variable finished;
+			std::exception_ptr exception;
+			const std::function<void(int, int)>* task;
+		};
+		std::shared_ptr<ForState> state = std::make_shared<ForState>();
+		state->task = &task;
+
+		auto runChunks = [state, begin, end, grainSize, chunkCount]() {
+			int chunk;
+			while ((chunk = state->nextChunk.fetch_add(1)) < chunkCount) {
+				const int chunkBegin = begin + chunk * grainSize;
+				const int chunkEnd = std::min(end, chunkBegin + grainSize);
+				try {
+					(*state->task)(chunkBegin, chunkEnd);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (!state->exception) {
+						state->exception = std::current_exception();
+					}
+				}
+				if (state->doneChunks.fetch_add(1) + 1 == chunkCount) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		const int helperCount = std::min(chunkCount - 1, static_cast<int>(m_workers.size()));
+		for (int i = 0; i < helperCount; i++) {
+			submit(runChunks);
+		}
+		runChunks();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state, chunkCount] { return state->doneChunks.load() == chunkCount; });
+		if (state->exception) {
+			std::rethrow_exception(state->exception);
+		}
+	}
+
+} // namespace AE
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace AE {
+
+	// Fixed set of worker threads used by CPU side stages (back-projection, fusion, file I/O).
+	// parallelFor() lets the calling thread take part in the work, so it can safely be nested.
+	class ThreadPool {
+	public:
+		// threadCount == 0 : one worker per hardware thread
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		// Not copyable or movable
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		// Splits [begin, end) into chunks of grainSize and calls task(chunkBegin, chunkEnd) for each of them.
+		// Returns when every chunk has finished. The first exception thrown by a task is rethrown here.
+		void parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& task);
+		void submit(std::function<void()> task);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> m_workers;
+		std::queue<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop = false;
+	};
+
+} // namespace AE
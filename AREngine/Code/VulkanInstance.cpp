@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "VulkanInstance.h"
 #include "Utils/ValidationLayers.h"
 #include "Utils/AREngineDefines.h"
@@ -28,6 +30,11 @@ namespace AE {
 		createInfo.pApplicationInfo = &appInfo;
 		// find device specific extensions
 		std::vector<const char*> extensions = m_validLayers.getRequiredExtensions();
+		// Optional, for the memory budget queries of the memory allocator
+		const bool physicalDeviceProperties2 = isExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		if (physicalDeviceProperties2) {
+			extensions.emplace_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
 		// Attach device specific extensions
 #ifdef WINDOWS_OS
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
@@ -83,6 +90,23 @@ namespace AE {
 		if (vkCreateInstance(&createInfo, nullptr, &m_instance) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create instance!");
 		}
+		if (physicalDeviceProperties2) {
+			m_getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+				vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		}
+	}
+
+	bool VulkanInstance::isExtensionAvailable(const char* extensionName) const {
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> vkExtensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, vkExtensions.data());
+		for (const VkExtensionProperties& extension : vkExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
 	}
 
 } // namespace AE
\ No newline at end of file
@@ -11,11 +11,16 @@ namespace AE {
 		VulkanInstance(const char* name, ValidationLayers& validLayers);
 		void createInstance();
 		VkInstance& getInstance() { return m_instance; }
+		// nullptr when VK_KHR_get_physical_device_properties2 is not available (needed for VK_EXT_memory_budget)
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2Function() const { return m_getMemoryProperties2; }
 
 	private:
+		bool isExtensionAvailable(const char* extensionName) const;
+
 		VkInstance m_instance;
 		const char* m_appName;
 		ValidationLayers& m_validLayers;
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr;
 	};
 
 } // namespace AE
\ No newline at end of file
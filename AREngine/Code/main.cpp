@@ -1,11 +1,114 @@
 //#include <glm/vec4.hpp>
 //#include <glm/mat4x4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Utils/AREngineDefines.h"
+#ifndef HEADLESS_BUILD
 #include "Application.h"
+#endif
+#include "Utils/ThreadPool.h"
+#include "3Dvision/RGBD/HeadlessIngest.h"
+#include "ParticleSystem/PointCloudIO.h"
+#include "Tests/VoxelGridFilterTest.h"
 
 //#include <opencv2/opencv.hpp>
 
-int main() {
+// Reads a PLY/PCD point cloud and writes it back in the format of the output extension, reporting the throughput
+static int convertPointCloud(const char* inputPath, const char* outputPath) {
+	try {
+		AE::ThreadPool threadPool{};
+		AE::PointCloudIO pointCloudIO{ threadPool };
+		std::vector<AE::ParticleInstance> particles;
+		pointCloudIO.read(inputPath, particles);
+		AE::PointCloudIO::Stats readStats = pointCloudIO.getLastStats();
+		pointCloudIO.write(outputPath, particles.data(), particles.size());
+		const AE::PointCloudIO::Stats& writeStats = pointCloudIO.getLastStats();
+		printf("read  %s: %zu points, %.2f MB in %.2f ms (%.1f MB/s)\n",
+			inputPath, readStats.pointNum, readStats.fileBytes / (1024.0 * 1024.0), readStats.ms, readStats.megaBytesPerSecond);
+		printf("write %s: %zu points, %.2f MB in %.2f ms (%.1f MB/s)\n",
+			outputPath, writeStats.pointNum, writeStats.fileBytes / (1024.0 * 1024.0), writeStats.ms, writeStats.megaBytesPerSecond);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Usage: AREngine [--headless [output.ply]] [--frames-in-flight N] [--simulate-point-cloud POINTS] [--upload-benchmark MB]
+//                 [--objects N] [--recording-threads N]
+//        AREngine --convert input.(ply|pcd) output.(ply|pcd)
+//        AREngine --test-voxel-filter
+int main(int argc, char** argv) {
+	if (argc == 4 && strcmp(argv[1], "--convert") == 0) {
+		return convertPointCloud(argv[2], argv[3]);
+	}
+	if (argc == 2 && strcmp(argv[1], "--test-voxel-filter") == 0) {
+		return AE::runVoxelGridFilterTest();
+	}
+
+#ifdef HEADLESS_BUILD
+	bool headless = true;
+#else
+	bool headless = false;
+#endif
+	const char* outputPath = "fused_cloud.ply";
+	// 1 to MAX_FRAMES_IN_FLIGHT, fewer frames in flight lower the latency at the cost of throughput
+	int framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	// Generated points updated by the compute shader every frame instead of the RGBD reconstruction (0: off)
+	int simulatedPointNum = 0;
+	// Size of a staged vs in place upload timed after loading (0: off)
+	int uploadBenchmarkMB = 0;
+	// Extra scene objects, and the threads recording the frame (0: all), to measure the frame time at 1 vs N threads
+	int sceneObjectCount = 0;
+	int recordingThreadCount = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+			framesInFlight = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--simulate-point-cloud") == 0 && i + 1 < argc) {
+			simulatedPointNum = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--upload-benchmark") == 0 && i + 1 < argc) {
+			uploadBenchmarkMB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+			sceneObjectCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--recording-threads") == 0 && i + 1 < argc) {
+			recordingThreadCount = atoi(argv[++i]);
+		}
+		else {
+			outputPath = argv[i];
+		}
+	}
+
+	if (headless) {
+		try {
+			AE::ThreadPool threadPool{};
+			AE::HeadlessIngest ingest{ threadPool };
+			ingest.run(outputPath);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << "\n";
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+#ifndef HEADLESS_BUILD
 	AE::Application app{};
+	app.setFramesInFlight(static_cast<uint32_t>(framesInFlight > 0 ? framesInFlight : 1));
+	app.setSimulatedPointCloud(static_cast<uint32_t>(simulatedPointNum > 0 ? simulatedPointNum : 0));
+	app.setUploadBenchmark(static_cast<uint32_t>(uploadBenchmarkMB > 0 ? uploadBenchmarkMB : 0));
+	app.setSceneObjects(static_cast<uint32_t>(sceneObjectCount > 0 ? sceneObjectCount : 0));
+	app.setRecordingThreads(static_cast<uint32_t>(recordingThreadCount > 0 ? recordingThreadCount : 0));
 
 	try {
 		app.run();
@@ -14,6 +117,7 @@ int main() {
 		std::cerr << e.what() << "\n";
 		return EXIT_FAILURE;
 	}
+#endif
 
 	return EXIT_SUCCESS;
 }